@@ -100,8 +100,6 @@ struct regs
     ushort sys;    /* system configuration register */
   };
 
-extern struct regs simreg;  /* defined in cpu.c */
-
 /* MMU related */
 struct mmureg
   {
@@ -111,7 +109,8 @@ struct mmureg
     ushort al       : 4;
   };
 
-extern struct mmureg pagereg[2][16][16];  /* defined in cpu.c */
+/* simreg and pagereg are part of the machine context */
+#include "machine.h"
 
 #endif
 
@@ -32,6 +32,7 @@
 #include "status.h"
 #include "utils.h"
 #include "flt1750.h"
+#include "arith.h"
 
 #define FLT_1750_EPSILON     1.1920928955078125000E-7
 #define FLT_1750_MAX         1.70141163178059628080016879768632819712E38
@@ -46,31 +47,21 @@
 
 /************* utilities for Condition Status in the Status Word *************/
 
+/* Put the CS recorded by update_cs() into simreg.sw (see arith.h) */
+
 void
-update_cs (short *operand, datatype data_type)
+put_cs (void)
 {
-  bool is_zero;
+  long result = machine->cs_result;
   ushort sw_save = simreg.sw & 0x8FFF;
 
-  switch (data_type)
-    {
-    case VAR_INT:
-      is_zero = (operand[0] == 0);
-      break;
-    case VAR_LONG:
-    case VAR_FLOAT:
-      is_zero = (operand[0] == 0 && operand[1] == 0);
-      break;
-    case VAR_DOUBLE:
-      is_zero = (operand[0] == 0 && operand[1] == 0 && operand[2] == 0);
-      break;
-    }
-  if (is_zero)
+  if (result == 0)
     simreg.sw = sw_save | CS_ZERO;
-  else if (*operand & 0x8000)  /* Check sign bit. Same for all data types. */
+  else if (result < 0)
     simreg.sw = sw_save | CS_NEGATIVE;
   else
     simreg.sw = sw_save | CS_POSITIVE;
+  machine->cs_lazy = FALSE;
 }
 
 
@@ -80,8 +71,8 @@ compare (datatype data_type, short *operand0, short *operand1)
   ushort sw_save = simreg.sw & 0x0FFF;
   short op0, op1;
   long lop0, lop1;
-  double fop0, fop1;
 
+  machine->cs_lazy = FALSE;	/* all of the CS is set below */
   switch (data_type)
     {
     case VAR_INT:
@@ -105,24 +96,28 @@ compare (datatype data_type, short *operand0, short *operand1)
         simreg.sw = sw_save | CS_ZERO;
       break;
     case VAR_FLOAT:
-      fop0 = from_1750flt (operand0);
-      fop1 = from_1750flt (operand1);
-      if (fop0 < fop1)
-        simreg.sw = sw_save | CS_NEGATIVE;
-      else if (fop0 > fop1)
-        simreg.sw = sw_save | CS_POSITIVE;
-      else
-        simreg.sw = sw_save | CS_ZERO;
+      switch (flt1750_cmp (operand0, operand1))
+        {
+        case -1:
+          simreg.sw = sw_save | CS_NEGATIVE;
+        elsecase 1:
+          simreg.sw = sw_save | CS_POSITIVE;
+          break;
+        default:
+          simreg.sw = sw_save | CS_ZERO;
+        }
       break;
     case VAR_DOUBLE:
-      fop0 = from_1750eflt (operand0);
-      fop1 = from_1750eflt (operand1);
-      if (fop0 < fop1)
-        simreg.sw = sw_save | CS_NEGATIVE;
-      else if (fop0 > fop1)
-        simreg.sw = sw_save | CS_POSITIVE;
-      else
-        simreg.sw = sw_save | CS_ZERO;
+      switch (flt1750_ecmp (operand0, operand1))
+        {
+        case -1:
+          simreg.sw = sw_save | CS_NEGATIVE;
+        elsecase 1:
+          simreg.sw = sw_save | CS_POSITIVE;
+          break;
+        default:
+          simreg.sw = sw_save | CS_ZERO;
+        }
       break;
     }
 }
@@ -522,125 +517,119 @@ arith (operation_kind operation,
 
     elsecase VAR_FLOAT:
       {
-        bool overflow = FALSE;
-        const double fop0 = from_1750flt (operand0);
-        const double fop1 = from_1750flt (operand1);
-        double faccu;
+        short faccu[2];
+        int stat;
 
+        /* Done in integer arithmetic, so that the results are truncated
+           exactly as by the hardware. The host doubles are only needed
+           for the messages. */
         switch (operation)
           {
           case ARI_ADD:
-            faccu = fop0 + fop1;
+            stat = flt1750_add (operand0, operand1, faccu);
           elsecase ARI_SUB:
-            faccu = fop0 - fop1;
+            stat = flt1750_sub (operand0, operand1, faccu);
           elsecase ARI_MUL:
-            faccu = fop0 * fop1;
+            stat = flt1750_mul (operand0, operand1, faccu);
           elsecase ARI_DIV:
-            if ((fop1 < 0.0 && -fop1 < FLT_1750_MIN)
-             || (fop1 >= 0.0 && fop1 < FLT_1750_MIN))
-              overflow = TRUE;
-            else
-              faccu = fop0 / fop1;
+            stat = flt1750_div (operand0, operand1, faccu);
             break;
           default:
             problem ("illegal operation code supplied to arith VAR_FLOAT");
+            return;
           }
 
-        if (overflow)
+        if (stat == 2)
           {
             simreg.pir |= INTR_FLTOFL;
+            info ("arith: FLT zero divide during %s,  op0=%g op1=%g\n",
+                  operation_name[(int) operation],
+                  from_1750flt (operand0), from_1750flt (operand1));
             operand0[0] = 0x0000;
             operand0[1] = 0x0000;
-
-            info ("arith: FLT zero divide during %s,  op0=%g op1=%g res=%g\n",
-                  operation_name[(int) operation], fop0, fop1, faccu);
           }
         else
           {
-            int stat = to_1750flt (faccu, operand0);
-
             if (stat > 0)
               {
                 simreg.pir |= INTR_FLTOFL;
-                operand0[0] = 0x7FFF;
-                operand0[1] = 0xFF7F;
+                faccu[0] = 0x7FFF;
+                faccu[1] = 0xFF7F;
               }
             else if (stat < 0)
               {
                 simreg.pir |= INTR_FLTUFL;
-                operand0[0] = 0x4000;
-                operand0[1] = 0x0080;
+                faccu[0] = 0x4000;
+                faccu[1] = 0x0080;
               }
 
             if (stat != 0)
-              info ("arith: FLT%cFL during %s,  op0=%g op1=%g res=%g\n",
-                    (stat > 0 ? 'O' : 'U'),
-                    operation_name[(int) operation], fop0, fop1, faccu);
+              info ("arith: FLT%cFL during %s,  op0=%g op1=%g\n",
+                    (stat > 0 ? 'O' : 'U'), operation_name[(int) operation],
+                    from_1750flt (operand0), from_1750flt (operand1));
 
+            operand0[0] = faccu[0];
+            operand0[1] = faccu[1];
             update_cs (operand0, VAR_FLOAT);
           }
       }
 
     elsecase VAR_DOUBLE:
       {
-        bool overflow = FALSE;
-        const double fop0 = from_1750eflt (operand0);
-        const double fop1 = from_1750eflt (operand1);
-        double faccu;
+        short faccu[3];
+        int stat;
 
         switch (operation)
           {
           case ARI_ADD:
-            faccu = fop0 + fop1;
+            stat = flt1750_eadd (operand0, operand1, faccu);
           elsecase ARI_SUB:
-            faccu = fop0 - fop1;
+            stat = flt1750_esub (operand0, operand1, faccu);
           elsecase ARI_MUL:
-            faccu = fop0 * fop1;
+            stat = flt1750_emul (operand0, operand1, faccu);
           elsecase ARI_DIV:
-            if ((fop1 < 0.0 && -fop1 < DBL_1750_MIN)
-             || (fop1 >= 0.0 && fop1 < DBL_1750_MIN))
-              overflow = TRUE;
-            else
-              faccu = fop0 / fop1;
+            stat = flt1750_ediv (operand0, operand1, faccu);
             break;
           default:
             problem ("illegal operation code supplied to arith VAR_DOUBLE");
+            return;
           }
 
-        if (overflow)
+        if (stat == 2)
           {
             simreg.pir |= INTR_FLTOFL;
+            info ("arith: FLT zero divide during %s,  op0=%g op1=%g\n",
+                  operation_name[(int) operation],
+                  from_1750eflt (operand0), from_1750eflt (operand1));
             operand0[0] = 0x0000;
             operand0[1] = 0x0000;
             operand0[2] = 0x0000;
-
-            info ("arith: FLT zero divide during %s,  op0=%g op1=%g res=%g\n",
-                  operation_name[(int) operation], fop0, fop1, faccu);
           }
         else
           {
-            int stat = to_1750eflt (faccu, operand0);
-
             if (stat > 0)
               {
                 simreg.pir |= INTR_FLTOFL;
-                operand0[0] = 0x7FFF;
-                operand0[1] = 0xFF7F;
-                operand0[2] = 0xFFFF;
+                faccu[0] = 0x7FFF;
+                faccu[1] = 0xFF7F;
+                faccu[2] = 0xFFFF;
               }
             else if (stat < 0)
               {
                 simreg.pir |= INTR_FLTUFL;
-                operand0[0] = 0x0000;
-                operand0[1] = 0x0000;
-                operand0[2] = 0x0000;
+                faccu[0] = 0x0000;
+                faccu[1] = 0x0000;
+                faccu[2] = 0x0000;
               }
 
             if (stat != 0)
-              info ("arith: FLT%cFL during %s,  op0=%g op1=%g res=%g\n",
-                    (stat > 0 ? 'O' : 'U'),
-                    operation_name[(int) operation], fop0, fop1, faccu);
+              info ("arith: FLT%cFL during %s,  op0=%g op1=%g\n",
+                    (stat > 0 ? 'O' : 'U'), operation_name[(int) operation],
+                    from_1750eflt (operand0), from_1750eflt (operand1));
 
+            operand0[0] = faccu[0];
+            operand0[1] = faccu[1];
+            operand0[2] = faccu[2];
             update_cs (operand0, VAR_DOUBLE);
           }
       }
@@ -1,9 +1,35 @@
 /* arith.h  --  exports of arith.c */
 
+#ifndef _ARITH_H
+#define _ARITH_H
+
 #include "arch.h"
 
-void update_cs (short *operand, datatype data_type);
+/* The condition status (the CPZN bits of SW) is worked out lazily:
+   update_cs() only records the sign and zeroness of the result, and
+   flush_cs() puts them into simreg.sw. Code reading the CS or writing
+   all of SW must call flush_cs() first; code setting the CS must use
+   set_cs(). Setting or clearing the carry alone needs neither, since
+   update_cs() leaves the carry as it is. The type argument of
+   update_cs() is always a constant, so only one arm is compiled in. */
+
+#define CS_RESULT(operand,type) \
+	((type) == VAR_INT ? (long) (operand)[0] \
+	 : (type) == VAR_DOUBLE ? ((long) (operand)[0] << 16) \
+			 | (long) (ushort) ((operand)[1] | (operand)[2]) \
+	 : ((long) (operand)[0] << 16) | (long) (ushort) (operand)[1])
+
+#define update_cs(operand,type) \
+	(machine->cs_result = CS_RESULT (operand, type), \
+	 machine->cs_lazy = TRUE)
+#define flush_cs() \
+	(machine->cs_lazy ? put_cs () : (void) 0)
+#define set_cs(bits) \
+	(simreg.sw = (simreg.sw & 0x0FFF) | (bits), machine->cs_lazy = FALSE)
+
+void put_cs (void);
 void compare (datatype data_type, short *operand0, short *operand1);
 void arith (operation_kind operation, datatype vartyp,
 	    short *operand0, short *operand1);
 
+#endif
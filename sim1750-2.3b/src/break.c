@@ -30,32 +30,84 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 
 #include "arch.h"
+#include "phys_mem.h"
+#include "cpu.h"	/* for function invalidate_decoded() */
 #include "status.h"
 #include "utils.h"
 #include "cmd.h"	/* for function parse_address() */
-#include "loadfile.h"	/* for the loadfile_type variable */
-#include "tekops.h"	/* for function find_tek_address() */
-#include "coffops.h"	/* for function find_coff_address() */
+#include "loadfile.h"	/* for function find_address() */
 
 #include "break.h"
 
 
-/* Maximum number of breakpoints: */
-#define MAX_BREAK 64
+/* Breakpoint array, grown as needed: */
+#define BREAK_CHUNK 64
 
-static struct
+struct breakpoint
   {
     breaktype type;
     ulong addr;
     char *label;
     bool is_active;
-  } breakpt[MAX_BREAK];	/* breakpoint array */
+  };
 
-int n_breakpts = 0;	/* breakpoint counter */
+static THREAD_LOCAL struct breakpoint *breakpt;
+static THREAD_LOCAL int max_breakpts = 0;	/* allocated size of breakpt[] */
+
+THREAD_LOCAL int n_breakpts = 0;	/* breakpoint counter */
+
+/* Index of the active breakpoints. For each physical page, there is a
+   bitmap of the addresses to be checked on read accesses and one for
+   write accesses, laid out like mem_t.was_written[]. The bitmaps of a
+   page only exist while it holds breakpoints, so that find_breakpt()
+   costs a single test for all other pages. */
+
+#define N_BP_PAGES 256
+
+static THREAD_LOCAL ulong *read_map[N_BP_PAGES], *write_map[N_BP_PAGES];
+static THREAD_LOCAL int    n_on_page[N_BP_PAGES];
+
+static void
+index_breakpt (int bp_index, bool add)
+{
+  ulong addr = breakpt[bp_index].addr;
+  unsigned page = (unsigned) (addr >> 12), offset = (unsigned) addr & 0x0FFF;
+  ulong bit = PAGE_MAP_BIT (offset);
+  breaktype type = breakpt[bp_index].type;
+
+  if (page >= N_BP_PAGES)
+    return;  /* cannot be hit */
+  if (add)
+    {
+      if (n_on_page[page]++ == 0)
+	{
+	  read_map[page] = (ulong *) calloc (PAGE_MAP_LONGS, sizeof (ulong));
+	  write_map[page] = (ulong *) calloc (PAGE_MAP_LONGS, sizeof (ulong));
+	  if (read_map[page] == (ulong *) 0 || write_map[page] == (ulong *) 0)
+	    problem ("no memory for breakpoint index");
+	}
+      if (type != WRITE)
+	read_map[page][PAGE_MAP_INDEX (offset)] |= bit;
+      if (type != READ)
+	write_map[page][PAGE_MAP_INDEX (offset)] |= bit;
+    }
+  else
+    {
+      read_map[page][PAGE_MAP_INDEX (offset)] &= ~bit;
+      write_map[page][PAGE_MAP_INDEX (offset)] &= ~bit;
+      if (--n_on_page[page] == 0)
+	{
+	  free (read_map[page]);
+	  free (write_map[page]);
+	  read_map[page] = write_map[page] = (ulong *) 0;
+	}
+    }
+}
 
 
 /* Return breakpoint index if breakpoint found for given
@@ -63,31 +115,70 @@ int n_breakpts = 0;	/* breakpoint counter */
 int
 find_breakpt (breaktype type, ulong phys_address)
 {
-  int i = n_breakpts;
+  unsigned page = (unsigned) (phys_address >> 12);
+  unsigned offset = (unsigned) phys_address & 0x0FFF;
+  ulong bit = PAGE_MAP_BIT (offset);
+  int i;
 
-  while (i-- > 0)
-    {
-      if (breakpt[i].is_active && breakpt[i].addr == phys_address
-	  && (breakpt[i].type == READ_WRITE || breakpt[i].type == type))
-	break;
-    }
-  return (i);
+  if (page >= N_BP_PAGES || read_map[page] == (ulong *) 0)
+    return -1;
+  if ((type == WRITE || ! (read_map[page][PAGE_MAP_INDEX (offset)] & bit))
+      && (type == READ || ! (write_map[page][PAGE_MAP_INDEX (offset)] & bit)))
+    return -1;
+  for (i = 0; i < n_breakpts; i++)
+    if (breakpt[i].is_active && breakpt[i].addr == phys_address)
+      return i;
+  return -1;
+}
+
+/* Return index of the breakpoint at the given address, active or not */
+static int
+lookup_breakpt (ulong phys_address)
+{
+  int i;
+
+  for (i = 0; i < n_breakpts; i++)
+    if (breakpt[i].addr == phys_address)
+      return i;
+  return -1;
 }
 
 void
 set_inactive (int bp_index)
 {
-  if (bp_index < 0)
+  if (bp_index < 0 || bp_index >= n_breakpts
+      || ! breakpt[bp_index].is_active)
     return;
   breakpt[bp_index].is_active = FALSE;
+  index_breakpt (bp_index, FALSE);
 }
 
 void
 set_active (int bp_index)
 {
-  if (bp_index < 0)
+  if (bp_index < 0 || bp_index >= n_breakpts
+      || breakpt[bp_index].is_active)
     return;
   breakpt[bp_index].is_active = TRUE;
+  index_breakpt (bp_index, TRUE);
+  /* a cached operand word must not bypass the breakpoint */
+  invalidate_decoded (breakpt[bp_index].addr);
+}
+
+void
+clear_breakpts (void)
+{
+  int page;
+
+  for (page = 0; page < N_BP_PAGES; page++)
+    if (n_on_page[page] != 0)
+      {
+	free (read_map[page]);
+	free (write_map[page]);
+	read_map[page] = write_map[page] = (ulong *) 0;
+	n_on_page[page] = 0;
+      }
+  n_breakpts = 0;
 }
 
 
@@ -99,8 +190,6 @@ si_brkset (int argc, char *argv[])
 
   if (argc <= 1)
     return error ("address argument missing");
-  if (n_breakpts >= MAX_BREAK)
-    return error ("too many breakpoints");
   if (parse_address (argv[1], &address) != OKAY)
     {
       if (isalpha (*argv[1]) || *argv[1] == '_')
@@ -127,12 +216,23 @@ si_brkset (int argc, char *argv[])
         return error ("unknown brkpt. type %s (allowed values: R or W)",
 			 argv[2]);
     }
-  if (find_breakpt (READ_WRITE, address) >= 0)
+  if (lookup_breakpt (address) >= 0)
     return error ("breakpoint already set");
+  if (n_breakpts >= max_breakpts)
+    {
+      struct breakpoint *grown = (struct breakpoint *)
+	realloc ((void *) breakpt,
+		 (max_breakpts + BREAK_CHUNK) * sizeof (struct breakpoint));
+      if (grown == (struct breakpoint *) 0)
+	return error ("too many breakpoints");
+      breakpt = grown;
+      max_breakpts += BREAK_CHUNK;
+    }
   breakpt[n_breakpts].type = type;
   breakpt[n_breakpts].addr = address;
-  breakpt[n_breakpts].is_active = TRUE;
-  n_breakpts++;
+  breakpt[n_breakpts].label = (char *) 0;
+  breakpt[n_breakpts].is_active = FALSE;
+  set_active (n_breakpts++);
 
   return OKAY;
 }
@@ -166,21 +266,18 @@ si_brkclear (int argc, char *argv[])
     return error ("no breakpoints set");
   if (*argv[1] == '*')
     {
-      n_breakpts = 0;
+      clear_breakpts ();
       return OKAY;
     }
   if (parse_address (argv[1], &addr))
     return info ("invalid address syntax");
-  for (i = 0; i < n_breakpts; i++)
-    if (breakpt[i].addr == addr)
-      break;
-  if (i == n_breakpts)
+  if ((i = lookup_breakpt (addr)) < 0)
     return info ("\tno breakpoint at that address");
+  set_inactive (i);
   n_breakpts--;
   while (i < n_breakpts)
     {
-      breakpt[i].type = breakpt[i+1].type;
-      breakpt[i].addr = breakpt[i+1].addr;
+      breakpt[i] = breakpt[i+1];
       i++;
     }
 
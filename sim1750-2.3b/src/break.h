@@ -7,9 +7,12 @@
 
 typedef enum { READ_WRITE, READ, WRITE } breaktype;
 
+extern THREAD_LOCAL int n_breakpts;
+
 extern int  find_breakpt (breaktype type, ulong phys_address);
 extern void set_inactive (int bp_index);
 extern void set_active   (int bp_index);
+extern void clear_breakpts (void);
 
 extern int  si_brkset   (int argc, char *argv[]);
 extern int  si_brklist  (int argc, char *argv[]);
@@ -0,0 +1,650 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : btrace.c -- backtrace ring                                  */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* btrace.c  --  delta-encoded backtrace ring.
+
+   Before each instruction add_to_backtrace() (cpu.c) copies the
+   register file, cs_lazy and cs_result, which lead the machine context
+   in the same layout as a struct bt_entry, into the next entry of a
+   small staging batch, and puts in the cycle. Nothing is compared or
+   encoded there: the CS may still be pending, and TA, TB and GO are as
+   of the last sync_timers().
+
+   When the batch is full, bt_sync() packs it into a ring of bytes, each
+   entry encoded relative to the previous one. An entry starts with a
+   header byte:
+
+	bits 0..1  IC: 0 = previous IC + 1, 1 = previous IC + 2,
+		       2 = new IC follows, 3 = not an entry, see below
+	bit  2     a byte follows with one bit per changed register of
+		   PIR, MK, FT, SW, TA, TB, GO, SYS (bit 0 = PIR)
+	bits 3..7  GPRs: 0 = unchanged, 1..16 = only R0..R15 changed,
+		   17 = a 16 bit mask of changed GPRs follows (bit n = Rn)
+
+   followed by the new IC if any, the masks, the cycles since the
+   previous entry (one byte, or 255 and four bytes) and the changed
+   values. Values are most significant byte first; SW has the CS put
+   in. With bits 0..1 set, the header is one of
+
+	R_KEY   a keyframe: an entry holding all 25 registers (R0..R15,
+		PIR, MK, FT, IC, SW, TA, TB, GO, SYS), its cycle, and the
+		timer state as in R_SYNC
+	R_SYNC  the timers were synced: timers_synced and the prescalers
+		for the entries from here on
+
+   Every BT_KEY_INTERVAL entries a keyframe is written and remembered in
+   keys[]. Decoding starts at the newest keyframe still in the ring at
+   or before the wanted entry, and steps forward from there; the entries
+   not packed yet are read from the batch. An instruction typically
+   takes four or five bytes, so the default ring of 8 MB reaches some
+   1.8 million instructions back.
+
+   sync_timers() calls bt_timers_changed(), which sets the end of the
+   batch to the next entry, so that add_to_backtrace() calls bt_sync()
+   before writing it. bt_sync() packs the batch and logs the new timer
+   state; it is also where the ring is allocated. Stepping TA, TB and GO
+   to the cycle of an entry is left to displaying the backtrace.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "arch.h"
+#include "status.h"
+#include "cpu.h"
+#include "btrace.h"
+
+#define BT_BATCH         256		/* entries staged before packing */
+#define BT_KEY_INTERVAL  1024		/* entries */
+#define BT_MIN_SIZE      (64L << 10)	/* bytes */
+#define BT_DEFAULT_SIZE  (8L << 20)
+
+#define R_KEY   (3 | 0 << 3)
+#define R_SYNC  (3 | 1 << 3)
+
+#define ring  (machine->bt)
+
+/* Entries recorded */
+#define TOTAL  (ring.packed + (ulong) (ring.next - ring.stage))
+
+/* PIR, MK, FT, SW, TA, TB, GO, SYS in the order of the special mask */
+static const size_t special_offset[8] =
+  {
+    offsetof (struct regs, pir), offsetof (struct regs, mk),
+    offsetof (struct regs, ft),  offsetof (struct regs, sw),
+    offsetof (struct regs, ta),  offsetof (struct regs, tb),
+    offsetof (struct regs, go),  offsetof (struct regs, sys)
+  };
+
+#define SPECIAL(r,i)  (*(ushort *) ((char *) (r) + special_offset[i]))
+
+
+/* Set the size of the ring to at least `bytes' (rounded up to a power
+   of two), discarding its contents. */
+
+int
+bt_resize (ulong bytes)
+{
+  ulong size = BT_MIN_SIZE;
+
+  while (size < bytes && size < 0x40000000L)
+    size <<= 1;
+  bt_release (&ring);
+  /* keyframes are at least BT_KEY_INTERVAL entries of two bytes apart */
+  ring.n_keys = size / (2 * BT_KEY_INTERVAL) + 2;
+  if ((ring.buf = (unsigned char *) malloc (size)) == 0
+      || (ring.keys = (struct bt_key *) malloc (ring.n_keys
+					      * sizeof (struct bt_key))) == 0
+      || (ring.stage = (struct bt_entry *) malloc (BT_BATCH
+					      * sizeof (struct bt_entry))) == 0)
+    {
+      bt_release (&ring);
+      return error ("no memory for a backtrace of %lu bytes", size);
+    }
+  ring.mask = size - 1;
+  ring.next = ring.end = ring.stage;	/* to log the timers first */
+  ring.sync_pending = TRUE;
+  return OKAY;
+}
+
+
+void
+bt_release (struct bt_ring *b)
+{
+  if (b->buf != (unsigned char *) 0)
+    free ((void *) b->buf);
+  if (b->keys != (struct bt_key *) 0)
+    free ((void *) b->keys);
+  if (b->stage != (struct bt_entry *) 0)
+    free ((void *) b->stage);
+  memset ((void *) b, 0, sizeof (struct bt_ring));
+}
+
+
+/* The timers were synced: have the next entry log them. */
+
+void
+bt_timers_changed (void)
+{
+  ring.end = ring.next;
+  ring.sync_pending = TRUE;
+}
+
+
+/* SW of entry `e' with the CS put in, as flush_cs() would. Without
+   branches: whether the CS was lazy, and its sign, change from one
+   entry to the next in no pattern the host could predict. */
+
+static ushort
+entry_sw (const struct bt_entry *e)
+{
+  ushort lazy = (ushort) -(e->cs_lazy != 0) & 0x7000;
+  ushort cs = (e->cs_result > 0) * CS_POSITIVE
+	      | (e->cs_result == 0) * CS_ZERO
+	      | (e->cs_result < 0) * CS_NEGATIVE;
+
+  return (e->regs.sw & ~lazy) | (cs & lazy);
+}
+
+
+/* The registers of entry `e' with the CS put in */
+
+static void
+put_cs (struct regs *r, const struct bt_entry *e)
+{
+  *r = e->regs;
+  r->sw = entry_sw (e);
+}
+
+
+/* A record is written straight into the ring unless it might reach
+   past the end, in which case it is put together in a local buffer
+   and copied. MAX_RECORD also bounds the bytes pack() stores beyond
+   the end of a record. */
+#define MAX_RECORD  80
+#define EMIT(b)     (*p++ = (unsigned char) (b))
+#define EMIT16(w)   (p[0] = (unsigned char) ((w) >> 8), \
+		     p[1] = (unsigned char) (w), p += 2)
+#define EMIT32(l)   (EMIT16 ((l) >> 16), EMIT16 (l))
+#define RECORD_START() \
+	  (p = ((head & mask) + MAX_RECORD <= mask + 1) \
+	       ? buf + (head & mask) : local)
+#define RECORD_END() \
+	  do \
+	    { \
+	      ulong i_, n_ = p - start; \
+	      \
+	      if (start == local) \
+		for (i_ = 0; i_ < n_; i_++) \
+		  buf[(head + i_) & mask] = local[i_]; \
+	      head += n_; \
+	    } \
+	  while (0)
+
+static unsigned char *
+emit_sync (unsigned char *p, struct bt_sync *s)
+{
+  EMIT32 (s->synced);
+  EMIT32 (s->tatick_in_ns);
+  EMIT16 (s->tbtick_in_tatix);
+  EMIT16 (s->gotick_in_10usec);
+  return p;
+}
+
+/* Index of the lowest bit set in `bits' (not 0) */
+
+static unsigned
+lowest_bit (unsigned bits)
+{
+  static const unsigned char nibble[16] =
+    { 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+  unsigned i = 0;
+
+  while ((bits & 0x0F) == 0)
+    {
+      bits >>= 4;
+      i += 4;
+    }
+  return i + nibble[bits & 0x0F];
+}
+
+
+/* Bits 0..15 set for R0..R15 that differ between `a' and `b', and bits
+   16..23 for PIR, MK, FT, IC, SW, TA, TB, GO; with SSE2, compared
+   eight at a time. */
+
+static ulong
+changed_regs (const struct regs *a, const struct regs *b)
+{
+#ifdef __SSE2__
+  __m128i lo = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i *) &a->r[0]),
+				_mm_loadu_si128 ((const __m128i *) &b->r[0]));
+  __m128i hi = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i *) &a->r[8]),
+				_mm_loadu_si128 ((const __m128i *) &b->r[8]));
+  __m128i sp = _mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i *) &a->pir),
+				_mm_loadu_si128 ((const __m128i *) &b->pir));
+
+  return ~((ulong) _mm_movemask_epi8 (_mm_packs_epi16 (lo, hi))
+	   | (ulong) (_mm_movemask_epi8 (_mm_packs_epi16 (sp, sp)) & 0xFF) << 16)
+	 & 0xFFFFFFL;
+#else
+  const ushort *x = (const ushort *) a, *y = (const ushort *) b;
+  ulong m = 0;
+  int i;
+
+  for (i = 0; i < 24; i++)
+    m |= (ulong) (x[i] != y[i]) << i;
+  return m;
+#endif
+}
+
+
+/* n for a single bit 1 << n at (1 << n) % 19, n = 0..15, and at
+   (1 << n) % 11, n = 0..7: the remainders all differ. 0 for no bit. */
+static const unsigned char gpr_of_bit[19] =
+  { 0, 0, 1, 13, 2, 0, 14, 6, 3, 8, 0, 12, 15, 5, 7, 11, 4, 10, 9 };
+static const unsigned char special_of_bit[11] =
+  { 0, 0, 1, 0, 2, 4, 0, 7, 3, 6, 5 };
+
+
+/* Pack the entries from `e' up to `end' into the ring, and then the
+   timer state if `sync' is given. Each entry is compared with the one
+   before it where it stands in the batch, rather than copied out. The
+   state of the ring is kept in local variables meanwhile, as the bytes
+   written might alias it. */
+
+static void
+pack (struct bt_entry *e, struct bt_entry *end, struct bt_sync *sync)
+{
+  unsigned char *buf = ring.buf, local[MAX_RECORD], *start, *p;
+  ulong mask = ring.mask, head = ring.head, packed = ring.packed;
+  ulong since_key = ring.since_key, cycles, m;
+  const struct regs *r, *last = &ring.last;
+  ushort sw, last_sw = ring.last.sw;
+  unsigned last_cycle = ring.last_cycle;
+  unsigned hdr, gprs, specials, gi, multi, i, n, q;
+
+  for (; e < end; e++)
+    {
+      start = RECORD_START ();
+      r = &e->regs;
+      sw = entry_sw (e);
+      if (since_key == 0)
+	{
+	  struct bt_key *k = &ring.keys[ring.key_total++ % ring.n_keys];
+
+	  k->entry = packed;
+	  k->offset = head;
+	  EMIT (R_KEY);
+	  for (i = 0; i < 16; i++)
+	    EMIT16 ((ushort) r->r[i]);
+	  EMIT16 (r->pir); EMIT16 (r->mk); EMIT16 (r->ft); EMIT16 (r->ic);
+	  EMIT16 (sw);     EMIT16 (r->ta); EMIT16 (r->tb); EMIT16 (r->go);
+	  EMIT16 (r->sys);
+	  EMIT32 (e->cycle);
+	  p = emit_sync (p, &ring.sync);
+	}
+      else
+	{
+	  /* Each field is stored whether it is needed or not, and q only
+	     moves on past those that are: for the usual entry, with one
+	     GPR and one special register changed at most, that takes
+	     fewer branches for the host to mispredict than testing for
+	     each field. */
+	  n = (ushort) (r->ic - last->ic);
+	  hdr = (n != 1) + (n - 1 > 1);
+	  m = changed_regs (r, last);
+	  gprs = (unsigned) m & 0xFFFF;
+	  gi = gpr_of_bit[gprs % 19];
+	  /* PIR, MK, FT but not IC; then TA, TB, GO: the SW in the
+	     batch lacks its CS */
+	  specials = ((unsigned) (m >> 16) & 7)
+		     | (unsigned) (sw != last_sw) << 3
+		     | ((unsigned) (m >> 17) & 0x70)
+		     | (unsigned) (r->sys != last->sys) << 7;
+	  multi = (gprs & (gprs - 1)) != 0;
+	  hdr |= (specials != 0) << 2
+		 | (multi ? 17 : (gprs != 0) * (gi + 1)) << 3;
+	  start[0] = (unsigned char) hdr;
+	  q = 1;
+	  start[q] = (unsigned char) (r->ic >> 8);
+	  start[q + 1] = (unsigned char) r->ic;
+	  q += (hdr & 3) == 2 ? 2 : 0;
+	  start[q] = (unsigned char) specials;
+	  q += (specials != 0);
+	  start[q] = (unsigned char) (gprs >> 8);
+	  start[q + 1] = (unsigned char) gprs;
+	  q += multi << 1;
+	  cycles = (unsigned) (e->cycle - last_cycle);
+	  if (cycles < 255)
+	    start[q++] = (unsigned char) cycles;
+	  else
+	    {
+	      p = start + q;
+	      EMIT (255);
+	      EMIT32 (cycles);
+	      q += 5;
+	    }
+	  if (! multi)
+	    {
+	      start[q] = (unsigned char) ((ushort) r->r[gi] >> 8);
+	      start[q + 1] = (unsigned char) r->r[gi];
+	      q += (gprs != 0) << 1;
+	    }
+	  else
+	    for (p = start + q; gprs != 0; gprs &= gprs - 1, q += 2)
+	      EMIT16 ((ushort) r->r[lowest_bit (gprs)]);
+	  if ((specials & (specials - 1)) == 0)
+	    {
+	      i = special_of_bit[specials % 11];
+	      n = SPECIAL (r, i);
+	      n = (i == 3) ? sw : n;
+	      start[q] = (unsigned char) (n >> 8);
+	      start[q + 1] = (unsigned char) n;
+	      q += (specials != 0) << 1;
+	    }
+	  else
+	    for (p = start + q; specials != 0; specials &= specials - 1, q += 2)
+	      {
+		i = lowest_bit (specials);
+		EMIT16 ((i == 3) ? sw : SPECIAL (r, i));
+	      }
+	  p = start + q;
+	}
+      RECORD_END ();
+      last = r;
+      last_sw = sw;
+      last_cycle = e->cycle;
+      packed++;
+      if (++since_key == BT_KEY_INTERVAL)
+	since_key = 0;
+    }
+  if (sync != (struct bt_sync *) 0)
+    {
+      start = RECORD_START ();
+      EMIT (R_SYNC);
+      p = emit_sync (p, sync);
+      RECORD_END ();
+    }
+
+  if (last != &ring.last)
+    {
+      ring.last = *last;
+      ring.last.sw = last_sw;
+    }
+  ring.head = head;
+  ring.packed = packed;
+  ring.since_key = since_key;
+  ring.last_cycle = last_cycle;
+}
+
+
+/* Called by add_to_backtrace() when the next entry is at the end of the
+   batch: allocate the ring if need be, pack the batch, and log the
+   timers if they were synced. Returns the next entry, or 0 if there is
+   no ring. */
+
+struct bt_entry *
+bt_sync (void)
+{
+  if (ring.buf == (unsigned char *) 0 && bt_resize (BT_DEFAULT_SIZE) != OKAY)
+    return (struct bt_entry *) 0;
+  if (! ring.sync_pending)
+    pack (ring.stage, ring.next, (struct bt_sync *) 0);
+  else
+    {
+      struct bt_sync s;
+
+      s.synced = (unsigned) machine->timers_synced;
+      s.tatick_in_ns = machine->one_tatick_in_ns;
+      s.tbtick_in_tatix = machine->one_tbtick_in_tatix;
+      s.gotick_in_10usec = machine->one_gotick_in_10usec;
+      pack (ring.stage, ring.next, &s);
+      ring.sync = s;
+      ring.sync_pending = FALSE;
+    }
+  ring.next = ring.stage;
+  ring.end = ring.stage + BT_BATCH;
+  return ring.next;
+}
+
+
+#define GET(off)    ring.buf[(off)++ & ring.mask]
+#define GET16(off)  get16 (&(off))
+#define GET32(off)  get32 (&(off))
+
+static ushort
+get16 (ulong *offset)
+{
+  ushort w = (ushort) (GET (*offset) << 8);
+
+  return w | GET (*offset);
+}
+
+static ulong
+get32 (ulong *offset)
+{
+  ulong l = (ulong) get16 (offset) << 16;
+
+  return l | get16 (offset);
+}
+
+static ulong
+get_sync (ulong off, struct bt_sync *s)
+{
+  s->synced = (unsigned) GET32 (off);
+  s->tatick_in_ns = GET32 (off);
+  s->tbtick_in_tatix = GET16 (off);
+  s->gotick_in_10usec = GET16 (off);
+  return off;
+}
+
+
+/* Read the record at the cursor's offset, which follows the cursor's
+   entry. Returns FALSE if it was a sync, which only sets c->sync. */
+
+static bool
+unpack (struct bt_cursor *c)
+{
+  struct regs *r = &c->raw;
+  ulong off = c->offset, cycles;
+  unsigned hdr = GET (off), gprs = 0, specials = 0, i;
+
+  if (hdr == R_SYNC)
+    {
+      c->offset = get_sync (off, &c->sync);
+      return FALSE;
+    }
+  if (hdr == R_KEY)
+    {
+      for (i = 0; i < 16; i++)
+	r->r[i] = (short) GET16 (off);
+      r->pir = GET16 (off); r->mk = GET16 (off);
+      r->ft = GET16 (off);  r->ic = GET16 (off);
+      r->sw = GET16 (off);  r->ta = GET16 (off);
+      r->tb = GET16 (off);  r->go = GET16 (off);
+      r->sys = GET16 (off);
+      c->cycle = (unsigned) GET32 (off);
+      c->offset = get_sync (off, &c->sync);
+      return TRUE;
+    }
+  if ((hdr & 3) == 2)
+    r->ic = GET16 (off);
+  else
+    r->ic += (hdr & 3) + 1;
+  if (hdr & 4)
+    specials = GET (off);
+  if ((hdr >> 3) == 17)
+    gprs = GET16 (off);
+  else if ((hdr >> 3) > 0)
+    gprs = 1 << ((hdr >> 3) - 1);
+  if ((cycles = GET (off)) == 255)
+    cycles = GET32 (off);
+  c->cycle += (unsigned) cycles;
+  for (i = 0; i < 16; i++)
+    if (gprs & (1 << i))
+      r->r[i] = (short) GET16 (off);
+  for (i = 0; i < 8; i++)
+    if (specials & (1 << i))
+      SPECIAL (r, i) = GET16 (off);
+  c->offset = off;
+  return TRUE;
+}
+
+
+/* Move the cursor on to entry c->entry + 1 */
+
+static void
+advance (struct bt_cursor *c)
+{
+  c->entry++;
+  if (c->entry >= ring.packed)
+    {
+      struct bt_entry *e = &ring.stage[c->entry - ring.packed];
+
+      put_cs (&c->raw, e);
+      c->cycle = e->cycle;
+      c->sync = ring.sync;
+    }
+  else
+    while (! unpack (c))
+      ;
+}
+
+
+/* Bring the registers of the cursor's entry up to date, as
+   sync_timers() would have. */
+
+static void
+decode (struct bt_cursor *c)
+{
+  struct regs *r = &c->regs;
+  ulong tatick_in_ns = c->sync.tatick_in_ns;
+  ushort tbtick_in_tatix = c->sync.tbtick_in_tatix;
+  ushort gotick_in_10usec = c->sync.gotick_in_10usec;
+  ushort overflow;
+
+  *r = c->raw;
+  overflow = step_timers (r, (ulong) (c->cycle - c->sync.synced),
+			  &tatick_in_ns, &tbtick_in_tatix, &gotick_in_10usec);
+  r->pir |= overflow;
+  if (overflow & INTR_MACHERR)
+    r->ft |= FT_SYSFAULT0;
+}
+
+
+/* A keyframe is usable while none of the bytes from it up to the
+   head of the ring have been overwritten; pack() may scribble on up
+   to MAX_RECORD bytes past the head. */
+
+#define KEY_VALID(k)  (ring.head - (k)->offset + MAX_RECORD <= ring.mask + 1)
+
+/* The oldest keyframe still usable, or 0 if there is none */
+
+static struct bt_key *
+oldest_key (void)
+{
+  ulong n = (ring.key_total > ring.n_keys) ? ring.key_total - ring.n_keys : 0;
+
+  for (; n < ring.key_total; n++)
+    if (KEY_VALID (&ring.keys[n % ring.n_keys]))
+      return &ring.keys[n % ring.n_keys];
+  return (struct bt_key *) 0;
+}
+
+
+/* Number of entries that can be decoded: the staged ones, and the
+   packed ones from the oldest usable keyframe on */
+
+ulong
+bt_depth (void)
+{
+  struct bt_key *k = oldest_key ();
+
+  if (ring.stage == (struct bt_entry *) 0)
+    return 0;
+  return TOTAL - ((k != (struct bt_key *) 0) ? k->entry : ring.packed);
+}
+
+
+/* Position the cursor at the entry `back' instructions ago (1 being the
+   latest one). Returns ERROR if the ring does not reach back as far. */
+
+int
+bt_seek (struct bt_cursor *c, ulong back)
+{
+  ulong target, n;
+  struct bt_key *k = (struct bt_key *) 0;
+
+  if (back == 0 || back > bt_depth ())
+    return ERROR;
+  target = TOTAL - back;
+  if (target >= ring.packed)
+    {
+      c->entry = target - 1;
+      advance (c);
+    }
+  else
+    {
+      for (n = ring.key_total; n > 0; n--)
+	{
+	  k = &ring.keys[(n - 1) % ring.n_keys];
+	  if (k->entry <= target)
+	    break;
+	}
+      c->entry = k->entry;
+      c->offset = k->offset;
+      unpack (c);
+      while (c->entry < target)
+	advance (c);
+    }
+  decode (c);
+  return OKAY;
+}
+
+
+/* Advance the cursor to the next entry. Returns FALSE if there is none. */
+
+bool
+bt_step (struct bt_cursor *c)
+{
+  if (c->entry + 1 >= TOTAL)
+    return FALSE;
+  advance (c);
+  decode (c);
+  return TRUE;
+}
+
+
+/* Size of the ring in bytes */
+
+ulong
+bt_size (void)
+{
+  return (ring.buf == (unsigned char *) 0) ? 0 : ring.mask + 1;
+}
@@ -0,0 +1,28 @@
+/* btrace.h -- exports of btrace.c */
+
+#ifndef _BTRACE_H
+#define _BTRACE_H
+
+#include "arch.h"
+
+/* Position within the backtrace, with the register file there */
+struct bt_cursor
+  {
+    ulong entry;		/* entry number */
+    ulong offset;		/* of the next record in the ring */
+    struct regs raw;		/* the entry as recorded, with its CS */
+    unsigned cycle;
+    struct bt_sync sync;	/* timer state in effect for it */
+    struct regs regs;		/* the registers, timers brought up to date */
+  };
+
+extern struct bt_entry *bt_sync (void);
+extern void  bt_timers_changed (void);
+extern int   bt_resize (ulong bytes);
+extern void  bt_release (struct bt_ring *b);
+extern ulong bt_size (void);
+extern ulong bt_depth (void);
+extern int   bt_seek (struct bt_cursor *c, ulong back);
+extern bool  bt_step (struct bt_cursor *c);
+
+#endif
@@ -47,18 +47,26 @@
 #endif
 
 #include "arch.h"
+#include "arith.h"
 #include "break.h"
 #include "cmd.h"
 #include "cpu.h"
 #include "exec.h"
 #include "flt1750.h"
+#include "image.h"
+#include "jit.h"
 #include "loadfile.h"
+#include "machine.h"
 #include "phys_mem.h"
+#include "profile.h"
+#include "opstats.h"
+#include "coverage.h"
 #include "peekpoke.h"
 #include "smemacc.h"
 #include "version.h"
 #include "status.h"
 #include "tekops.h"
+#include "tracefile.h"
 #include "utils.h"
 
 /* imports not mentioned in includefiles */
@@ -73,18 +81,22 @@ extern char *disassemble ();		  /* sdisasm.c */
 
 static const char *prompt = "command > ";
 
-static bool  batchbreak = TRUE;	/* breaking batch allowed                 */
-static long  int_count = 0;	/* number of interrupts from keyboard     */
-static char  logfilename[128];
-static int   leave = 0;			/* leave command interpreter */
+/* The interpreter state is per thread, see farm.c */
+static THREAD_LOCAL bool  batchbreak = TRUE;	/* breaking batch allowed */
+static THREAD_LOCAL long  int_count = 0;	/* keyboard interrupts    */
+static THREAD_LOCAL char  logfilename[128];
+static THREAD_LOCAL int   leave = 0;		/* leave interpreter      */
+static char *engine_name[] =	/* indexed by engine_mode */
+  { "Interpreter", "Basic block", "Basic block with JIT", "JIT lockstep" };
 
 #define P (int argc, char *argv[])
 static int co_batch P, co_logopen P, co_logclose P, co_sh P, co_exit P;
-static int co_echo P, co_help P, co_info P, co_speed P;
+static int co_echo P, co_help P, co_info P, co_speed P, co_engine P;
 static int co_version P, co_shoc P, co_war P;
 static int si_dispreg P, si_disasm P, si_dispmem P, si_dispflt P;
 static int si_dispeflt P, si_dispchar P, si_changemem P, si_changereg P;
 static int si_init P, si_reset P, si_tr P, si_page P, si_fill P;
+static int si_snapshot P, si_restore P;
 #undef P
 
 static const struct {
@@ -133,9 +145,62 @@ static const struct {
 
    { "trace [n]",              si_trace,    "trace the next n instructions",
        "Continually display the register file as each instruction is executed." },
+   { "tracefile [<file>|off]", si_tracefile, "write a binary trace to file",
+       "From TRACEFILE <file> on, each instruction executed is written to\n"
+       "the file in a compact binary form: cycle count, address state, IC,\n"
+       "instruction words, the registers it changed (except the timers)\n"
+       "and the memory it stored to. Stores done otherwise, as by CMEM or\n"
+       "loading a file, are written as such. The file is completed by\n"
+       "TRACEFILE OFF or on leaving the simulator. Without argument, the\n"
+       "number of instructions traced so far is shown. While tracing, GO\n"
+       "always uses the instruction-by-instruction interpreter, and takes\n"
+       "about 1.7 times as long. Use sim1750-tracedump to display the\n"
+       "trace." },
    { "btrace n1 [n2]",         si_bt,       "go back n1 and retrace the next n2 instructions",
-       "" },
-
+       "The register file before each instruction is kept in a backtrace\n"
+       "buffer (unless SPEED ON). BTRACE displays it for n2 (default 10)\n"
+       "instructions, starting n1 (default 10) instructions back. Both\n"
+       "numbers are hexadecimal. See BTSIZE for how far back it reaches." },
+   { "btsize [megabytes]",     si_btsize,   "set size of the backtrace buffer",
+       "Given a size, the backtrace buffer is reallocated with that many\n"
+       "megabytes rounded up to a power of two (1024 at most), dropping its\n"
+       "contents, and the size set is shown. Otherwise its size and the\n"
+       "number of instructions it reaches back are displayed. Each\n"
+       "instruction is kept as its changes from the one before, typically\n"
+       "in four or five bytes, so the default of eight megabytes reaches\n"
+       "about 1.8 million instructions back." },
+
+   { "profile [on|off|report [n]|callgrind <file>]",
+			       si_profile,  "count instructions and cycles per address",
+       "PROFILE ON discards any previous counts and starts counting the\n"
+       "instructions executed and their cycles at each address. PROFILE OFF\n"
+       "stops counting. PROFILE REPORT lists the n (default 20) functions\n"
+       "taking the most cycles, each address being counted to the nearest\n"
+       "label at or below it in the symbols of the file last loaded.\n"
+       "PROFILE CALLGRIND writes these counts and the call graph (calls\n"
+       "made by SJS, JS and interrupts, with the cycles and instructions\n"
+       "spent until the return) to <file> in callgrind format, to be read\n"
+       "by KCachegrind or callgrind_annotate.\n"
+       "While profiling, GO always uses the instruction-by-instruction\n"
+       "interpreter (ENGINE INTERP)." },
+   { "coverage [on|off|report|lcov <file>]",
+			       si_coverage, "record which code and branches were executed",
+       "COVERAGE ON discards any previous coverage and starts marking the\n"
+       "addresses of the instructions executed, and whether conditional\n"
+       "branches were taken or not. Restoring a snapshot keeps the\n"
+       "coverage. COVERAGE REPORT shows the totals and the branches that\n"
+       "did not yet go both ways. COVERAGE LCOV writes the coverage per\n"
+       "source line to <file> in lcov format, using the line numbers of\n"
+       "the COFF file last loaded (compiled with -g). While recording\n"
+       "coverage, GO always uses the instruction-by-instruction\n"
+       "interpreter (ENGINE INTERP)." },
+   { "stats [n|reset]",         si_stats,    "show opcode and instruction class statistics",
+       "Only if sim1750 was compiled with -DOPSTATS: lists the n (default\n"
+       "20) most executed instructions, the instructions and cycles per\n"
+       "class (integer, float, extended float, branch, XIO), and the\n"
+       "opcodes that were not executed at all. STATS RESET clears the\n"
+       "counts. With -DOPSTATS, GO always uses the instruction-by-\n"
+       "instruction interpreter (ENGINE INTERP)." },
    { "info [on|off]",          co_info,     "print interpreter status info",
        "If given without an argument, the 'info' command displays statistics\n"
        "of the execution underway. If given with the argument 'on' or 'off',\n"
@@ -145,6 +210,19 @@ static const struct {
        "in simulation execution. Under DOS only, SP ON additionally\n"
        "disables <Ctrl-C> keypress checking, resulting in a substantial\n"
        "simulation speedup. SP OFF re-enables the above feature(s).\n" },
+   { "engine [interp|block|jit|lockstep]",
+			       co_engine,   "select execution engine",
+       "ENGINE BLOCK makes the GO command run the program as basic blocks\n"
+       "of predecoded instructions which are chained to their successors.\n"
+       "Timers and interrupts are then updated at the end of each block\n"
+       "instead of after each instruction. While breakpoints are set, GO\n"
+       "uses the instruction-by-instruction interpreter (ENGINE INTERP)\n"
+       "regardless of this setting. SS and TRACE always use the latter.\n"
+       "ENGINE JIT additionally translates frequently executed blocks into\n"
+       "host machine code (x86-64 only). Translated code is only used with\n"
+       "SPEED ON. ENGINE LOCKSTEP runs each translated block, undoes its\n"
+       "effects, and runs it again through the interpreter, reporting any\n"
+       "difference in registers, memory writes, or cycle counts." },
    { "version",                co_version,  "print version information",
        "" },
 
@@ -152,6 +230,17 @@ static const struct {
        "" },
    { "reset",                  si_reset,    "reset registers and MMU only",
        "All CPU and MMU registers are set to zero." },
+   { "snapshot [name]",        si_snapshot, "save the machine state",
+       "Save the registers, page registers, timers, instruction count and\n"
+       "memory under the given name, replacing any snapshot of the same\n"
+       "name. Without the name argument, the snapshots are listed.\n"
+       "Memory is shared with the snapshot until it is written to, so\n"
+       "taking a snapshot is cheap." },
+   { "restore <name>",         si_restore,  "go back to a snapshot",
+       "Return the machine to the state saved by SNAPSHOT <name>. Only\n"
+       "the memory pages written since are exchanged, so restoring e.g.\n"
+       "a post-boot state before each test case is fast. Breakpoints are\n"
+       "not part of the snapshot." },
    { "translate <address>",    si_tr,       "translate logical to phys. addr.",
        "The simulator supports MMU operations. When using the MMU, a\n"
        "mapping is done to get from a 16-bit logical address to a 20-bit\n"
@@ -226,7 +315,16 @@ static const struct {
    { "save <file>",               si_save,     "save image of memory to file",
        "Save an image of the currently active memory, i.e. those parts of\n"
        "the entire address space that have been written to at least once.\n"
-       "The file format used for saving is the Extended Tek Hex format." },
+       "The file format used for saving is the Extended Tek Hex format.\n"
+       "Only IC is saved of the registers; see IMSAVE for a complete image." },
+   { "imsave <file>",             si_imsave,   "save machine image to file",
+       "Save the complete state of the machine, i.e. registers, page\n"
+       "registers, timers and memory, to a binary image file. The file\n"
+       "can be loaded by IMLOAD or the -s option of a simulator built for\n"
+       "the same host, and is loaded much faster than a load module." },
+   { "imload <file>",             si_imload,   "load machine image from file",
+       "Load a binary image file written by IMSAVE. The machine continues\n"
+       "in the state it was saved in." },
    { "symbols",                  si_dispsym,  "display symbols found in memory",
        "Some load module formats support the embedding of symbol strings.\n"
        "Display all such symbol names currently loaded." },
@@ -248,7 +346,10 @@ static const struct {
        "for <length>. If no start argument is given, then disassemble from\n"
        "the current Instruction Counter onwards. If no length argument is\n"
        "given, then disassemble for one instruction, or for the last\n"
-       "specified length in a previous DI command if any such was given." },
+       "specified length in a previous DI command if any such was given.\n"
+       "Labels of the file last loaded are shown above their addresses; if\n"
+       "<start> has none, the nearest label below it is shown with the\n"
+       "offset from it." },
    { "creg r<num> <val>",      si_changereg,"change register to new value",
        "Change the register contents of the given register. The <val>\n"
        "argument is in hexadecimal." },
@@ -299,8 +400,8 @@ static const struct {
 
 
 #define MAXINFILES 10
-FILE *infiles[MAXINFILES];
-int  actinfile;
+THREAD_LOCAL FILE *infiles[MAXINFILES];
+THREAD_LOCAL int  actinfile;
 
 
 static int
@@ -451,6 +552,20 @@ interpreter (char *startup_batchfile)
 }
 
 
+/* Run the interpreter reading from `input' in place of stdin.
+   Used by the worker threads of the farm mode (farm.c). */
+
+int
+batch_interpreter (FILE *input, char *startup_batchfile)
+{
+  actinfile = 0;
+  infiles[0] = input;
+  leave = 0;
+  int_count = 0;
+  return interpreter (startup_batchfile);
+}
+
+
 static int
 init_io (int mode)
 {
@@ -469,6 +584,7 @@ init_io (int mode)
       for (i = actinfile; i > 0; i--)
 	fclose (infiles[i]);
       int_handler_install (1);	/* restore old interrupt handler */
+      trace_close ();
       if (logfile != (FILE *) 0)
 	fclose (logfile);
     }
@@ -746,6 +862,7 @@ co_info (int argc, char *argv[])
   lprintf ("\tAllocation:\t%ld words of simulation memory\n", allocated/2);
   lprintf ("\tOptimization in favor of (speed|features):\t%s\n",
 	   need_speed ? "Speed" : "Features");
+  lprintf ("\tExecution engine:\t%s\n", engine_name[engine_mode]);
   lprintf ("\tInstruction Count:\t%ld\n", instcnt);
   lprintf ("\tExecution time (uSec):\t%0.3f\n", total_time_in_us);
   lprintf ("\tMemory regions used:\n");
@@ -811,6 +928,31 @@ co_speed (int argc, char *argv[])
   return (OKAY);
 }
 
+static int
+co_engine (int argc, char *argv[])
+{
+  if (argc > 1)
+    {
+      if (eq (argv[1], "interp"))
+	engine_mode = ENGINE_INTERP;
+      else if (eq (argv[1], "block"))
+	engine_mode = ENGINE_BLOCK;
+      else if (eq (argv[1], "jit") || eq (argv[1], "lockstep"))
+	{
+	  if (! jit_available)
+	    return error ("no code translation available on this host");
+	  engine_mode = eq (argv[1], "jit") ? ENGINE_JIT : ENGINE_LOCKSTEP;
+	  if (! need_speed)
+	    warning ("translated code is only used with SPEED ON");
+	}
+      else
+	return error
+	  ("invalid parameter -- must be 'interp', 'block', 'jit' or 'lockstep'");
+    }
+  info ("Execution engine is %s", engine_name[engine_mode]);
+  return (OKAY);
+}
+
 static int
 co_version (int argc, char *argv[])
 {
@@ -913,8 +1055,9 @@ si_disasm (int argc, char *argv[])
   int i, n_words;
   char *sym, disasm_text[100];
   ushort words[2];
-  static ulong address = 0L;
-  static int length = 1;
+  ulong offset;
+  static THREAD_LOCAL ulong address = 0L;
+  static THREAD_LOCAL int length = 1;
   bool verbose_save = verbose;
 
   if (argc > 1)
@@ -937,6 +1080,8 @@ si_disasm (int argc, char *argv[])
 	return (INTERRUPT);
       if ((sym = find_labelname (address)) != NULL)
 	lprintf ("                      %s\n", sym);
+      else if (i == 0 && (sym = find_nearest_label (address, &offset)) != NULL)
+	lprintf ("                      %s+%lX\n", sym, offset);
       lprintf ("%05lX     ", address);
       if (! peek (address, &words[0]))
 	{
@@ -974,6 +1119,8 @@ dis_reg ()
   int i;
 #define state(flag)  ((simreg.sys & flag) ? 'E' : 'D')
 
+  sync_timers ();
+  flush_cs ();
   for (i = 0; i < 16; i++)
     {
       lprintf ("R%02d:%04X", i, (unsigned) simreg.r[i] & 0xFFFF);
@@ -1016,8 +1163,8 @@ static int
 si_dispmem (int argc, char *argv[])
 {
   int i;
-  static ulong address = 0L;
-  static int length = 1;
+  static THREAD_LOCAL ulong address = 0L;
+  static THREAD_LOCAL int length = 1;
   bool verbose_save = verbose;
 
   if (argc > 1)
@@ -1059,8 +1206,8 @@ si_dispflt (int argc, char *argv[])
 {
   int i;
   short fltwords[2];
-  static ulong address = 0L;
-  static int length = 1;
+  static THREAD_LOCAL ulong address = 0L;
+  static THREAD_LOCAL int length = 1;
   bool verbose_save = verbose;
 
   if (argc > 1)
@@ -1110,8 +1257,8 @@ si_dispeflt (int argc, char *argv[])
 {
   int i;
   short fltwords[3];
-  static ulong address = 0L;
-  static int length = 1;
+  static THREAD_LOCAL ulong address = 0L;
+  static THREAD_LOCAL int length = 1;
   bool verbose_save = verbose;
 
   if (argc > 1)
@@ -1157,8 +1304,8 @@ si_dispchar (int argc, char *argv[])
 {
   int i = 0, j = 0;
   ushort word, chr;
-  static ulong address = 0L;
-  static int length = 1;
+  static THREAD_LOCAL ulong address = 0L;
+  static THREAD_LOCAL int length = 1;
   char line[CHARDUMPLEN + 1];
   bool verbose_save = verbose;
 
@@ -1309,14 +1456,15 @@ si_changereg (int argc, char *argv[])
   if (i == REGS)
     return error ("illegal name");
   sscanf (argv[2], "%x", &readreg);
+  sync_timers ();
+  flush_cs ();
   *((ushort *) (&simreg) + i) = (ushort) (readreg & 0xffff);
+  timers_changed ();
 
   return (OKAY);
 }
 
 
-extern int  n_breakpts;  /* break.c */
-
 int
 init_simulator (int mode)
 {
@@ -1324,6 +1472,9 @@ init_simulator (int mode)
 
   if (!mode)
     {
+      /* The command interpreter works on a machine of its own */
+      if (machine == (struct machine *) 0)
+	select_machine (new_machine ());
       init_mem ();
       /* initialize MMU regs */
 #define WORD 2
@@ -1340,10 +1491,14 @@ init_simulator (int mode)
 	      pagereg[DATA][as][logaddr_hinibble].ppa = i++;
 	    }
 	}
+      mmu_changed ();
       /* Write zeros to 1750 regs */
+      sync_timers ();
       memset ((void *) &simreg, 0, sizeof (struct regs));
-      /* Reset breakpoint counter */
-      n_breakpts = 0;
+      machine->cs_lazy = FALSE;
+      timers_changed ();
+      /* Clear all breakpoints */
+      clear_breakpts ();
       /* Reset counter of total instructions executed */
       instcnt = 0L;
       /* Reset simulation time tracking */
@@ -1374,6 +1529,27 @@ si_reset (int argc, char *argv[])
 }
 
 
+static int
+si_snapshot (int argc, char *argv[])
+{
+  if (argc < 2)
+    {
+      list_snapshots ();
+      return (OKAY);
+    }
+  return snapshot_machine (argv[1]);
+}
+
+
+static int
+si_restore (int argc, char *argv[])
+{
+  if (argc < 2)
+    return error ("snapshot name missing");
+  return restore_machine (argv[1]);
+}
+
+
 static int
 si_tr (int argc, char *argv[])
 {
@@ -1437,7 +1613,7 @@ typedef struct rep_rec {
   } u;
 } *reprec;
 
-static ulong phys_addr;
+static THREAD_LOCAL ulong phys_addr;
 
 static void
 apply (reprec r)
@@ -1,10 +1,12 @@
 /* exports */
 
+#include <stdio.h>
 #include "type.h"
 
 extern bool  parse_address (char *str, ulong *phys_address);
 extern int   init_system (int mode), init_simulator (int mode);
 extern int   interpreter (char *startup_batchfile);
+extern int   batch_interpreter (FILE *input, char *startup_batchfile);
 extern void  dis_reg ();
 extern void  int_handler_install ();
 extern int   sys_int (long);
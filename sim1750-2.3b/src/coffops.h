@@ -1,6 +1,6 @@
 /* coffops.h  --  Special purpose exports of load_coff.c
                   General purpose exports are mentioned in loadfile.h  */
 
-extern long find_coff_address (char *labelname);
+extern struct source_line *nth_coff_line (long n);
 extern int  display_coff_symbols ();
 
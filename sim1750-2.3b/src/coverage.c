@@ -0,0 +1,333 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : coverage.c -- code coverage bitmaps and lcov export         */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* coverage.c  --  code coverage bitmaps and lcov export.
+
+   While coverage is on, execute() marks each address at which an
+   instruction was executed, and the conditional branches (JC, JCI,
+   SOJ, BEZ, BLT, BLE, BGT, BNZ, BGE) mark whether they were taken or
+   not. The bits are kept per page of memory in machine->cov[], apart
+   from mem_t so that they are neither shared with snapshots nor reset
+   by restoring one: coverage accumulates over runs from a snapshot.
+
+   The report lists the totals and the conditional branches not yet
+   seen going both ways. The lcov export maps addresses to source lines
+   through the line number table of the COFF file last loaded, which
+   is only there if the program was compiled with -g. Each line counts
+   as hit if an instruction from its address up to that of the next
+   line was executed; counts are 0 or 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "status.h"
+#include "utils.h"
+#include "loadfile.h"
+#include "peekpoke.h"
+#include "machine.h"
+#include "coverage.h"
+
+extern int dism1750 (char *, ushort *);	/* dism1750.c */
+
+THREAD_LOCAL bool covering = FALSE;
+
+#define COV_TAKEN      1
+#define COV_NOT_TAKEN  2
+
+static THREAD_LOCAL int branch_outcome;	/* of the current instruction */
+
+#define MAX_SPAN  32	/* words of the last line of the line table */
+#define MAX_FILES 256
+
+#define BIT(address)  PAGE_MAP_BIT ((address) & 0x0FFF)
+#define COV_TEST(field,address) \
+	  (machine->cov[(unsigned) ((address) >> 12)] != (struct cov_page *) 0 \
+	   && (machine->cov[(unsigned) ((address) >> 12)]->field \
+		[PAGE_MAP_INDEX ((address) & 0x0FFF)] & BIT (address)) != 0)
+
+
+/* Called by the handlers of conditional branches */
+
+void
+cover_branch (bool taken)
+{
+  branch_outcome = taken ? COV_TAKEN : COV_NOT_TAKEN;
+}
+
+
+/* Called by execute() after each instruction */
+
+void
+cover_insn (ulong phys_address)
+{
+  struct cov_page **cp = &machine->cov[(unsigned) (phys_address >> 12)];
+  unsigned word = PAGE_MAP_INDEX (phys_address & 0x0FFF);
+
+  if (*cp == (struct cov_page *) 0)
+    {
+      *cp = (struct cov_page *) calloc (1, sizeof (struct cov_page));
+      if (*cp == (struct cov_page *) 0)
+	problem ("coverage: no memory for the bitmaps");
+    }
+  (*cp)->executed[word] |= BIT (phys_address);
+  if (branch_outcome == COV_TAKEN)
+    (*cp)->taken[word] |= BIT (phys_address);
+  else if (branch_outcome == COV_NOT_TAKEN)
+    (*cp)->not_taken[word] |= BIT (phys_address);
+  branch_outcome = 0;
+}
+
+
+void
+coverage_release (struct machine *m)
+{
+  int i;
+
+  for (i = 0; i < N_PAGES; i++)
+    if (m->cov[i] != (struct cov_page *) 0)
+      {
+	free ((void *) m->cov[i]);
+	m->cov[i] = (struct cov_page *) 0;
+      }
+}
+
+
+/* Whether the instruction word is a conditional branch. JC and JCI
+   with condition 0 never jump, with 7 or 15 always. */
+
+static bool
+conditional_branch (ushort word)
+{
+  switch (word >> 8)
+    {
+    case 0x70:
+    case 0x71:
+      return ((word >> 4) & 7) != 7 && ((word >> 4) & 0xF) != 0;
+    case 0x73:
+    case 0x75:
+    case 0x76:
+    case 0x78:
+    case 0x79:
+    case 0x7A:
+    case 0x7B:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+
+/* Disassemble the instruction at the address into text (which may be
+   NULL) and return its length in words, or 0 if the memory there was
+   never written */
+
+static int
+instruction_at (ulong address, char *text)
+{
+  char buffer[80];
+  ushort words[2];
+
+  if (! peek (address, &words[0]))
+    return 0;
+  peek (address + 1, &words[1]);
+  return dism1750 (text ? text : buffer, words);
+}
+
+
+static int
+report (void)
+{
+  struct cov_page *cp;
+  unsigned page, offset;
+  ulong address, n_executed = 0, n_branches = 0, n_both = 0;
+  bool taken, not_taken;
+  ushort word;
+  char text[80];
+
+  for (page = 0; page < N_PAGES; page++)
+    {
+      if ((cp = machine->cov[page]) == (struct cov_page *) 0)
+	continue;
+      for (offset = 0; offset < 4096; offset++)
+	{
+	  address = ((ulong) page << 12) | offset;
+	  if (! COV_TEST (executed, address))
+	    continue;
+	  n_executed++;
+	  peek (address, &word);
+	  if (! conditional_branch (word))
+	    continue;
+	  n_branches++;
+	  taken = COV_TEST (taken, address);
+	  not_taken = COV_TEST (not_taken, address);
+	  if (taken && not_taken)
+	    {
+	      n_both++;
+	      continue;
+	    }
+	  instruction_at (address, text);
+	  lprintf ("\t%05lX  %-24s %s\n", address, text,
+		   taken ? "taken only" : "not taken only");
+	}
+    }
+  lprintf ("\t%lu instructions executed, %lu conditional branches of which"
+	   " %lu went both ways\n", n_executed, n_branches, n_both);
+  return (OKAY);
+}
+
+
+/* Write the lcov record of one source file */
+
+static void
+write_file (FILE *fp, char *file)
+{
+  struct source_line *sl, *next;
+  ulong address, end;
+  long n;
+  int length, n_fn = 0, fn_hit = 0, n_lines = 0, lines_hit = 0;
+  int n_br = 0, br_hit = 0;
+  bool hit, executed;
+  ushort word;
+
+  fprintf (fp, "SF:%s\n", file);
+  for (n = 0; (sl = nth_line (n)) != (struct source_line *) 0; n++)
+    if (sl->function != NULL && strcmp (sl->file, file) == 0)
+      fprintf (fp, "FN:%d,%s\n", sl->line, sl->function);
+  for (n = 0; (sl = nth_line (n)) != (struct source_line *) 0; n++)
+    if (sl->function != NULL && strcmp (sl->file, file) == 0)
+      {
+	executed = COV_TEST (executed, sl->address);
+	fprintf (fp, "FNDA:%d,%s\n", executed, sl->function);
+	n_fn++;
+	fn_hit += executed;
+      }
+  fprintf (fp, "FNF:%d\nFNH:%d\n", n_fn, fn_hit);
+
+  for (n = 0; (sl = nth_line (n)) != (struct source_line *) 0; n++)
+    {
+      if (strcmp (sl->file, file) != 0)
+	continue;
+      next = nth_line (n + 1);
+      end = (next == (struct source_line *) 0) ? sl->address + MAX_SPAN
+						: next->address;
+      if (end <= sl->address)	/* next line at the same address */
+	end = sl->address + 1;
+      hit = FALSE;
+      for (address = sl->address; address < end; address += length)
+	{
+	  if ((length = instruction_at (address, (char *) 0)) == 0)
+	    break;
+	  executed = COV_TEST (executed, address);
+	  hit |= executed;
+	  peek (address, &word);
+	  if (! conditional_branch (word))
+	    continue;
+	  if (executed)
+	    {
+	      fprintf (fp, "BRDA:%d,%ld,0,%d\nBRDA:%d,%ld,1,%d\n",
+		       sl->line, n, COV_TEST (taken, address),
+		       sl->line, n, COV_TEST (not_taken, address));
+	      br_hit += COV_TEST (taken, address)
+			+ COV_TEST (not_taken, address);
+	    }
+	  else
+	    fprintf (fp, "BRDA:%d,%ld,0,-\nBRDA:%d,%ld,1,-\n",
+		     sl->line, n, sl->line, n);
+	  n_br += 2;
+	}
+      fprintf (fp, "DA:%d,%d\n", sl->line, hit);
+      n_lines++;
+      lines_hit += hit;
+    }
+  fprintf (fp, "BRF:%d\nBRH:%d\nLF:%d\nLH:%d\nend_of_record\n",
+	   n_br, br_hit, n_lines, lines_hit);
+}
+
+
+static int
+write_lcov (char *filename)
+{
+  struct source_line *sl;
+  char *file[MAX_FILES];
+  int i, n_files = 0;
+  long n;
+  FILE *fp;
+
+  if (nth_line (0) == (struct source_line *) 0)
+    return error ("no line numbers in the file last loaded"
+		  " -- compile with -g");
+  for (n = 0; (sl = nth_line (n)) != (struct source_line *) 0; n++)
+    {
+      for (i = 0; i < n_files && strcmp (file[i], sl->file) != 0; i++)
+	;
+      if (i == n_files)
+	{
+	  if (n_files == MAX_FILES)
+	    return error ("more than %d source files", MAX_FILES);
+	  file[n_files++] = sl->file;
+	}
+    }
+  if ((fp = fopen (filename, "w")) == (FILE *) 0)
+    return error ("cannot create %s", filename);
+  fprintf (fp, "TN:\n");
+  for (i = 0; i < n_files; i++)
+    write_file (fp, file[i]);
+  if (fclose (fp) != 0)
+    return error ("error writing %s", filename);
+  info ("Coverage of %d source files written to %s", n_files, filename);
+  return (OKAY);
+}
+
+
+int
+si_coverage (int argc, char *argv[])
+{
+  if (argc == 1)
+    {
+      info ("Coverage is %s", covering ? "on" : "off");
+      return (OKAY);
+    }
+  if (eq (argv[1], "on"))
+    {
+      coverage_release (machine);
+      branch_outcome = 0;
+      covering = TRUE;
+    }
+  else if (eq (argv[1], "off"))
+    covering = FALSE;
+  else if (eq (argv[1], "report"))
+    return report ();
+  else if (eq (argv[1], "lcov"))
+    {
+      if (argc < 3)
+	return error ("lcov needs a file name");
+      return write_lcov (argv[2]);
+    }
+  else
+    return error ("invalid argument -- must be ON, OFF, REPORT or LCOV");
+  return (OKAY);
+}
@@ -0,0 +1,15 @@
+/* coverage.h -- exports of coverage.c */
+
+#ifndef _COVERAGE_H
+#define _COVERAGE_H
+
+#include "machine.h"
+
+extern THREAD_LOCAL bool covering;
+
+extern void cover_insn (ulong phys_address);
+extern void cover_branch (bool taken);
+extern void coverage_release (struct machine *m);
+extern int  si_coverage (int argc, char *argv[]);
+
+#endif
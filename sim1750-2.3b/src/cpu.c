@@ -30,9 +30,10 @@
 
 
 #include <stdio.h>
-/*#include <stdlib.h>*/
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 
 #include "xiodef.h"
@@ -43,41 +44,47 @@
 #include "flt1750.h"
 #include "peekpoke.h"
 #include "smemacc.h"
+#include "phys_mem.h"
+#include "utils.h"
 #ifndef BSVC
 #include "break.h"
 #endif
 #include "cpu.h"
+#include "jit.h"
+#include "sched.h"
+#include "btrace.h"
+#include "tracefile.h"
+#include "profile.h"
+#include "opstats.h"
+#include "coverage.h"
 
 /* Exports */
 
 int   execute (void);
-ulong instcnt;		     /* Total number of instructions executed */
-struct regs simreg;	     /* The 1750 register file */
-int   bpindex = -1;	     /* Index of breakpoint when hitting one */
-			     /* (unused in BSVC) */
+THREAD_LOCAL int bpindex = -1;	/* Index of breakpoint when hitting one */
+				/* (unused in BSVC) */
 
-/* Total execution time in uSec since go command */
-double total_time_in_us = 0.0;
 
-/* 
- * Back trace buffer
- */
-struct regs bt_buff [BT_SIZE];
-int bt_next;
-int bt_cnt;
-
-
-static void
-add_to_backtrace ()
-{
-  bt_buff [bt_next] = simreg;
-  bt_next++;
-  if (bt_next >= BT_SIZE)
-    bt_next = 0;
+/* Append the registers to the backtrace as they are, copying the head of
+   the machine context (see btrace.c); the rest is done when the
+   backtrace is displayed. A macro, being done before every instruction
+   unless SPEED ON. */
 
-  if (bt_cnt < BT_SIZE)
-    bt_cnt++;
-}
+#define add_to_backtrace() \
+  do \
+    { \
+      struct bt_ring *b_ = &machine->bt; \
+      struct bt_entry *e_ = b_->next; \
+      \
+      if (e_ != b_->end || (e_ = bt_sync ()) != (struct bt_entry *) 0) \
+	{ \
+	  b_->next = e_ + 1; \
+	  memcpy ((void *) e_, (void *) machine, \
+		  offsetof (struct bt_entry, cycle)); \
+	  e_->cycle = (unsigned) sched_now; \
+	} \
+    } \
+  while (0)
 
 
 
@@ -96,8 +103,6 @@ add_to_backtrace ()
    By default, the MMU behaves just as though it were not there at all.
  */
 
-struct mmureg pagereg[2][16][16];
-
 /* CPU & MMU initialization function */
 
 void
@@ -117,8 +122,12 @@ init_cpu (void)
 	      pagereg[DATA][as][logaddr_hinibble].ppa = i++;
         }
     }
+  mmu_changed ();
   /* Write zeros to 1750 regs */
+  sync_timers ();
   memset ((void *) &simreg, 0, sizeof (struct regs));
+  machine->cs_lazy = FALSE;
+  timers_changed ();
   /* Reset counter of total instructions executed */
   instcnt = 0L;
   /* Reset counter of total simulation time */
@@ -128,11 +137,6 @@ init_cpu (void)
 
 /********** functions for handling simulation time and interrupts ***********/
 
-static void
-workout_timing (int cycles)
-{
-  static ushort one_tatick_in_ns = 0, one_tbtick_in_tatix = 0;
-  static ushort one_gotick_in_10usec = 0;
 #ifdef MAS281
 #define TIMER_A_LIMIT_IN_NS 20000
   /* CCFN: Timer A limit modified to allow for 50KHz clock on ERA board */
@@ -140,61 +144,164 @@ workout_timing (int cycles)
 #define TIMER_A_LIMIT_IN_NS 10000
 #endif
 
-  one_tatick_in_ns += uP_CYCLE_IN_NS * cycles;
+/* The timers are not stepped instruction by instruction. sync_timers()
+   brings TA, TB and GO up to the current cycle (sched_now) in one go,
+   and timers_changed() arms the timer event for the cycle at which the
+   first of TA, TB or GO will overflow. In between, executing an
+   instruction costs a single compare against sched_deadline.
+   Code reading the timer registers must call sync_timers() first;
+   code changing them (or SYS_TA/SYS_TB) must call sync_timers() before
+   and timers_changed() after the change. */
+
+#define timers_synced         (machine->timers_synced) /* sched_now then */
+#define one_tatick_in_ns      (machine->one_tatick_in_ns)
+#define one_tbtick_in_tatix   (machine->one_tbtick_in_tatix)
+#define one_gotick_in_10usec  (machine->one_gotick_in_10usec)
+#define timer_event           (machine->timer_event)
+
+/* Step TA, TB and GO of `r' by `elapsed' cycles, carrying the parts of
+   a tick over in the prescalers given. Returns the INTR_TA and INTR_TB
+   bits of the timers that overflowed, and INTR_MACHERR if GO did. */
+
+ushort
+step_timers (struct regs *r, ulong elapsed, ulong *tatick_in_ns,
+	     ushort *tbtick_in_tatix, ushort *gotick_in_10usec)
+{
+  ulong ns, ticks, n;
+  ushort overflow = 0;
+
+  /* ticks = (*tatick_in_ns + elapsed * uP_CYCLE_IN_NS) / LIMIT,
+     split up so as not to overflow a 32 bit ulong */
+  ns = (elapsed % TIMER_A_LIMIT_IN_NS) * uP_CYCLE_IN_NS + *tatick_in_ns;
+  ticks = (elapsed / TIMER_A_LIMIT_IN_NS) * uP_CYCLE_IN_NS
+	  + ns / TIMER_A_LIMIT_IN_NS;
+  *tatick_in_ns = ns % TIMER_A_LIMIT_IN_NS;
+  if (ticks == 0)
+    return 0;
+
+  if (r->sys & SYS_TA)
+    {
+      n = (ulong) r->ta + ticks;
+      if (n > 0xFFFF)
+	overflow |= INTR_TA;
+      r->ta = (ushort) n;
+    }
+  if (r->sys & SYS_TB)
+    {
+      n = (ulong) *tbtick_in_tatix + ticks;
+      *tbtick_in_tatix = (ushort) (n % 10);
+      n = (ulong) r->tb + n / 10;
+      if (n > 0xFFFF)
+	overflow |= INTR_TB;
+      r->tb = (ushort) n;
+    }
+
+  n = (ulong) *gotick_in_10usec + ticks;
+  *gotick_in_10usec = (ushort) (n % GOTIMER_PERIOD_IN_10uSEC);
+  n = (ulong) r->go + n / GOTIMER_PERIOD_IN_10uSEC;
+  r->go = (ushort) n;
+  if (n > 0xFFFF)
+    overflow |= INTR_MACHERR;
+  return overflow;
+}
 
-  while (one_tatick_in_ns >= TIMER_A_LIMIT_IN_NS)
+void
+sync_timers (void)
+{
+  ulong elapsed = sched_now - timers_synced;
+  ushort overflow;
+
+  timers_synced = sched_now;
+  bt_timers_changed ();
+  overflow = step_timers (&simreg, elapsed, &one_tatick_in_ns,
+			  &one_tbtick_in_tatix, &one_gotick_in_10usec);
+  simreg.pir |= overflow;
+  if (overflow & INTR_MACHERR)   /* GO Watchdog */
     {
-      one_tatick_in_ns -= TIMER_A_LIMIT_IN_NS;
-      if (simreg.sys & SYS_TA)
-	{
-	  if (simreg.ta == 0xFFFF)
-	    {
-	      simreg.ta = 0;
-	      simreg.pir |= INTR_TA;
-	    }
-	  else
-	    simreg.ta++;
-	}
-      if (simreg.sys & SYS_TB)
-	{
-	  if (one_tbtick_in_tatix == 9)
-	    {
-	      one_tbtick_in_tatix = 0;
-	      if (simreg.tb == 0xFFFF)
-		{
-		  simreg.tb = 0;
-		  simreg.pir |= INTR_TB;
-		}
-	      else
-	        simreg.tb++;
-	    }
-          else
-            one_tbtick_in_tatix++;
-	}
+      simreg.ft |= FT_SYSFAULT0;    /* sysfault 0 : watchdog */
+      info ("BARF! goes the watchdog\n");
+    }
+}
 
-      if (++one_gotick_in_10usec >= GOTIMER_PERIOD_IN_10uSEC)
-	{
-	  one_gotick_in_10usec = 0;
-	  if (!++simreg.go)         /* GO Watchdog */
-	    {
-	      simreg.pir |= INTR_MACHERR;   /* machine error         */
-	      simreg.ft |= FT_SYSFAULT0;    /* sysfault 0 : watchdog */
-	      simreg.go = 0;
-	      info ("BARF! goes the watchdog\n");
-	    }
-	}
+static void
+timer_expiry (void)
+{
+  timers_changed ();
+}
+
+void
+timers_changed (void)
+{
+  ulong ticks, t;
+  double ns;
+
+  sync_timers ();
+  if (timer_event < 0)
+    timer_event = sched_register (timer_expiry);
+
+  /* Number of Timer A ticks until the first overflow */
+  ticks = (ulong) (GOTIMER_PERIOD_IN_10uSEC - one_gotick_in_10usec)
+	  + (ulong) (0xFFFF - simreg.go) * GOTIMER_PERIOD_IN_10uSEC;
+  if (simreg.sys & SYS_TA)
+    {
+      t = 0x10000L - (ulong) simreg.ta;
+      if (t < ticks)
+	ticks = t;
     }
+  if (simreg.sys & SYS_TB)
+    {
+      t = (ulong) (10 - one_tbtick_in_tatix)
+	  + (ulong) (0xFFFF - simreg.tb) * 10;
+      if (t < ticks)
+	ticks = t;
+    }
+
+  ns = (double) ticks * TIMER_A_LIMIT_IN_NS - (double) one_tatick_in_ns;
+  sched_at (timer_event, (ulong) ceil (ns / uP_CYCLE_IN_NS));
+}
+
+static void
+workout_timing (int cycles)
+{
+  sched_now += (ulong) cycles;
+  if (SCHED_DUE ())
+    sched_run ();
 }
 
 /* A quickie for communication between workout_interrupts() and ex_bex() */
-static ushort bex_index;
+#define bex_index             (machine->bex_index)
+
+/* The interrupt state last found to have nothing deliverable.
+   As long as PIR, MK and SYS keep these values, workout_interrupts()
+   returns at once. */
+static THREAD_LOCAL ushort idle_pir = 0, idle_mk = 0, idle_sys = 0;
+
+/* Cache of the interrupt vectors (LP/SVP pairs at 0x20 + 2n in code
+   AS 0). Bit 15-n of vector_valid is set if vector[n] is valid.
+   The cache is dropped on MMU changes and on stores to vector_base,
+   the physical address of the vector table. */
+static THREAD_LOCAL ushort vector[16][2];
+static THREAD_LOCAL ushort vector_valid = 0;
+static THREAD_LOCAL ulong  vector_base = ~0L;
+
+/* Number of leading zeros in a 4 bit value */
+static const char clz4[16] =
+  { 4, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+static ushort
+highest_interrupt (ushort bits)
+{
+  if (bits & 0xFF00)
+    return (bits & 0xF000) ? clz4[bits >> 12] : 4 + clz4[bits >> 8];
+  return (bits & 0x00F0) ? 8 + clz4[bits >> 4] : 12 + clz4[bits];
+}
 
 static void
 workout_interrupts ()
 {
-  ushort intnum, pirmask;
-  ushort old_mk = simreg.mk, old_sw = simreg.sw, old_ic = simreg.ic;
-  ushort lp, svp;
+  ushort intnum, pirmask, considered, deliverable;
+  ushort old_mk = simreg.mk, old_sw, old_ic = simreg.ic;
+  ushort lp, svp, as;
   static char *intr_name[] =
     { "Power-Down", "Machine-Error", "User-0", "Floating-Overflow",
       "Integer-Overflow", "Executive-Call", "Floating-Underflow", "Timer-A",
@@ -203,41 +310,63 @@ workout_interrupts ()
 
   if (simreg.pir == 0)
     return;
+  if (simreg.pir == idle_pir && simreg.mk == idle_mk
+      && simreg.sys == idle_sys && ! verbose)
+    return;
 
-  for (intnum = 0; intnum < 16; intnum++)
+  /* Without the Master Interrupt Enable, only Power-Down, Machine-Error
+     and Executive-Call are considered. Power-Down and Executive-Call
+     cannot be masked. */
+  considered = simreg.pir & ((simreg.sys & SYS_INT) ? 0xFFFF : 0xC400);
+  deliverable = considered & (simreg.mk | 0x8400);
+  if (verbose)
+    for (intnum = 0; intnum < 16; intnum++)
+      {
+	pirmask = 1 << (15 - intnum);
+	if ((considered & pirmask) == 0)
+	  continue;
+	info ("\tInterrupt %2d (%s)", (unsigned) intnum, intr_name[intnum]);
+	if (deliverable & pirmask)
+	  break;
+	info ("  pending but masked");
+      }
+  if (deliverable == 0)
     {
-      pirmask = 1 << (15 - intnum);
-      if (simreg.pir & pirmask)
-	{
-	  if ((simreg.sys & SYS_INT) == 0
-	      && intnum != 0 && intnum != 1 && intnum != 5)
-	    continue;           /* Master Interrupt Enable is not set */
-	  info ("\tInterrupt %2d (%s)", (unsigned) intnum, intr_name[intnum]);
-	  if ((simreg.mk & pirmask) == 0  && intnum != 0 && intnum != 5)
-	    info ("  pending but masked");
-	  else
-	    {
-	      ushort as;
-	      simreg.pir &= ~pirmask;
-	      simreg.sys &= ~SYS_INT;  /* clear the Master Interrupt Enable */
-	      /************** Switch to the interrupt context ***************/
-	      simreg.sw &= 0xFFF0;      /* LP and SVP in AS 0 */
-	      get_raw (CODE, 0, 0x20 + intnum * 2, &lp);
-	      get_raw (CODE, 0, 0x21 + intnum * 2, &svp);
-	      /* get new MK/SW/IC */
-	      get_raw (DATA, 0, svp, &simreg.mk);
-	      get_raw (DATA, 0, svp + 1, &simreg.sw);
-	      get_raw (DATA, 0, svp + 2 + (intnum == 5 ? bex_index : 0),
-		 		     &simreg.ic); /* bex_index: see ex_bex() */
-	      /* save old MK/SW/IC in new AS */
-	      as = simreg.sw & 0x000F;
-	      store_raw (DATA, as, lp, old_mk);
-	      store_raw (DATA, as, lp + 1, old_sw);
-	      store_raw (DATA, as, lp + 2, old_ic);
-	      break;
-	    }
-	}
+      idle_pir = simreg.pir;
+      idle_mk = simreg.mk;
+      idle_sys = simreg.sys;
+      return;
+    }
+
+  intnum = highest_interrupt (deliverable);
+  pirmask = 1 << (15 - intnum);
+  simreg.pir &= ~pirmask;
+  simreg.sys &= ~SYS_INT;  /* clear the Master Interrupt Enable */
+  /************** Switch to the interrupt context ***************/
+  flush_cs ();
+  old_sw = simreg.sw;
+  simreg.sw &= 0xFFF0;      /* LP and SVP in AS 0 */
+  if ((vector_valid & pirmask) == 0)
+    {
+      get_raw (CODE, 0, 0x20 + intnum * 2, &vector[intnum][0]);
+      get_raw (CODE, 0, 0x21 + intnum * 2, &vector[intnum][1]);
+      vector_base = get_phys_address (CODE, 0, 0x20);
+      vector_valid |= pirmask;
     }
+  lp = vector[intnum][0];
+  svp = vector[intnum][1];
+  /* get new MK/SW/IC */
+  get_raw (DATA, 0, svp, &simreg.mk);
+  get_raw (DATA, 0, svp + 1, &simreg.sw);
+  get_raw (DATA, 0, svp + 2 + (intnum == 5 ? bex_index : 0),
+	   &simreg.ic); /* bex_index: see ex_bex() */
+  /* save old MK/SW/IC in new AS */
+  as = simreg.sw & 0x000F;
+  store_raw (DATA, as, lp, old_mk);
+  store_raw (DATA, as, lp + 1, old_sw);
+  store_raw (DATA, as, lp + 2, old_ic);
+  if (profiling)
+    profile_call (PROF_INTR);
 }
 
 
@@ -245,18 +374,75 @@ workout_interrupts ()
 
 static char *bankname[] = { "Code", "Data" };
 
-/* Return value of get_word and store_word is one of:
+/* Translation lookaside buffer.
+   There is one entry for each page register, i.e. per bank, AS, and
+   logical page. It holds the host address of the mapped physical page
+   and a mask of the Access Keys that may access the page (bit n for
+   AK n; zero if the page is write/execute protected). Being indexed by
+   AS and checked against the AK by mask, the TLB stays valid across
+   changes of the Status Word. It is cleared by mmu_changed(), and
+   entries are filled by check_access() as pages are accessed.
+   A physical page that has not been allocated yet is mapped to
+   zero_page, so reading it does not allocate; poke() allocates the
+   page on the first store and flushes the TLB. */
+
+struct tlb_entry
+  {
+    ushort *word;		/* mem[ppa]->word, or NULL if empty */
+    ulong  *was_written;	/* mem[ppa]->was_written */
+    ulong   phys_base;		/* physical address of the page */
+    ushort  ak_mask;		/* permitted Access Keys */
+  };
+
+static THREAD_LOCAL struct tlb_entry tlb[2][16][16];
+
+#define TLB_ENTRY(bank,address) \
+	  (&tlb[(bank) & 1][simreg.sw & 0xF][(address) >> 12])
+#define TLB_HIT(t,bank) \
+	  ((t)->word != (ushort *) 0 \
+	   && ((t)->ak_mask >> ((simreg.sw >> 4) & 0xF)) & 1 \
+	   && ((bank) == CODE || (bank) == DATA))
+
+static void
+tlb_fill (int bank, ushort as, ushort log_page)
+{
+  struct mmureg *preg = &pagereg[bank][as][log_page];
+  struct tlb_entry *t = &tlb[bank][as][log_page];
+  mem_t *memptr = mem[preg->ppa];
+
+  if (memptr == MNULL)
+    memptr = &zero_page;
+  t->word = memptr->word;
+  t->was_written = memptr->was_written;
+  t->phys_base = (ulong) preg->ppa << 12;
+  if (preg->e_w)
+    t->ak_mask = 0;
+  else if (preg->al == 0xF)
+    t->ak_mask = 0xFFFF;
+  else
+    t->ak_mask = 0x0001 | (1 << preg->al);  /* AK 0 is always permitted */
+}
+
+/* Return value of check_access, get_word and store_word is one of:
    OKAY, BREAKPT, or MEMERR. */
 
 static int
-get_word (int bank, ushort address, short *data)
+check_access (int bank, ushort address, ulong *phys_address, int storing)
 {
   ushort al, ak = (simreg.sw >> 4) & 0xF, as = simreg.sw & 0xF;
-  ulong phys_address;
+  struct tlb_entry *t = TLB_ENTRY (bank, address);
 
+  if (TLB_HIT (t, bank))
+    {
+      *phys_address = t->phys_base | (address & 0x0FFF);
+      return OKAY;
+    }
   if (bank != CODE && bank != DATA)
     {
-      error ("FATAL ERR:  bank-number %d invalid\n", bank);
+      if (storing)
+	error ("intern err (store_word):  bank-number %d invalid\n", bank);
+      else
+	error ("FATAL ERR:  bank-number %d invalid\n", bank);
       return MEMERR;
     }
   if (ak != 0)
@@ -266,8 +452,13 @@ get_word (int bank, ushort address, short *data)
 	{
 	  simreg.pir |= INTR_MACHERR;
 	  simreg.ft |= FT_MEMPROT;
-	  error
-	   ("MACHINE ERR: AL %hX / AK %hX during %s fetch from %hX:%04hX\n",
+	  if (storing)
+	    error
+	     ("MACHINE ERR: AL=%hX / AK=%hX on storing %s to address %hX:%04hX\n",
+		    al, ak, bankname[bank], as, address);
+	  else
+	    error
+	     ("MACHINE ERR: AL %hX / AK %hX during %s fetch from %hX:%04hX\n",
 		    al, ak, bankname[bank], as, address);
 	  return MEMERR;
 	}
@@ -277,59 +468,56 @@ get_word (int bank, ushort address, short *data)
       simreg.pir |= INTR_MACHERR;
       simreg.ft |= FT_MEMPROT;
       error
-	("MACHINE ERR: attempt to fetch %s from protected address %hX:%04hX\n",
-		bankname[bank], as, address);
+	("MACHINE ERR: attempt to %s %s %s protected address %hX:%04hX\n",
+		storing ? "store" : "fetch", bankname[bank],
+		storing ? "to" : "from", as, address);
       return MEMERR;
     }
-  phys_address = get_phys_address (bank, as, address);
+  *phys_address = get_phys_address (bank, as, address);
+  tlb_fill (bank, as, address >> 12);
+  return OKAY;
+}
+
+
+static int
+get_word (int bank, ushort address, short *data)
+{
+  struct tlb_entry *t = TLB_ENTRY (bank, address);
+  unsigned offset = address & 0x0FFF;
+  ulong phys_address;
+  int status;
+
+  if (TLB_HIT (t, bank))
+    phys_address = t->phys_base | offset;
+  else if ((status = check_access (bank, address, &phys_address, 0)) != OKAY)
+    return status;
 #ifndef BSVC
   /* Check for breakpoint */
   if ((bpindex = find_breakpt (READ, phys_address)) >= 0)
     return BREAKPT;
 #endif
-  if (peek (phys_address, (ushort *) data) == 0)
-    {
-      error ("read error at ic = %04X\n", simreg.ic);
-      return MEMERR;
-    }
-  return OKAY;
+  /* check_access() has filled the TLB entry if it was empty */
+  *data = (short) t->word[offset];
+  if (t->was_written[PAGE_MAP_INDEX (offset)] & PAGE_MAP_BIT (offset))
+    return OKAY;
+  error ("read error at ic = %04X\n", simreg.ic);
+  return MEMERR;
 }
 
 
 static int
 store_word (int bank, ushort address, ushort data)
 {
-  ushort al, ak = (simreg.sw >> 4) & 0xF, as = simreg.sw & 0xF;
+  struct tlb_entry *t = TLB_ENTRY (bank, address);
   ulong phys_address;
-
-  if (bank != CODE && bank != DATA)
-    {
-      error ("intern err (store_word):  bank-number %d invalid\n", bank);
-      return MEMERR;
-    }
-  if (ak != 0)
-    {
-      al = pagereg[bank][(int) as][(int)(address >> 12)].al;
-      if (al != 0xF && ak != al)
-	{
-	  simreg.pir |= INTR_MACHERR;
-	  simreg.ft |= FT_MEMPROT;
-	  error
-	   ("MACHINE ERR: AL=%hX / AK=%hX on storing %s to address %hX:%04hX\n",
-		    al, ak, bankname[bank], as, address);
-	  return MEMERR;
-	}
-    }
-  if (pagereg[bank][(int) as][(int)(address >> 12)].e_w)
-    {
-      simreg.pir |= INTR_MACHERR;
-      simreg.ft |= FT_MEMPROT;
-      error
-	("MACHINE ERR: attempt to store %s to protected address %hX:%04hX\n",
-		bankname[bank], as, address);
-      return MEMERR;
-    }
-  phys_address = get_phys_address (bank, as, address);
+  int status;
+
+  /* The store itself goes through poke() which keeps the instruction
+     cache and the write journal up to date. */
+  if (TLB_HIT (t, bank))
+    phys_address = t->phys_base | (address & 0x0FFF);
+  else if ((status = check_access (bank, address, &phys_address, 1)) != OKAY)
+    return status;
 #ifndef BSVC
   /* Check for breakpoint */
   if ((bpindex = find_breakpt (WRITE, phys_address)) >= 0)
@@ -340,15 +528,129 @@ store_word (int bank, ushort address, ushort data)
 }
 
 
+/*********************** Predecoded instruction cache ***********************/
+
+/* The opcode fetch and split at the top of execute() is cached per
+   physical address. An entry holds the instruction handler, the opcode
+   fields, and (once fetched) the word following the opcode, which most
+   instructions use as their address or immediate operand.
+   Entries are filled on first execution and invalidated by poke().
+   Cycle counts are not cached because many instructions take a data
+   dependent number of cycles (see stime.h). */
+
+struct block;
+
+struct decoded
+  {
+    int (*handler) ();
+    ushort opcode;
+    ushort upper, lower;
+    ushort immed;	/* word at IC+1, valid if DC_IMMED is set */
+    ushort flags;
+    struct block *block;  /* basic block starting here (see execute_block) */
+  };
+
+#define DC_VALID   0x01
+#define DC_IMMED   0x02
+#define DC_ENDBLK  0x04  /* control transfer or AS change: ends a block */
+#define DC_NOCHAIN 0x08  /* block ending here may not chain to successor */
+#define DC_SYNC    0x10  /* needs timers up to date before execution */
+#define DC_JIT     0x20  /* part of a translated block (see jit.c) */
+
+/* The caches of the execution engines are per thread; select_machine()
+   flushes them when a thread switches to another machine. */
+static THREAD_LOCAL struct decoded *dcache[N_PAGES];  /* allocated per page */
+static THREAD_LOCAL struct decoded *cur_decoded;  /* current instruction */
+static THREAD_LOCAL bool jit_stale;	/* translated code was overwritten */
+
+static void flush_blocks (void);
+
+void
+invalidate_decoded (ulong phys_address)
+{
+  struct decoded *dc_page = dcache[(unsigned) (phys_address >> 12) & 0xFF];
+  unsigned offset = (unsigned) phys_address & 0x0FFF;
+
+  if ((phys_address & ~0x1FL) == vector_base)
+    vector_valid = 0;
+  if (dc_page == (struct decoded *) 0)
+    return;
+  if ((dc_page[offset].flags & DC_JIT)
+      || (offset > 0 && (dc_page[offset - 1].flags & DC_JIT)))
+    jit_stale = TRUE;
+  dc_page[offset].flags = 0;
+  dc_page[offset].block = (struct block *) 0;
+  if (offset > 0)
+    dc_page[offset - 1].flags &= ~DC_IMMED;
+}
+
+/* Drop the cached decodings of a physical page whose contents were
+   replaced as a whole (see restore_machine()). */
+
+void
+invalidate_page (unsigned page)
+{
+  struct decoded *dc_page = dcache[page];
+  int i;
+
+  if ((vector_base >> 12) == page)
+    vector_valid = 0;
+  if (dc_page == (struct decoded *) 0)
+    return;
+  for (i = 0; i < 4096; i++)
+    if (dc_page[i].flags & DC_JIT)
+      jit_stale = TRUE;
+  memset ((void *) dc_page, 0, 4096 * sizeof (struct decoded));
+}
+
+void
+flush_decoded (void)
+{
+  int i;
+
+  for (i = 0; i < N_PAGES; i++)
+    if (dcache[i] != (struct decoded *) 0)
+      memset ((void *) dcache[i], 0, 4096 * sizeof (struct decoded));
+  vector_valid = 0;
+  flush_blocks ();
+}
+
+/* Fetch the word following the opcode. It is only kept in the cache
+   when it lies on the same physical page as the opcode. */
+
+static int
+get_immed (short *data)
+{
+  ushort address = simreg.ic + 1;  /* `data' may point to simreg.ic */
+  int status;
+
+  if (cur_decoded->flags & DC_IMMED)
+    {
+      *data = (short) cur_decoded->immed;
+      return OKAY;
+    }
+  if ((status = get_word (CODE, address, data)) != OKAY)
+    return status;
+  if ((address & 0x0FFF) != 0)
+    {
+      cur_decoded->immed = (ushort) *data;
+      cur_decoded->flags |= DC_IMMED;
+    }
+  return OKAY;
+}
+
+
 #define BASEREG(opcode) (ushort) simreg.r[12 + (((opcode) & 0x0300) >> 8)]
 #define CHK_RX()        (lower > 0 ? (ushort) simreg.r[lower] : 0)
-static int ans;
+static THREAD_LOCAL int ans;
 #define GET(bank,addr,receiver) \
 	  if ((ans = get_word (bank, addr, receiver)) != OKAY) return ans
 #define PUT(bank,addr,emittee)  \
 	  if ((ans = store_word (bank, addr, emittee)) != OKAY) return ans
+#define GET_IMMED(receiver) \
+	  if ((ans = get_immed (receiver)) != OKAY) return ans
 
-static ushort opcode, upper, lower;
+static THREAD_LOCAL ushort opcode, upper, lower;
 /* `upper' and `lower' are bits 8..11 and 12..15 respectively of the opcode */
 
 /*************************** CPU instructions *******************************/
@@ -815,6 +1117,7 @@ realize_xio (ushort xio_address, ushort *transfer)
     case X_WOPR:
       bank = (addr_hibyte == X_WIPR) ? CODE : DATA;
       pagereg[bank][xio_upper][xio_lower].ppa = *transfer & 0xff;
+      mmu_changed ();
       return;
     case X_RIPR:
     case X_ROPR:
@@ -828,6 +1131,7 @@ realize_xio (ushort xio_address, ushort *transfer)
 
   if (xio[i].value)
     {
+      sync_timers ();
       switch (xio_address)
 	{
 	case     X_ENBL:
@@ -840,27 +1144,36 @@ realize_xio (ushort xio_address, ushort *transfer)
 	  simreg.sys &= ~SYS_DMA;
 	elsecase X_TAH:
 	  simreg.sys &= ~SYS_TA;
+	  timers_changed ();
 	elsecase X_TBH:
 	  simreg.sys &= ~SYS_TB;
+	  timers_changed ();
 	elsecase X_TAS:
 	  simreg.sys |= SYS_TA;
+	  timers_changed ();
 	elsecase X_OTA:
 	  simreg.sys |= SYS_TA;
 	  simreg.ta = *transfer;
+	  timers_changed ();
 	elsecase X_ITA:
 	  *transfer = simreg.ta;
 	elsecase X_TBS:
 	  simreg.sys |= SYS_TB;
+	  timers_changed ();
 	elsecase X_OTB:
 	  simreg.sys |= SYS_TB;
 	  simreg.tb = *transfer;
+	  timers_changed ();
 	elsecase X_ITB:
 	  *transfer = simreg.tb;
 	elsecase X_GO:
 	  simreg.go = 0;
+	  timers_changed ();
 	elsecase X_RSW:
+	  flush_cs ();
 	  *transfer = simreg.sw;
 	elsecase X_WSW:
+	  flush_cs ();
 	  simreg.sw = *transfer;
 	elsecase X_RPI:
 	  simreg.pir &= ~(0x8000 >> *transfer);
@@ -911,7 +1224,7 @@ ex_xio ()		/* 48xy */
   unsigned ak = (unsigned) (simreg.sw >> 4) & 0xF; /* privileged instruction */
   ushort xio_address;
 
-  GET (CODE, simreg.ic + 1, (short *) &xio_address);
+  GET_IMMED ((short *) &xio_address);
   xio_address += CHK_RX ();
 
   if (ak != 0)
@@ -932,7 +1245,7 @@ ex_vio ()		/* 49xy */
   unsigned ak = (unsigned) (simreg.sw >> 4) & 0xF; /* privileged instruction */
   ushort vio_address, vec_sel, i = 0, n, transfer, iocmd, iodata;
 
-  GET (CODE, simreg.ic + 1, (short *) &vio_address);
+  GET_IMMED ((short *) &vio_address);
   vio_address += CHK_RX ();
   GET (CODE, vio_address + 1, (short *) &vec_sel);
 
@@ -969,7 +1282,7 @@ ex_aim ()		/* 4Ax1 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_ADD, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -981,7 +1294,7 @@ ex_sim ()		/* 4Ax2 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_SUB, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -993,7 +1306,7 @@ ex_mim ()		/* 4Ax3 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_MUL, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -1005,7 +1318,7 @@ ex_msim ()		/* 4Ax4 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_MULS, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -1017,7 +1330,7 @@ ex_dim ()		/* 4Ax5 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_DIV, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -1029,7 +1342,7 @@ ex_dvim ()		/* 4Ax6 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   arith (ARI_DIVV, VAR_INT, &simreg.r[upper], &help);
 
   simreg.ic += 2;
@@ -1041,7 +1354,7 @@ ex_andm ()		/* 4Ax7 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   simreg.r[upper] &= help;
   update_cs (&simreg.r[upper], VAR_INT);
 
@@ -1054,7 +1367,7 @@ ex_orim ()		/* 4Ax8 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   simreg.r[upper] |= help;
   update_cs (&simreg.r[upper], VAR_INT);
 
@@ -1067,7 +1380,7 @@ ex_xorm ()		/* 4Ax9 */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   simreg.r[upper] ^= help;
   update_cs (&simreg.r[upper], VAR_INT);
 
@@ -1080,7 +1393,7 @@ ex_cim ()		/* 4AxA */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   compare (VAR_INT, &simreg.r[upper], &help); /* side effect on CS */
 
   simreg.ic += 2;
@@ -1092,7 +1405,7 @@ ex_nim ()		/* 4AxB */
 {
   short help;
 
-  GET (CODE, simreg.ic + 1, &help);
+  GET_IMMED (&help);
   simreg.r[upper] = ~(simreg.r[upper] & help);
   update_cs (&simreg.r[upper], VAR_INT);
 
@@ -1163,7 +1476,7 @@ ex_sb ()		/* 50xy */
   ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &data);
 
@@ -1189,7 +1502,7 @@ ex_sbi ()		/* 52xy */
   ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &data);
@@ -1207,7 +1520,7 @@ ex_rb ()		/* 53xy */
   ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &data);
 
@@ -1233,7 +1546,7 @@ ex_rbi ()		/* 55xy */
   ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &data);
@@ -1248,17 +1561,17 @@ ex_rbi ()		/* 55xy */
 static int
 ex_tb ()		/* 56xy */
 {
-  ushort addr, sw_save = simreg.sw & 0x0FFF;
+  ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &data);
 
   if (data & (1 << (15 - upper)))
-    simreg.sw = sw_save | (upper ? CS_POSITIVE : CS_NEGATIVE);
+    set_cs (upper ? CS_POSITIVE : CS_NEGATIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_TB);
@@ -1267,12 +1580,10 @@ ex_tb ()		/* 56xy */
 static int
 ex_tbr ()		/* 57xy */
 {
-  ushort sw_save = simreg.sw & 0x0FFF;
-
   if (simreg.r[lower] & (1 << (15 - upper)))
-    simreg.sw = sw_save | (upper ? CS_POSITIVE : CS_NEGATIVE);
+    set_cs (upper ? CS_POSITIVE : CS_NEGATIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic++;
   return (nc_TBR);
@@ -1281,18 +1592,18 @@ ex_tbr ()		/* 57xy */
 static int
 ex_tbi ()		/* 58xy */
 {
-  ushort addr, sw_save = simreg.sw & 0x0FFF;
+  ushort addr;
   short data;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &data);
 
   if (data & (1 << (15 - upper)))
-    simreg.sw = sw_save | (upper ? CS_POSITIVE : CS_NEGATIVE);
+    set_cs (upper ? CS_POSITIVE : CS_NEGATIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_TBI);
@@ -1301,18 +1612,18 @@ ex_tbi ()		/* 58xy */
 static int
 ex_tsb ()		/* 59xy */
 {
-  ushort addr, sw_save = simreg.sw & 0x0FFF;
+  ushort addr;
   short data, bit_set = 1 << (15 - upper);
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &data);
   PUT (DATA, addr, data | bit_set);
 
   if (data & bit_set)
-    simreg.sw = sw_save | (upper ? CS_POSITIVE : CS_NEGATIVE);
+    set_cs (upper ? CS_POSITIVE : CS_NEGATIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_TSB);
@@ -1340,12 +1651,11 @@ static int
 ex_tvbr ()		/* 5Exy */
 {
   ushort data = simreg.r[lower] & (1 << (15 - (simreg.r[upper] & 0xF)));
-  ushort sw_save = simreg.sw & 0x0FFF;
 
   if (data)
-    simreg.sw = sw_save | (simreg.r[upper] & 0xF ? CS_POSITIVE : CS_NEGATIVE);
+    set_cs (simreg.r[upper] & 0xF ? CS_POSITIVE : CS_NEGATIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic++;
   return (nc_TVBR);
@@ -1681,6 +1991,7 @@ flag_test (ushort condition)
 {
   if ((condition & 0x0007) == 0x0007)
     return (TRUE);
+  flush_cs ();
   if (condition & ((simreg.sw >> 12) & 0x000F))
     return (TRUE);
   else
@@ -1694,12 +2005,15 @@ ex_jc ()		/* 70xy */
 
   if (jump_taken)
     {
-      GET (CODE, simreg.ic + 1, (short *) &simreg.ic);
+      GET_IMMED ((short *) &simreg.ic);
       simreg.ic += CHK_RX ();
     }
   else
     simreg.ic += 2;
 
+  if (covering)
+    cover_branch (jump_taken);
+
   return (nc_JC);
 }
 
@@ -1712,13 +2026,16 @@ ex_jci ()		/* 71xy */
 
   if (jump_taken)
     {
-      GET (CODE, simreg.ic + 1, (short *) &addr);
+      GET_IMMED ((short *) &addr);
       addr += CHK_RX ();
       GET (DATA, addr, (short *) &simreg.ic);
     }
   else
     simreg.ic += 2;
 
+  if (covering)
+    cover_branch (jump_taken);
+
   return (nc_JCI);
 }
 
@@ -1727,9 +2044,11 @@ ex_js ()		/* 72xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   simreg.r[upper] = simreg.ic + 2;
   simreg.ic = addr + CHK_RX ();
+  if (profiling)
+    profile_call (PROF_JS);
 
   return (nc_JS);
 }
@@ -1743,15 +2062,19 @@ ex_soj ()		/* 73xy */
   help = 1;
   arith (ARI_SUB, VAR_INT, &simreg.r[upper], &help);
 
+  flush_cs ();
   if (CS_ZERO & simreg.sw)
     simreg.ic += 2;                     /* end of loop */
   else
     {
-      GET (CODE, simreg.ic + 1, (short *) &simreg.ic);
+      GET_IMMED ((short *) &simreg.ic);
       simreg.ic += CHK_RX ();
       jump_taken = 1;
     }
 
+  if (covering)
+    cover_branch (jump_taken);
+
   return (nc_SOJ);
 }
 
@@ -1773,6 +2096,7 @@ ex_bez ()		/* 75xy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if (CS_ZERO & simreg.sw)
     {
       ushort distance = opcode & 0x00FF;
@@ -1785,6 +2109,9 @@ ex_bez ()		/* 75xy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1793,6 +2120,7 @@ ex_blt ()		/* 76xy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if (CS_NEGATIVE & simreg.sw)
     {
       ushort distance = opcode & 0x00FF;
@@ -1805,6 +2133,9 @@ ex_blt ()		/* 76xy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1823,6 +2154,7 @@ ex_ble ()		/* 78xy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if (CS_ZERO & simreg.sw || CS_NEGATIVE & simreg.sw)
     {
       ushort distance = opcode & 0x00FF;
@@ -1835,6 +2167,9 @@ ex_ble ()		/* 78xy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1843,6 +2178,7 @@ ex_bgt ()		/* 79xy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if (CS_POSITIVE & simreg.sw)
     {
       ushort distance = opcode & 0x00FF;
@@ -1855,6 +2191,9 @@ ex_bgt ()		/* 79xy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1863,6 +2202,7 @@ ex_bnz ()		/* 7Axy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if ((CS_ZERO & simreg.sw) == 0)
     {
       ushort distance = opcode & 0x00FF;
@@ -1875,6 +2215,9 @@ ex_bnz ()		/* 7Axy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1883,6 +2226,7 @@ ex_bge ()		/* 7Bxy */
 {
   bool branch_taken = FALSE;
 
+  flush_cs ();
   if (CS_ZERO & simreg.sw || CS_POSITIVE & simreg.sw)
     {
       ushort distance = opcode & 0x00FF;
@@ -1895,6 +2239,9 @@ ex_bge ()		/* 7Bxy */
   else
     simreg.ic++;
 
+  if (covering)
+    cover_branch (branch_taken);
+
   return (nc_BRcc);
 }
 
@@ -1904,7 +2251,7 @@ ex_lsti ()		/* 7Cxy */
   /* privileged instruction  */
   ushort ak = (simreg.sw >> 4) & 0xF, source;
 
-  GET (CODE, simreg.ic + 1, (short *) &source);
+  GET_IMMED ((short *) &source);
   source += CHK_RX ();
 
   if (ak != 0)
@@ -1917,7 +2264,10 @@ ex_lsti ()		/* 7Cxy */
       GET (DATA, source, (short *) &source);
       GET (DATA, source,     (short *) &simreg.mk);
       GET (DATA, source + 2, (short *) &simreg.ic);
+      flush_cs ();
       GET (DATA, source + 1, (short *) &simreg.sw);
+      if (profiling)
+	profile_return ();
     }
 
   return (nc_LSTI);
@@ -1929,7 +2279,7 @@ ex_lst ()		/* 7Dxy */
   /* privileged instruction  */
   ushort ak = (simreg.sw >> 4) & 0xF, source;
 
-  GET (CODE, simreg.ic + 1, (short *) &source);
+  GET_IMMED ((short *) &source);
   source += CHK_RX ();
 
   if (ak != 0)
@@ -1941,7 +2291,10 @@ ex_lst ()		/* 7Dxy */
     {
       GET (DATA, (ushort) source,     (short *) &simreg.mk);
       GET (DATA, (ushort) source + 2, (short *) &simreg.ic);
+      flush_cs ();
       GET (DATA, (ushort) source + 1, (short *) &simreg.sw);
+      if (profiling)
+	profile_return ();
     }
 
   return (nc_LST);
@@ -1952,11 +2305,13 @@ ex_sjs ()		/* 7Exy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();  /* needs to be BEFORE decrementing r[upper] ... */
   simreg.r[upper]--;          /* ... for the case of (lower == upper) */
   PUT (DATA, (ushort) simreg.r[upper], (short) simreg.ic + 2);
   simreg.ic = addr;
+  if (profiling)
+    profile_call (PROF_SJS);
 
   return (nc_SJS);
 }
@@ -1969,6 +2324,8 @@ ex_urs ()		/* 7Fxy */
 
   GET (DATA, (ushort) simreg.r[upper], (short *) &simreg.ic);
   simreg.r[upper]++;
+  if (profiling)
+    profile_return ();
 
   return (nc_URS);
 }
@@ -1979,7 +2336,7 @@ ex_l ()			/* 80xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &simreg.r[upper]);
   update_cs (&simreg.r[upper], VAR_INT);
@@ -2023,7 +2380,7 @@ ex_li ()		/* 84xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &simreg.r[upper]);
@@ -2038,7 +2395,7 @@ ex_lim ()		/* 85xy */
 {
   ushort immed;
 
-  GET (CODE, simreg.ic + 1, (short *) &immed);
+  GET_IMMED ((short *) &immed);
   immed += CHK_RX ();		/* IMX */
 
   simreg.r[upper] = (short) immed;
@@ -2053,7 +2410,7 @@ ex_dl ()		/* 86xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   if (upper == 15)
@@ -2111,7 +2468,7 @@ ex_dli ()		/* 88xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
 
@@ -2141,7 +2498,7 @@ ex_lm ()		/* 89xy */
   ushort i, addr;
   int n_loads = (int) upper + 1;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   for (i = 0; i <= upper; i++)
     GET (DATA, addr + i, &simreg.r[i]);
@@ -2157,7 +2514,7 @@ ex_efl ()		/* 8Axy */
   ushort addr, i;
   short help[3];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   for (i = 0; i < 3; i++)
     {
@@ -2176,7 +2533,7 @@ ex_lub ()		/* 8Bxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -2193,7 +2550,7 @@ ex_llb ()		/* 8Cxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -2210,7 +2567,7 @@ ex_lubi ()		/* 8Dxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &help);
@@ -2228,7 +2585,7 @@ ex_llbi ()		/* 8Exy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &help);
@@ -2280,7 +2637,7 @@ ex_st ()		/* 90xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   PUT (DATA, addr, simreg.r[upper]);
@@ -2294,7 +2651,7 @@ ex_stc ()		/* 91xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   PUT (DATA, addr, (short) upper);
@@ -2308,7 +2665,7 @@ ex_stci ()		/* 92xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
 
@@ -2348,7 +2705,7 @@ ex_sti ()		/* 94xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
 
@@ -2368,7 +2725,7 @@ ex_sfbs ()		/* 95xy */
       break;
   simreg.r[lower] = i;
   if (i == 16)
-    simreg.sw = (simreg.sw & 0x0FFF) | CS_ZERO;
+    set_cs (CS_ZERO);
   else
     update_cs (&simreg.r[lower], VAR_INT);
 
@@ -2381,7 +2738,7 @@ ex_dst ()		/* 96xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   PUT (DATA, addr, simreg.r[upper]);
@@ -2397,7 +2754,7 @@ ex_srm ()		/* 97xy */
   ushort destin;
   short help1, help2, mask;
 
-  GET (CODE, simreg.ic + 1, (short *) &destin);
+  GET_IMMED ((short *) &destin);
   destin += CHK_RX ();
 
   mask = simreg.r[upper + 1];
@@ -2416,7 +2773,7 @@ ex_dsti ()		/* 98xy */
 {
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
 
@@ -2433,7 +2790,7 @@ ex_stm ()		/* 99xy */
   ushort i, addr;
   int n_stores = (int) upper + 1;  /* for stime.h calculation of nc_STM */
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   for (i = 0; i <= upper; i++)
@@ -2449,7 +2806,7 @@ ex_efst ()		/* 9Axy */
   ushort i;
   ushort addr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
 
   for (i = 0; i < 3; i++)
@@ -2465,7 +2822,7 @@ ex_stub ()		/* 9Bxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
   
@@ -2481,7 +2838,7 @@ ex_stlb ()		/* 9Cxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
   
@@ -2497,7 +2854,7 @@ ex_subi ()		/* 9Dxy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &help);
@@ -2514,7 +2871,7 @@ ex_slbi ()		/* 9Exy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, (short *) &addr);
   GET (DATA, addr, &help);
@@ -2567,7 +2924,7 @@ ex_a ()			/* A0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -2603,7 +2960,7 @@ ex_incm ()		/* A3xy */
   ushort addr;
   short help1, help2 = upper + 1;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help1);
 
@@ -2669,7 +3026,7 @@ ex_da ()		/* A6xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2695,7 +3052,7 @@ ex_fa ()		/* A8xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2721,7 +3078,7 @@ ex_efa ()		/* AAxy */
   ushort addr;
   short help[3];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2776,7 +3133,7 @@ ex_uar ()		/* ADxy */
 
   simreg.r[upper] = (short) lhelp;
   if (lhelp > 0xFFFFL)
-    simreg.sw = (simreg.sw & 0x0FFF) | CS_CARRY;
+    set_cs (CS_CARRY);
   else
     update_cs (&simreg.r[upper], VAR_INT);
 
@@ -2791,14 +3148,14 @@ ex_ua ()		/* AExy */
   short help;
   ulong lhelp;  /* need it for some brain damaged C compilers */
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
   lhelp = (ulong) simreg.r[upper] + (ulong) help;
   simreg.r[upper] = (short) lhelp;
   if (lhelp > 0xFFFFL)
-    simreg.sw = (simreg.sw & 0x0FFF) | CS_CARRY;
+    set_cs (CS_CARRY);
   else
     update_cs (&simreg.r[upper], VAR_INT);
 
@@ -2812,7 +3169,7 @@ ex_s ()			/* B0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -2849,7 +3206,7 @@ ex_decm ()		/* B3xy */
   ushort addr;
   short help1, help2 = upper + 1;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help1);
 
@@ -2891,7 +3248,7 @@ ex_ds ()		/* B6xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2917,7 +3274,7 @@ ex_fs ()		/* B8xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2943,7 +3300,7 @@ ex_efs ()		/* BAxy */
   ushort addr;
   short help[3];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -2985,7 +3342,7 @@ ex_usr ()		/* BDxy */
 
   simreg.r[upper] = (short) lhelp;
   if (lhelp > 0xFFFFL)
-    simreg.sw = (simreg.sw & 0x0FFF) | CS_CARRY;
+    set_cs (CS_CARRY);
   else
     update_cs (&simreg.r[upper], VAR_INT);
 
@@ -3000,14 +3357,14 @@ ex_us ()		/* BExy */
   short help;
   ulong lhelp;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
   lhelp = (ulong) simreg.r[upper] - (ulong) help;
   simreg.r[upper] = (short) lhelp;
   if (lhelp > 0xFFFFL)
-    simreg.sw = (simreg.sw & 0x0FFF) | CS_CARRY;
+    set_cs (CS_CARRY);
   else
     update_cs (&simreg.r[upper], VAR_INT);
 
@@ -3021,7 +3378,7 @@ ex_ms ()		/* C0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3066,7 +3423,7 @@ ex_m ()			/* C4xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3091,7 +3448,7 @@ ex_dm ()		/* C6xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3117,7 +3474,7 @@ ex_fm ()		/* C8xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3143,7 +3500,7 @@ ex_efm ()		/* CAxy */
   ushort addr;
   short help[3];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3170,7 +3527,7 @@ ex_dv ()		/* D0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3217,7 +3574,7 @@ ex_d ()			/* D4xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3242,7 +3599,7 @@ ex_dd ()		/* D6xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3268,7 +3625,7 @@ ex_fd ()		/* D8xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3294,7 +3651,7 @@ ex_efd ()		/* DAxy */
   ushort addr;
   short help[3];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3321,7 +3678,7 @@ ex_ste ()		/* DCxy */
   ushort addr;
   ulong laddr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   laddr = (ulong) addr;
 
   if (lower > 0)
@@ -3344,7 +3701,7 @@ ex_dste ()		/* DDxy */
   ushort addr;
   ulong laddr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   laddr = (ulong) addr;
 
   if (lower > 0)
@@ -3368,7 +3725,7 @@ ex_le ()		/* DExy */
   ushort addr;
   ulong laddr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   laddr = (ulong) addr;
 
   if (lower > 0)
@@ -3393,7 +3750,7 @@ ex_dle ()		/* DFxy */
   ushort addr;
   ulong laddr;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   laddr = (ulong) addr;
 
   if (lower > 0)
@@ -3420,7 +3777,7 @@ ex_or ()		/* E0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3447,7 +3804,7 @@ ex_and ()		/* E2xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3474,7 +3831,7 @@ ex_xor ()		/* E4xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3501,7 +3858,7 @@ ex_n ()			/* E6xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3525,17 +3882,13 @@ ex_nr ()		/* E7xy */
 static int
 ex_fix ()		/* E8xy */
 {
-  long help = (long) from_1750flt (&simreg.r[lower]);
-
   /* To Be Clarified:
      The following behavior is what this operation SHOULD do, but
      *not* what the Fairchild F9450 manual prescribes (the manual says
      FIXOFL occurs, regardless of mantissa, if the exponent of the addr
      number exceeds 2^15). */
-  if (help < -32768 || help > 32767)
+  if (flt1750_fix (&simreg.r[lower], &simreg.r[upper]) != 0)
     simreg.pir |= INTR_FIXOFL;
-  else
-    simreg.r[upper] = (short) help;
   update_cs (&simreg.r[upper], VAR_INT);
 
   simreg.ic++;
@@ -3545,8 +3898,7 @@ ex_fix ()		/* E8xy */
 static int
 ex_flt ()		/* E9xy */
 {
-  /* To Be Tested  (depends on C hostcompiler cast). */
-  to_1750flt ((double) simreg.r[lower], &simreg.r[upper]);
+  flt1750_flt (simreg.r[lower], &simreg.r[upper]);
   update_cs (&simreg.r[upper], VAR_FLOAT);
 
   simreg.ic++;
@@ -3556,16 +3908,10 @@ ex_flt ()		/* E9xy */
 static int
 ex_efix ()		/* EAxy */
 {
-  long help;
   /* This time, we do exactly as the F9450 manual prescribes! */
-  if ((char) (simreg.r[lower + 1] & 0xFF) > 0x1F)
+  if ((char) (simreg.r[lower + 1] & 0xFF) > 0x1F
+      || flt1750_efix (&simreg.r[lower], &simreg.r[upper]) != 0)
     simreg.pir |= INTR_FIXOFL;
-  else
-    {
-      help = (long) from_1750eflt (&simreg.r[lower]);
-      simreg.r[upper] = (short) (help >> 16);
-      simreg.r[upper + 1] = (short) (help & 0xFFFF);
-    }
   update_cs (&simreg.r[upper], VAR_LONG);
 
   simreg.ic++;
@@ -3575,10 +3921,7 @@ ex_efix ()		/* EAxy */
 static int
 ex_eflt ()		/* EBxy */
 {
-  long help = ((long) simreg.r[lower] << 16)
-	    | ((long) simreg.r[lower+1] & 0xFFFFL);
-
-  to_1750eflt ((double) help, &simreg.r[upper]);
+  flt1750_eflt (&simreg.r[lower], &simreg.r[upper]);
   update_cs (&simreg.r[upper], VAR_DOUBLE);
 
   simreg.ic++;
@@ -3614,7 +3957,7 @@ ex_c ()			/* F0xy */
   ushort addr;
   short help;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &help);
 
@@ -3658,22 +4001,22 @@ ex_cisn ()		/* F3xy */
 static int
 ex_cbl ()		/* F4xy */
 {
-  ushort addr, sw_save = simreg.sw & 0x0FFF;
+  ushort addr;
   short lowlim, highlim;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr, &lowlim);
   GET (DATA, addr + 1, &highlim);
 
   if (lowlim > highlim)
-    simreg.sw = sw_save | CS_CARRY;
+    set_cs (CS_CARRY);
   else if (simreg.r[upper] < lowlim)
-    simreg.sw = sw_save | CS_NEGATIVE;
+    set_cs (CS_NEGATIVE);
   else if (simreg.r[upper] > highlim)
-    simreg.sw = sw_save | CS_POSITIVE;
+    set_cs (CS_POSITIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_CBL);
@@ -3682,18 +4025,17 @@ ex_cbl ()		/* F4xy */
 static int
 ex_ucim ()		/* F5xy */
 {
-  ushort sw_save = simreg.sw & 0x0FFF;
   ushort help1, help2;
 
   help1 = (ushort) simreg.r[upper];
-  GET (CODE, simreg.ic + 1, (short *) &help2);
+  GET_IMMED ((short *) &help2);
 
   if (help1 < help2)
-    simreg.sw = sw_save | CS_NEGATIVE;
+    set_cs (CS_NEGATIVE);
   else if (help1 > help2)
-    simreg.sw = sw_save | CS_POSITIVE;
+    set_cs (CS_POSITIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_CIM);
@@ -3705,7 +4047,7 @@ ex_dc ()		/* F6xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3731,7 +4073,7 @@ ex_fc ()		/* F8xy */
   ushort addr;
   short help[2];
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   GET (DATA, addr,     &help[0]);
   GET (DATA, addr + 1, &help[1]);
@@ -3758,7 +4100,7 @@ ex_efc ()		/* FAxy */
   short help[3];
   ushort i;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   for (i = 0; i < 3; i++)
     GET (DATA, addr + i, &help[i]);
@@ -3781,17 +4123,16 @@ ex_efcr ()		/* FBxy */
 static int
 ex_ucr ()		/* FCxy */
 {
-  ushort sw_save = simreg.sw & 0x0FFF;
   ushort help1, help2;
 
   help1 = (ushort) simreg.r[upper];
   help2 = (ushort) simreg.r[lower];
   if (help1 < help2)
-    simreg.sw = sw_save | CS_NEGATIVE;
+    set_cs (CS_NEGATIVE);
   else if (help1 > help2)
-    simreg.sw = sw_save | CS_POSITIVE;
+    set_cs (CS_POSITIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic++;
   return (nc_CR);
@@ -3800,21 +4141,20 @@ ex_ucr ()		/* FCxy */
 static int
 ex_uc ()		/* FDxy */
 {
-  ushort sw_save = simreg.sw & 0x0FFF;
   ushort addr;
   ushort help1, help2;
 
-  GET (CODE, simreg.ic + 1, (short *) &addr);
+  GET_IMMED ((short *) &addr);
   addr += CHK_RX ();
   help1 = (ushort) simreg.r[upper];
   GET (DATA, addr, (short *) &help2);
 
   if (help1 < help2)
-    simreg.sw = sw_save | CS_NEGATIVE;
+    set_cs (CS_NEGATIVE);
   else if (help1 > help2)
-    simreg.sw = sw_save | CS_POSITIVE;
+    set_cs (CS_POSITIVE);
   else
-    simreg.sw = sw_save | CS_ZERO;
+    set_cs (CS_ZERO);
 
   simreg.ic += 2;
   return (nc_C);
@@ -3962,28 +4302,561 @@ static int (*exfunc[256])() =
   };
 
 
+/* Whether the opcode table has an instruction for the high byte */
+
+bool
+valid_opcode (unsigned opc_hibyte)
+{
+  return exfunc[opc_hibyte & 0xFF] != ex_ill;
+}
+
+
+static int
+decode (struct decoded *dc, ulong phys_address)
+{
+  ushort word;
+
+  if (peek (phys_address, &word) == 0)
+    {
+      error ("read error at ic = %04X\n", simreg.ic);
+      return MEMERR;
+    }
+  dc->handler = exfunc[word >> 8];
+  dc->opcode = word;
+  dc->upper = (word & 0x00F0) >> 4;
+  dc->lower =  word & 0x000F;
+  dc->flags = DC_VALID;
+  switch (word >> 8)
+    {
+    case 0x48:		/* XIO */
+    case 0x49:		/* VIO */
+    case 0x93:		/* MOV works out timers and interrupts by itself */
+      dc->flags |= DC_SYNC | DC_ENDBLK | DC_NOCHAIN;
+      break;
+    case 0x4F:		/* BIF */
+    case 0x77:		/* BEX */
+    case 0x7C:		/* LSTI */
+    case 0x7D:		/* LST */
+      dc->flags |= DC_ENDBLK | DC_NOCHAIN;
+      break;
+    default:
+      if ((word >> 12) == 0x7)  /* jumps, branches, subroutine linkage */
+	dc->flags |= DC_ENDBLK;
+    }
+  dc->block = (struct block *) 0;
+  return OKAY;
+}
+
+
+/* Put the instruction about to be executed to the trace file */
+
+static void
+trace_instruction (struct decoded *dc, ulong phys_address)
+{
+  unsigned offset = (unsigned) phys_address & 0x0FFF;
+  mem_t *page = mem[phys_address >> 12];
+  ushort next_word = dc->immed;
+
+  /* Unless IC+1 is on the next page, it is the next physical word */
+  if (dc->flags & DC_IMMED)
+    ;
+  else if (offset < 0x0FFF && page != MNULL)
+    next_word = page->word[offset + 1];
+  else
+    get_raw (CODE, simreg.sw & 0xF, simreg.ic + 1, &next_word);
+  trace_insn (dc->opcode, next_word, phys_address);
+}
+
+
 int 
 execute (void)
 {
-  unsigned opc_hibyte;
+  struct decoded *dc;
+  ulong phys_address;
+  unsigned page;
   int cycles;
 
   if (! need_speed)
     add_to_backtrace ();
 
-  GET (CODE, simreg.ic, (short *) &opcode);
-  opc_hibyte = opcode >> 8;
-  upper = (opcode & 0x00F0) >> 4;
-  lower =  opcode & 0x000F;
-
-  cycles = (*exfunc[opc_hibyte]) ();
+  if ((cycles = check_access (CODE, simreg.ic, &phys_address, 0)) != OKAY)
+    return cycles;
+#ifndef BSVC
+  if ((bpindex = find_breakpt (READ, phys_address)) >= 0)
+    return BREAKPT;
+#endif
+  page = (unsigned) (phys_address >> 12);
+  if (dcache[page] == (struct decoded *) 0)
+    {
+      dcache[page] = (struct decoded *) calloc (4096, sizeof (struct decoded));
+      if (dcache[page] == (struct decoded *) 0)
+	problem ("execute: no memory for instruction cache");
+    }
+  dc = &dcache[page][(unsigned) phys_address & 0x0FFF];
+  if (! (dc->flags & DC_VALID) && (cycles = decode (dc, phys_address)) != OKAY)
+    return cycles;
+  if (tracing)
+    trace_instruction (dc, phys_address);
+  cur_decoded = dc;
+  opcode = dc->opcode;
+  upper = dc->upper;
+  lower = dc->lower;
+
+  cycles = (*dc->handler) ();
   if (cycles < 0)
-    return cycles;  /* BREAKPT or MEMERR */
+    {
+      trace_insn_done ();
+      return cycles;  /* BREAKPT or MEMERR */
+    }
+  if (profiling)
+    profile_insn (phys_address, cycles);
+  if (covering)
+    cover_insn (phys_address);
+  COUNT_OPCODE (opcode, cycles);
 
   instcnt++;
   total_time_in_us += (double)(uP_CYCLE_IN_NS * cycles) / 1000.0;
   workout_timing (cycles);
   workout_interrupts ();
+  trace_insn_done ();
+  return OKAY;
+}
+
+
+
+/************************** Basic block engine *****************************/
+
+/* execute_block() is an alternative to execute() which runs straight-line
+   code as basic blocks of predecoded instructions. A block is recorded
+   the first time its start address is executed and replayed through the
+   cached handler pointers afterwards. It ends at the first control
+   transfer, at an instruction that may change the Address State, the MMU
+   or the timers, at a page boundary, or after BLOCK_MAX instructions.
+   Timers and interrupts are worked out once per block. A block is cut
+   short when an instruction raises a new interrupt, so that overflow and
+   BEX traps are still taken right after the instruction.
+   A block ending in a jump or branch remembers its last two successors
+   together with the AS/AK in effect, so that loops run without going
+   through the address translation again. Successor links are discarded
+   when the MMU is reprogrammed (see mmu_changed()).
+   The engine does not check for breakpoints; the caller must fall back
+   to execute() when any are set.
+   With ENGINE_JIT, a block which has been replayed JIT_THRESHOLD times
+   is translated to host code by jit.c, unless it contains instructions
+   that need the timers worked out or that may change the AS or the MMU
+   (XIO, VIO, MOV, BIF, BEX, LST, LSTI); those are always left to the
+   handlers. ENGINE_LOCKSTEP runs each translated block, undoes its
+   effects, and runs it again through the handlers, reporting any
+   difference. Translated code is only used with SPEED ON, since it
+   does not record the backtrace. */
+
+#define BLOCK_MAX      32
+#define BLOCK_POOL     4096
+#define JIT_THRESHOLD  32
+
+struct block
+  {
+    struct decoded *op[BLOCK_MAX];
+    ushort offset[BLOCK_MAX];	/* IC & 0x0FFF of each op when recorded */
+    int n_ops;
+    ulong  chain_gen;		/* mmu_generation of the successor links */
+    struct block *succ[2];
+    ushort succ_ic[2];
+    ushort succ_key[2];		/* AS and AK at entry to the successor */
+    int hits;			/* replays, or -1 if not to be translated */
+    jit_code native;		/* translation, if any */
+  };
+
+THREAD_LOCAL int engine_mode = ENGINE_INTERP;
+
+static THREAD_LOCAL struct block *block_pool;
+static THREAD_LOCAL int n_blocks;
+static THREAD_LOCAL struct block *last_block;  /* block just run, may chain */
+static THREAD_LOCAL ulong mmu_generation;
+
+/* mmu_changed() must be called whenever the page registers are written. */
+
+void
+mmu_changed (void)
+{
+  tlb_flush ();
+  mmu_generation++;
+  vector_valid = 0;
+}
+
+/* tlb_flush() must be called whenever a page of mem[] is replaced. */
+
+void
+tlb_flush (void)
+{
+  memset ((void *) tlb, 0, sizeof (tlb));
+}
+
+static void
+flush_blocks (void)
+{
+  int i, j;
+
+  jit_flush ();
+  jit_stale = FALSE;
+  if (n_blocks == 0)
+    return;
+  for (i = 0; i < N_PAGES; i++)
+    if (dcache[i] != (struct decoded *) 0)
+      for (j = 0; j < 4096; j++)
+	{
+	  dcache[i][j].block = (struct block *) 0;
+	  dcache[i][j].flags &= ~DC_JIT;
+	}
+  n_blocks = 0;
+  last_block = (struct block *) 0;
+}
+
+static struct block *
+new_block (void)
+{
+  struct block *b;
+
+  if (block_pool == (struct block *) 0)
+    {
+      block_pool = (struct block *) calloc (BLOCK_POOL, sizeof (struct block));
+      if (block_pool == (struct block *) 0)
+	problem ("execute_block: no memory for block cache");
+    }
+  if (n_blocks >= BLOCK_POOL)
+    flush_blocks ();
+  b = &block_pool[n_blocks++];
+  memset ((void *) b, 0, sizeof (struct block));
+  return b;
+}
+
+/* Find the block to be run at the current IC, first trying the successor
+   links of the block previously run. Returns NULL if the instruction at
+   IC has not been recorded into a block yet; in that case *dcp is set
+   to its decoded entry. */
+
+static struct block *
+find_block (struct decoded **dcp, ulong *phys_address, int *status)
+{
+  ushort key = simreg.sw & 0xFF;
+  struct block *b;
+  struct decoded *dc;
+  unsigned page;
+  int k;
+
+  *status = OKAY;
+  if ((b = last_block) != (struct block *) 0 && b->chain_gen == mmu_generation)
+    for (k = 0; k < 2; k++)
+      if (b->succ[k] != (struct block *) 0 && b->succ_ic[k] == simreg.ic
+	  && b->succ_key[k] == key && b->succ[k]->op[0]->block == b->succ[k])
+	return b->succ[k];
+
+  if ((*status = check_access (CODE, simreg.ic, phys_address, 0)) != OKAY)
+    return (struct block *) 0;
+  page = (unsigned) (*phys_address >> 12);
+  if (dcache[page] == (struct decoded *) 0)
+    {
+      dcache[page] = (struct decoded *) calloc (4096, sizeof (struct decoded));
+      if (dcache[page] == (struct decoded *) 0)
+	problem ("execute: no memory for instruction cache");
+    }
+  dc = &dcache[page][(unsigned) *phys_address & 0x0FFF];
+  if (! (dc->flags & DC_VALID) && (*status = decode (dc, *phys_address)) != OKAY)
+    return (struct block *) 0;
+  *dcp = dc;
+  if ((b = dc->block) != (struct block *) 0 && last_block != (struct block *) 0)
+    {
+      /* link it as successor of the previous block */
+      if (last_block->chain_gen != mmu_generation)
+	{
+	  last_block->succ[0] = last_block->succ[1] = (struct block *) 0;
+	  last_block->chain_gen = mmu_generation;
+	}
+      k = (last_block->succ[0] == (struct block *) 0) ? 0 : 1;
+      if (k == 1)
+	{
+	  last_block->succ[1] = last_block->succ[0];
+	  last_block->succ_ic[1] = last_block->succ_ic[0];
+	  last_block->succ_key[1] = last_block->succ_key[0];
+	}
+      last_block->succ[0] = b;
+      last_block->succ_ic[0] = simreg.ic;
+      last_block->succ_key[0] = key;
+    }
+  return b;
+}
+
+
+/* Run a block through the instruction handlers. When `rec' is given,
+   the block is recorded into it, starting with the decoded entry `dc'
+   at `phys_address'. */
+
+static int
+run_block (struct block *b, struct block *rec, struct decoded *dc,
+	   ulong phys_address, long *cycles)
+{
+  ushort pir_at_start = simreg.pir;
+  ushort page_of_block = simreg.ic & 0xF000;
+  int i, status = OKAY;
+
+  for (i = 0; i < BLOCK_MAX; i++)
+    {
+      if (rec != (struct block *) 0)
+	{
+	  /* recording: fetch the next instruction on the same page */
+	  if (i > 0)
+	    {
+	      if ((simreg.ic & 0xF000) != page_of_block)
+		break;
+	      phys_address = (phys_address & ~0x0FFFL) | (simreg.ic & 0x0FFF);
+	      dc = &dcache[phys_address >> 12][simreg.ic & 0x0FFF];
+	      if (! (dc->flags & DC_VALID))
+		{
+		  ushort word;
+		  if (! peek (phys_address, &word))
+		    break;
+		  decode (dc, phys_address);
+		}
+	    }
+	  rec->offset[rec->n_ops] = simreg.ic & 0x0FFF;
+	  rec->op[rec->n_ops++] = dc;
+	}
+      else
+	{
+	  if (i >= b->n_ops)
+	    break;
+	  dc = b->op[i];
+	  /* Code overwritten in the block may have been decoded again
+	     with another length, so that the ops recorded after it no
+	     longer follow on */
+	  if (! (dc->flags & DC_VALID)
+	      || (simreg.ic & 0x0FFF) != b->offset[i])
+	    break;
+	}
+
+      if (dc->flags & DC_SYNC)
+	{
+	  total_time_in_us += (double)(uP_CYCLE_IN_NS * *cycles) / 1000.0;
+	  workout_timing ((int) *cycles);
+	  *cycles = 0L;
+	}
+      if (! need_speed)
+	add_to_backtrace ();
+      cur_decoded = dc;
+      opcode = dc->opcode;
+      upper = dc->upper;
+      lower = dc->lower;
+      if ((status = (*dc->handler) ()) < 0)
+	{
+	  if (rec != (struct block *) 0)
+	    rec->n_ops--;
+	  return status;
+	}
+      instcnt++;
+      *cycles += status;
+      if (dc->flags & DC_ENDBLK)
+	{
+	  if (! (dc->flags & DC_NOCHAIN))
+	    last_block = b;
+	  break;
+	}
+      if (simreg.pir != pir_at_start)
+	break;
+    }
   return OKAY;
 }
 
+/* Call-out from translated code to the handler of a decoded entry.
+   The translated code works on simreg.sw directly, so the CS must be
+   up to date when it gets control back. */
+
+static int
+call_decoded (void *entry)
+{
+  struct decoded *dc = (struct decoded *) entry;
+  int status;
+
+  cur_decoded = dc;
+  opcode = dc->opcode;
+  upper = dc->upper;
+  lower = dc->lower;
+  status = (*dc->handler) ();
+  flush_cs ();
+  return status;
+}
+
+static void
+translate_block (struct block *b)
+{
+  struct jit_op ops[BLOCK_MAX];
+  bool full;
+  int i;
+
+  for (i = 0; i < b->n_ops; i++)
+    {
+      struct decoded *dc = b->op[i];
+
+      if (dc->flags & (DC_SYNC | DC_NOCHAIN))
+	{
+	  b->hits = -1;		/* left to the handlers */
+	  return;
+	}
+      ops[i].opcode = dc->opcode;
+      ops[i].immed = dc->immed;
+      ops[i].has_immed = (dc->flags & DC_IMMED) != 0;
+      ops[i].entry = (void *) dc;
+    }
+  b->native = jit_translate (ops, b->n_ops, call_decoded, &jit_stale, &full);
+  if (full)
+    jit_stale = TRUE;		/* start over with an empty code buffer */
+  else if (b->native == (jit_code) 0)
+    b->hits = -1;
+  else
+    for (i = 0; i < b->n_ops; i++)
+      b->op[i]->flags |= DC_JIT;
+}
+
+static int
+run_native (struct block *b, long *cycles)
+{
+  long result[2];
+  int status;
+
+  flush_cs ();
+  status = (*b->native) (&simreg, result);
+  *cycles = result[0];
+  instcnt += result[1];
+  if (status == OKAY && result[1] == b->n_ops
+      && (b->op[b->n_ops - 1]->flags & (DC_ENDBLK | DC_NOCHAIN)) == DC_ENDBLK)
+    last_block = b;
+  return status;
+}
+
+static void
+report_lockstep (struct block *b, struct regs *start, struct regs *native,
+		 int native_status, long *result, int n_writes,
+		 int status, long cycles, ulong n_ops, int n_ref_writes)
+{
+  static char *regname[] =
+    { "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7",
+      "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15",
+      "PIR", "MK", "FT", "IC", "SW", "TA", "TB", "GO", "SYS" };
+  ushort *nat = (ushort *) native, *ref = (ushort *) &simreg;
+  int i;
+
+  error ("lockstep: translated block at %04hX (%d instructions) differs",
+	 start->ic, b->n_ops);
+  lprintf ("\t\ttranslated\thandlers\n");
+  lprintf ("\tstatus\t%d\t\t%d\n", native_status, status);
+  lprintf ("\tcycles\t%ld\t\t%ld\n", result[0], cycles);
+  lprintf ("\tinstr.\t%ld\t\t%lu\n", result[1], n_ops);
+  lprintf ("\twrites\t%d\t\t%d\n", n_writes, n_ref_writes);
+  for (i = 0; i < (int) (sizeof (struct regs) / sizeof (ushort)); i++)
+    if (nat[i] != ref[i])
+      lprintf ("\t%s\t%04hX\t\t%04hX\n", regname[i], nat[i], ref[i]);
+}
+
+/* Run the translation of a block, undo its effects, and run the block
+   again through the handlers. The latter's results are kept. */
+
+static int
+lockstep_block (struct block *b, long *cycles)
+{
+  static THREAD_LOCAL struct journal_entry native_writes[JOURNAL_SIZE];
+  struct regs start, native;
+  bool save_verbose = verbose, comparable;
+  ulong count;
+  long result[2];
+  int native_status, status, n_writes, n_ref_writes, i;
+
+  flush_cs ();
+  start = simreg;
+  journal_start ();
+  verbose = FALSE;		/* messages come from the handler run */
+  native_status = (*b->native) (&simreg, result);
+  verbose = save_verbose;
+  n_writes = journal_stop ();
+  native = simreg;
+  memcpy ((void *) native_writes, (void *) journal,
+	  n_writes * sizeof (struct journal_entry));
+  journal_undo ();
+  simreg = start;
+  /* A store into translated code makes the two runs take different
+     paths; no comparison is possible then. */
+  comparable = ! jit_stale;
+
+  count = instcnt;
+  journal_start ();
+  status = run_block (b, (struct block *) 0, (struct decoded *) 0, 0L, cycles);
+  n_ref_writes = journal_stop ();
+  if (! comparable || jit_stale)
+    return status;
+  flush_cs ();
+
+  comparable = (native_status == status && result[0] == *cycles
+		&& (ulong) result[1] == instcnt - count
+		&& memcmp ((void *) &native, (void *) &simreg,
+			   sizeof (struct regs)) == 0
+		&& n_writes == n_ref_writes);
+  for (i = 0; comparable && i < n_writes; i++)
+    comparable = (native_writes[i].phys_address == journal[i].phys_address
+		  && native_writes[i].new_value == journal[i].new_value);
+  if (! comparable)
+    {
+      report_lockstep (b, &start, &native, native_status, result, n_writes,
+		       status, *cycles, instcnt - count, n_ref_writes);
+      b->native = (jit_code) 0;
+      b->hits = -1;
+    }
+  return status;
+}
+
+
+int
+execute_block (void)
+{
+  struct block *b;
+  struct decoded *dc = (struct decoded *) 0;
+  ulong phys_address = 0L;
+  long cycles = 0L;
+  int status;
+
+  if (jit_stale)
+    flush_blocks ();
+  b = find_block (&dc, &phys_address, &status);
+  if (status != OKAY)
+    return status;
+  last_block = (struct block *) 0;
+  if (b == (struct block *) 0)
+    {
+      b = new_block ();
+      status = run_block (b, b, dc, phys_address, &cycles);
+      if (b->n_ops > 0)
+	b->op[0]->block = b;
+      else
+	n_blocks--;
+    }
+  else
+    {
+      if (engine_mode >= ENGINE_JIT && need_speed
+	  && b->native == (jit_code) 0 && b->hits >= 0
+	  && ++b->hits >= JIT_THRESHOLD)
+	translate_block (b);
+      if (b->native == (jit_code) 0 || engine_mode < ENGINE_JIT || ! need_speed)
+	status = run_block (b, (struct block *) 0, dc, phys_address, &cycles);
+      else if (engine_mode == ENGINE_LOCKSTEP)
+	status = lockstep_block (b, &cycles);
+      else
+	status = run_native (b, &cycles);
+    }
+
+  total_time_in_us += (double)(uP_CYCLE_IN_NS * cycles) / 1000.0;
+  workout_timing ((int) cycles);
+  if (status < 0)
+    {
+      last_block = (struct block *) 0;
+      return status;  /* BREAKPT or MEMERR */
+    }
+  workout_interrupts ();
+  return OKAY;
+}
@@ -4,20 +4,28 @@
 
 extern void   init_cpu (void);
 extern int    execute (void);
+extern void   invalidate_decoded (ulong phys_address);
+extern void   invalidate_page (unsigned page);
+extern void   flush_decoded (void);
+extern int    execute_block (void);
+extern void   mmu_changed (void);
+extern void   tlb_flush (void);
+extern void   sync_timers (void);
+extern ushort step_timers (struct regs *r, ulong elapsed, ulong *tatick_in_ns,
+			   ushort *tbtick_in_tatix, ushort *gotick_in_10usec);
+extern void   timers_changed (void);
+extern bool   valid_opcode (unsigned opc_hibyte);
+extern THREAD_LOCAL int engine_mode; /* execution engine of GO: */
+#define ENGINE_INTERP    0   /* execute() */
+#define ENGINE_BLOCK     1   /* execute_block() */
+#define ENGINE_JIT       2   /* execute_block() with translation */
+#define ENGINE_LOCKSTEP  3   /* same, checking translations */
 /* return value of execute() is either the number of cycles, or: */
 #define BREAKPT  -1
 #define MEMERR   -2
 
-/* extern struct regs simreg;
-   (should be here but it's so ubiquitous that it is mentioned in arch.h) */
-extern struct mmureg pagereg[2][16][16];
-extern bool   executed_bpt;
-extern ulong  instcnt;
-extern int    bpindex;
-extern double total_time_in_us;
-
-#define BT_SIZE (200)
-extern struct regs bt_buff [BT_SIZE];
-extern int bt_next;
-extern int bt_cnt;
+/* simreg, pagereg, instcnt, total_time_in_us and the backtrace buffer
+   are part of the machine context (machine.h) */
+extern THREAD_LOCAL bool executed_bpt;
+extern THREAD_LOCAL int  bpindex;
 
@@ -65,12 +65,12 @@ extern char *find_label (int bank, ushort address);
 
 /* Internal data */
 
-static ushort opcode;
-static ushort upper;  /* Upper nibble of lower byte of opcode (bits 8..11) */
-static ushort lower;  /* Lower nibble of lower byte of opcode (bits 12..15) */
-static ushort dataword; /* Buffer for data word that might follow opcode */
+static THREAD_LOCAL ushort opcode;
+static THREAD_LOCAL ushort upper;    /* bits 8..11 of opcode */
+static THREAD_LOCAL ushort lower;    /* bits 12..15 of opcode */
+static THREAD_LOCAL ushort dataword; /* data word that might follow opcode */
 
-static char *msg;	/* aux. text pointer */
+static THREAD_LOCAL char *msg;	/* aux. text pointer */
 
 
 /******************** auxiliary print functions ************************/
@@ -31,12 +31,12 @@ void  do_xio (ushort address, ushort *value)
   else if (address == 0x0500)
     {
       /* write to serial interface 1 data register */
-      printf ("%c", *value);
+      fputc (*value, CONSOLE_OUT);
     }
   else if (address == 0x8500)
     {
       /* read from serial interface 1 data register */
-      *value = getchar ();
+      *value = getc (CONSOLE_IN);
     }
   else
 #endif
@@ -46,13 +46,13 @@ void  do_xio (ushort address, ushort *value)
       unsigned input_value;
 
       info ("IO from %04hX < == ", address);
-      if (scanf ("%i", &input_value) <= 0)
+      if (fscanf (CONSOLE_IN, "%i", &input_value) <= 0)
 	{                     /* check for input redirection */
-	  if (!isatty (fileno (stdin)))
+	  if (!isatty (fileno (CONSOLE_IN)))
 	    problem ("Reading past end of input file !");
 	}
       *value = (ushort) input_value;
-      if (!isatty (fileno (stdin)))
+      if (!isatty (fileno (CONSOLE_IN)))
         info ("0x%04hX\n", value);
     }
   else			/* XIO write */
@@ -34,9 +34,15 @@
 
 #include "arch.h"
 #include "status.h"
+#include "arith.h"
 #include "cpu.h"
 #include "smemacc.h"
 #include "break.h"
+#include "btrace.h"
+#include "tracefile.h"
+#include "profile.h"
+#include "opstats.h"
+#include "coverage.h"
 
 /* Imports */
 
@@ -87,7 +93,13 @@ si_go (int argc, char *argv[])
     {
       if (sys_int (1L))
 	return INTERRUPT;
-      if (execute () == MEMERR)
+      if (engine_mode != ENGINE_INTERP && n_breakpts == 0
+	  && ! tracing && ! profiling && ! covering && ! OPSTATS_ENABLED)
+	{
+	  if (execute_block () == MEMERR)
+	    break;
+	}
+      else if (execute () == MEMERR)
 	break;
       if (at_bpt_instruction ())
 	{
@@ -222,36 +234,33 @@ si_bt (int argc, char *argv[])
   int count = 10;
   int back = 10;
   struct regs save;
-  int t;
+  struct bt_cursor cursor;
 
+  if (argc > 1)
+    sscanf (argv[1], "%x", &back);
   if (argc > 2)
-    {
-      if (argc > 3)
-        error ("excess arguments ignored");
-      else
-        sscanf (argv[1], "%x %x", &back, &count);
-    }
+    sscanf (argv[2], "%x", &count);
+  if (argc > 3)
+    error ("excess arguments ignored");
 
-  if (count > bt_cnt)
-    count = bt_cnt;
+  if (back > bt_depth ())
+    back = bt_depth ();
+  if (back <= 0 || bt_seek (&cursor, (ulong) back) != OKAY)
+    return info ("\tbacktrace is empty");
 
   /* save current regs */
+  sync_timers ();
+  flush_cs ();
   save = simreg;
 
-  /* step back through backtrace buffer */
-  t = bt_next - back;
-  if (t < 0)
-    t += BT_SIZE;
-
+  /* step forward from `back' instructions ago */
   while (count-- > 0)
     {
-      simreg = bt_buff [t];
+      simreg = cursor.regs;
       lprintf ("\tIC : %04hX   %s", simreg.ic, disassemble ());
       dis_reg (0);
-
-      t++;
-      if (t >= BT_SIZE)
-        t = 0;
+      if (! bt_step (&cursor))
+	break;
     }
 
   /* restore old regs */
@@ -261,3 +270,24 @@ si_bt (int argc, char *argv[])
 }
 
 
+int
+si_btsize (int argc, char *argv[])
+{
+  ulong megabytes;
+  int status;
+
+  if (argc > 1)
+    {
+      if (sscanf (argv[1], "%lu", &megabytes) != 1 || megabytes == 0)
+	return error ("invalid size -- must be a number of megabytes");
+      if ((status = bt_resize (megabytes << 20)) != OKAY)
+	return status;
+      lprintf ("\tBacktrace buffer of %lu KB\n", bt_size () >> 10);
+      return (OKAY);
+    }
+  lprintf ("\tBacktrace buffer of %lu KB, %lu instructions deep\n",
+	   bt_size () >> 10, bt_depth ());
+  return (OKAY);
+}
+
+
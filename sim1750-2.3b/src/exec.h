@@ -5,4 +5,5 @@ extern int  si_snglstp (int argc, char *argv[]);
 extern int  si_trace   (int argc, char *argv[]);
 
 extern int  si_bt      (int argc, char *argv[]);
+extern int  si_btsize  (int argc, char *argv[]);
 
@@ -0,0 +1,390 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : farm.c -- multithreaded regression farm mode                */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* farm.c  --  run a manifest of regression jobs on a pool of threads.
+
+   Each line of the manifest describes one job by four fields separated
+   by white space:
+
+	<image>  <batch>  <stimulus>  <expected>
+
+   image     load file, its format taken from the extension: .cof/.coff
+	     (COFF), .ldm (TLD LDM), anything else Tektronix hex.
+   batch     command file run after loading. If there is none but an
+	     image, the image is run by GO as with the -c/-l/-t options.
+   stimulus  file read in place of stdin, i.e. by the interpreter after
+	     the batch file and by console XIO input.
+   expected  file with the expected output. The output is considered
+	     to pass if it is identical; otherwise it is kept in
+	     <expected>.actual.
+
+   A field of `-' means there is no such file. Empty lines and lines
+   starting with `#' are ignored.
+
+   Every job runs on its own machine (see machine.c) with its own
+   interpreter state and output stream. Jobs are dealt out to the
+   workers in turn; a worker that runs out of jobs steals from the far
+   end of the other workers' queues. When all jobs are done, one line
+   per job and a total line are written to stdout:
+
+	<job> PASS|FAIL|ERROR <instructions> <seconds> <image>
+	total <jobs> pass <n> fail <n> error <n> seconds <wall time>
+
+   <instructions> is the instruction count at the end of the job; note
+   that the INFO command resets it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "type.h"
+#include "status.h"
+#include "utils.h"
+#include "cmd.h"
+#include "cpu.h"
+#include "machine.h"
+#include "loadfile.h"
+#include "farm.h"
+
+#if (defined (__unix__) && ! defined (NO_THREADS))
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#define MAX_THREADS  256
+
+enum { PASS, FAIL, ERR };
+static const char *result_name[] = { "PASS", "FAIL", "ERROR" };
+
+struct job
+  {
+    char  *image, *batch, *stimulus, *expected;
+    int    result;
+    ulong  instructions;
+    double seconds;
+  };
+
+struct worker
+  {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    int            *queue;	/* job indices */
+    int             head, tail;	/* own end, stealing end */
+  };
+
+static struct job    *jobs;
+static int            n_jobs;
+static struct worker *workers;
+static int            n_workers;
+
+/* settings of the main thread, handed to the workers */
+static bool farm_verbose, farm_need_speed;
+static int  farm_engine_mode;
+
+
+static double
+now_in_seconds (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, (struct timezone *) 0);
+  return (double) tv.tv_sec + (double) tv.tv_usec / 1e6;
+}
+
+
+static char *
+field (char **p)
+{
+  char *start = skip_white (*p), *end;
+
+  if (start == NULL || *start == '\0')
+    return NULL;
+  end = skip_nonwhite (start);
+  *p = end;
+  if (*end != '\0')
+    *p = end + 1;
+  *end = '\0';
+  return eq (start, "-") ? "" : strdup (start);
+}
+
+
+static int
+read_manifest (char *manifest)
+{
+  FILE *fp;
+  char line[1024], *p;
+  int  max_jobs = 0, lineno = 0;
+  struct job *j;
+
+  if ((fp = fopen (manifest, "r")) == NULL)
+    return error ("farm: cannot open manifest %s", manifest);
+  n_jobs = 0;
+  while (fgets (line, sizeof (line), fp) != NULL)
+    {
+      lineno++;
+      p = skip_white (line);
+      if (p == NULL || *p == '\0' || *p == '\n' || *p == '#')
+	continue;
+      if (n_jobs >= max_jobs)
+	{
+	  max_jobs += 64;
+	  jobs = (struct job *) realloc (jobs, max_jobs * sizeof (struct job));
+	  if (jobs == NULL)
+	    problem ("farm: out of memory");
+	}
+      j = &jobs[n_jobs];
+      memset ((void *) j, 0, sizeof (struct job));
+      if (p[strlen (p) - 1] == '\n')
+	p[strlen (p) - 1] = '\0';
+      if ((j->image = field (&p)) == NULL
+	  || (j->batch = field (&p)) == NULL
+	  || (j->stimulus = field (&p)) == NULL
+	  || (j->expected = field (&p)) == NULL)
+	{
+	  fclose (fp);
+	  return error ("farm: %s line %d: four fields expected",
+			manifest, lineno);
+	}
+      n_jobs++;
+    }
+  fclose (fp);
+  return OKAY;
+}
+
+
+static int
+load_image (char *image)
+{
+  char *f_argv[3], *ext = strrchr (image, '.');
+
+  f_argv[0] = NULL;
+  f_argv[1] = image;
+  f_argv[2] = NULL;
+  if (ext != NULL && (eq (ext, ".cof") || eq (ext, ".coff")))
+    return si_lcf (2, f_argv);
+  if (ext != NULL && eq (ext, ".ldm"))
+    return si_ldm (2, f_argv);
+  return si_lo (2, f_argv);
+}
+
+
+/* Compare the output with the expected file; keep it if different. */
+
+static int
+check_output (FILE *output, char *expected)
+{
+  FILE *fp;
+  char  actual[1024];
+  int   c, result = PASS;
+
+  if (*expected == '\0')
+    return PASS;
+  if ((fp = fopen (expected, "r")) == NULL)
+    return ERR;
+  rewind (output);
+  while ((c = getc (output)) != EOF)
+    if (getc (fp) != c)
+      {
+	result = FAIL;
+	break;
+      }
+  if (result == PASS && getc (fp) != EOF)
+    result = FAIL;
+  fclose (fp);
+
+  if (result == FAIL && strlen (expected) < sizeof (actual) - 8)
+    {
+      sprintf (actual, "%s.actual", expected);
+      if ((fp = fopen (actual, "w")) != NULL)
+	{
+	  rewind (output);
+	  while ((c = getc (output)) != EOF)
+	    putc (c, fp);
+	  fclose (fp);
+	}
+    }
+  return result;
+}
+
+
+static void
+run_job (struct job *j)
+{
+  FILE  *input, *output;
+  double start = now_in_seconds ();
+  char  *f_argv[1];
+
+  output = tmpfile ();
+  input = (*j->stimulus != '\0') ? fopen (j->stimulus, "r") : tmpfile ();
+  if (output == NULL || input == NULL)
+    {
+      j->result = ERR;
+      if (output != NULL)
+	fclose (output);
+      if (input != NULL)
+	fclose (input);
+      return;
+    }
+  console_out = output;
+  console_in = input;
+  logfile = (FILE *) 0;
+
+  select_machine (new_machine ());
+  init_simulator (0);
+  j->result = PASS;
+  if (*j->image != '\0' && load_image (j->image) != OKAY)
+    j->result = ERR;
+  else if (*j->batch == '\0' && *j->image != '\0')
+    {
+      f_argv[0] = NULL;
+      si_go (0, f_argv);
+    }
+  else
+    batch_interpreter (input, (*j->batch != '\0') ? j->batch : NULL);
+
+  fflush (output);
+  if (logfile != (FILE *) 0)
+    fclose (logfile);
+  logfile = (FILE *) 0;
+  console_out = console_in = (FILE *) 0;
+  j->instructions = instcnt;
+  delete_machine (machine);
+  if (j->result == PASS)
+    j->result = check_output (output, j->expected);
+  fclose (output);
+  fclose (input);
+  j->seconds = now_in_seconds () - start;
+}
+
+
+static int
+next_job (int self)
+{
+  struct worker *w = &workers[self];
+  int i, job = -1;
+
+  pthread_mutex_lock (&w->lock);
+  if (w->head < w->tail)
+    job = w->queue[w->head++];
+  pthread_mutex_unlock (&w->lock);
+
+  for (i = 1; job < 0 && i < n_workers; i++)
+    {
+      w = &workers[(self + i) % n_workers];
+      pthread_mutex_lock (&w->lock);
+      if (w->head < w->tail)
+	job = w->queue[--w->tail];
+      pthread_mutex_unlock (&w->lock);
+    }
+  return job;
+}
+
+
+static void *
+worker_main (void *arg)
+{
+  int self = (int) (long) arg, job;
+
+  verbose = farm_verbose;
+  need_speed = farm_need_speed;
+  engine_mode = farm_engine_mode;
+  while ((job = next_job (self)) >= 0)
+    run_job (&jobs[job]);
+  return NULL;
+}
+
+
+int
+farm (char *manifest, int n_threads)
+{
+  int i, count[3];
+  double start;
+
+  if (read_manifest (manifest) != OKAY)
+    return ERROR;
+  if (n_threads < 1)
+    n_threads = 1;
+  if (n_threads > MAX_THREADS)
+    n_threads = MAX_THREADS;
+  if (n_threads > n_jobs && n_jobs > 0)
+    n_threads = n_jobs;
+
+  farm_verbose = verbose;
+  farm_need_speed = need_speed;
+  farm_engine_mode = engine_mode;
+
+  n_workers = n_threads;
+  workers = (struct worker *) calloc (n_workers, sizeof (struct worker));
+  if (workers == NULL)
+    problem ("farm: out of memory");
+  for (i = 0; i < n_workers; i++)
+    {
+      pthread_mutex_init (&workers[i].lock, NULL);
+      workers[i].queue = (int *) malloc ((n_jobs / n_workers + 1) * sizeof (int));
+      if (workers[i].queue == NULL)
+	problem ("farm: out of memory");
+    }
+  for (i = 0; i < n_jobs; i++)
+    {
+      struct worker *w = &workers[i % n_workers];
+      w->queue[w->tail++] = i;
+    }
+
+  start = now_in_seconds ();
+  for (i = 0; i < n_workers; i++)
+    if (pthread_create (&workers[i].thread, NULL, worker_main,
+			(void *) (long) i) != 0)
+      problem ("farm: cannot create worker thread");
+  for (i = 0; i < n_workers; i++)
+    pthread_join (workers[i].thread, NULL);
+
+  count[PASS] = count[FAIL] = count[ERR] = 0;
+  for (i = 0; i < n_jobs; i++)
+    {
+      printf ("%d %s %lu %.3f %s\n", i + 1, result_name[jobs[i].result],
+	      jobs[i].instructions, jobs[i].seconds, jobs[i].image);
+      count[jobs[i].result]++;
+    }
+  printf ("total %d pass %d fail %d error %d seconds %.3f\n", n_jobs,
+	  count[PASS], count[FAIL], count[ERR], now_in_seconds () - start);
+
+  for (i = 0; i < n_workers; i++)
+    {
+      pthread_mutex_destroy (&workers[i].lock);
+      free ((void *) workers[i].queue);
+    }
+  free ((void *) workers);
+  return (count[PASS] == n_jobs) ? OKAY : ERROR;
+}
+
+#else  /* no threads */
+
+int
+farm (char *manifest, int n_threads)
+{
+  return error ("farm mode is not available on this host");
+}
+
+#endif
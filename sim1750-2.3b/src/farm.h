@@ -0,0 +1,8 @@
+/* farm.h -- exports of farm.c */
+
+#ifndef _FARM_H
+#define _FARM_H
+
+extern int farm (char *manifest, int n_threads);
+
+#endif
@@ -42,7 +42,6 @@
 #define ushort unsigned short
 #define ulong  unsigned long
 
-#define FLOATING_TWO_TO_THE_FIFTEEN            32768.0
 #define FLOATING_TWO_TO_THE_TWENTYTHREE      8388608.0
 #define FLOATING_TWO_TO_THE_THIRTYONE     2147483648.0
 #define FLOATING_TWO_TO_THE_THIRTYNINE  549755813888.0
@@ -116,15 +115,7 @@ int
 to_1750eflt (double input, short output[3])
 {
   int exp;
-  int is_neg = 0;
-  ushort hlp;
-
-  if (input < 0.0)
-    {
-      is_neg = 1;
-      /* FIXME: what's the .03125/FLO... for? */
-      input = -input - .03125 / FLOATING_TWO_TO_THE_THIRTYNINE;
-    }
+  double hi, lo;
 
   input = dfrexp (input, &exp);	/* input is now normalized mantissa */
 
@@ -133,27 +124,520 @@ to_1750eflt (double input, short output[3])
       input = 0.5;
       exp++;
     }
+  else if (input < 0.0 && input >= -0.5)	/* prompted by UNIX frexp */
+    {
+      input *= 2.0;
+      exp--;
+    }
 
   if (exp < -128)
     return -1;			/* signalize underflow */
   else if (exp > 127)
     return 1;			/* signalize overflow */
 
-  output[0] = (short) (input * FLOATING_TWO_TO_THE_FIFTEEN);
-  input -= (double) output[0] / FLOATING_TWO_TO_THE_FIFTEEN;
-  hlp = (ushort) (input * FLOATING_TWO_TO_THE_TWENTYTHREE);
-  output[1] = (short) ((hlp << 8) | (exp & 0xFF));
-  input -= (double) hlp / FLOATING_TWO_TO_THE_TWENTYTHREE;
-  hlp = (ushort) (input * FLOATING_TWO_TO_THE_THIRTYNINE);
-  output[2] = (short) hlp;
+  /* The 40 bit two's complement mantissa, truncated towards minus
+     infinity, split into its upper 24 and lower 16 bits */
+  input = floor (ldexp (input, 39));
+  hi = floor (input / 65536.0);
+  lo = input - hi * 65536.0;
+
+  output[0] = (short) (long) floor (hi / 256.0);
+  output[1] = (short) ((((long) hi & 0xFF) << 8) | (exp & 0xFF));
+  output[2] = (short) (ushort) lo;
+
+  return 0;			/* success status */
+}
+
+
+
+/* Integer arithmetic on 1750A 32-bit floats.
+
+   The operands are unpacked into a 24 bit two's complement mantissa m
+   and an exponent e, the value being m * 2^(e-23), and are normalized
+   such that m lies in [2^22, 2^23) or in [-2^23, -2^22). Results are
+   worked out with enough extra bits that truncating them to 24 bits
+   gives the same as truncating the exact result, i.e. they are rounded
+   towards minus infinity by dropping the surplus low bits of the two's
+   complement mantissa. Only 32 bit arithmetic is used.
+
+   The functions return 0 on success, 1 on overflow, -1 on underflow
+   (like to_1750flt), and 2 on division by zero. */
+
+#define M_BIT22  0x400000L
+#define M_BIT23  0x800000L
+
+/* Arithmetic shift right that rounds towards minus infinity no matter
+   what the host compiler does with negative numbers */
+#define FLOOR_SHIFT(x,n)  ((x) < 0 ? ~(~(x) >> (n)) : (x) >> (n))
+
+static void
+unpack (short *input, long *mant, int *exp)
+{
+  long m = ((long) input[0] << 8) | (((long) input[1] >> 8) & 0xFF);
+  int e = (signed char) (input[1] & 0xFF);
+
+  if (m != 0)
+    while (m < M_BIT22 && m >= -M_BIT22)
+      {
+	m <<= 1;
+	e--;
+      }
+  *mant = m;
+  *exp = e;
+}
+
+/* Store m * 2^(e-23), truncated to 24 bits of mantissa */
 
-  if (is_neg)			/* FIXME: need 2's complement here */
+static int
+pack (long m, int e, short output[2])
+{
+  if (m == 0)
+    {
+      output[0] = output[1] = 0;
+      return 0;
+    }
+  while (m >= M_BIT23 || m < -M_BIT23)
     {
-      output[0] = ~output[0];
-      output[1] = (~output[1] & 0xFF00) | (output[1] & 0x00FF);
-      output[2] = ~output[2];
+      m = FLOOR_SHIFT (m, 1);
+      e++;
     }
+  while (m < M_BIT22 && m >= -M_BIT22)
+    {
+      m <<= 1;
+      e--;
+    }
+  if (e < -128)
+    return -1;			/* signalize underflow */
+  else if (e > 127)
+    return 1;			/* signalize overflow */
+  output[0] = (short) (m >> 8);
+  output[1] = (short) (((m & 0xFF) << 8) | (e & 0xFF));
+  return 0;
+}
 
-  return 0;			/* success status */
+/* Six guard bits: after an alignment shift of two or more the sum needs
+   at most one normalizing left shift, and with a shift of less than six
+   no bits get lost at all. */
+#define GUARD  6
+
+static int
+add (long m0, int e0, long m1, int e1, short output[2])
+{
+  int d;
+
+  if (m1 == 0)
+    return pack (m0, e0, output);
+  if (m0 == 0)
+    return pack (m1, e1, output);
+  if (e0 < e1)
+    {
+      long m = m0;
+      int e = e0;
+
+      m0 = m1, e0 = e1;
+      m1 = m, e1 = e;
+    }
+  d = e0 - e1;
+  if (d > 30)
+    d = 30;
+  m0 <<= GUARD;
+  m1 <<= GUARD;
+  return pack (m0 + FLOOR_SHIFT (m1, d), e0 - GUARD, output);
+}
+
+int
+flt1750_add (short *op0, short *op1, short output[2])
+{
+  long m0, m1;
+  int e0, e1;
+
+  unpack (op0, &m0, &e0);
+  unpack (op1, &m1, &e1);
+  return add (m0, e0, m1, e1, output);
+}
+
+int
+flt1750_sub (short *op0, short *op1, short output[2])
+{
+  long m0, m1;
+  int e0, e1;
+
+  unpack (op0, &m0, &e0);
+  unpack (op1, &m1, &e1);
+  return add (m0, e0, -m1, e1, output);
+}
+
+/* The 47 bit product is put together from 12 bit halves of the
+   mantissas. Only product / 2^20 is kept, which is exact where it
+   matters: the low 20 bits cannot change the truncated result. */
+
+int
+flt1750_mul (short *op0, short *op1, short output[2])
+{
+  long m0, m1, h0, l0, h1, l1, mid, low;
+  int e0, e1;
+
+  unpack (op0, &m0, &e0);
+  unpack (op1, &m1, &e1);
+  if (m0 == 0 || m1 == 0)
+    return pack (0L, 0, output);
+  h0 = FLOOR_SHIFT (m0, 12);
+  l0 = m0 & 0xFFF;
+  h1 = FLOOR_SHIFT (m1, 12);
+  l1 = m1 & 0xFFF;
+  low = l0 * l1;
+  mid = h0 * l1 + l0 * h1 + (low >> 12);
+  return pack (h0 * h1 * 16 + FLOOR_SHIFT (mid, 8), e0 + e1 - 3, output);
+}
+
+/* Long division of the magnitudes, 25 bits beyond the binary point,
+   with the remainder deciding the last bit of a negative quotient. */
+
+int
+flt1750_div (short *op0, short *op1, short output[2])
+{
+  long m0, m1, q, r;
+  int e0, e1, i, negative;
+
+  unpack (op0, &m0, &e0);
+  unpack (op1, &m1, &e1);
+  /* as in arith(), anything smaller than 2^-129 counts as zero */
+  if (m1 == 0 || e1 < -129 || (e1 == -129 && m1 != -M_BIT23))
+    return 2;			/* signalize zero divide */
+  if (m0 == 0)
+    return pack (0L, 0, output);
+  negative = ((m0 < 0) != (m1 < 0));
+  if (m0 < 0)
+    m0 = -m0;
+  if (m1 < 0)
+    m1 = -m1;
+  q = m0 / m1;
+  r = m0 % m1;
+  for (i = 0; i < 25; i++)
+    {
+      q <<= 1;
+      r <<= 1;
+      if (r >= m1)
+	{
+	  r -= m1;
+	  q |= 1;
+	}
+    }
+  if (negative)
+    q = -q - (r != 0);
+  return pack (q, e0 - e1 - 2, output);
+}
+
+/* Returns -1, 0, or 1 as op0 is less than, equal to, or greater than op1 */
+
+int
+flt1750_cmp (short *op0, short *op1)
+{
+  long m0, m1;
+  int e0, e1;
+
+  unpack (op0, &m0, &e0);
+  unpack (op1, &m1, &e1);
+  if (m0 == 0 || m1 == 0 || (m0 < 0) != (m1 < 0))
+    return (m0 > m1) - (m0 < m1);
+  if (e0 != e1)
+    return ((m0 > 0) == (e0 > e1)) ? 1 : -1;
+  return (m0 > m1) - (m0 < m1);
+}
+
+/* Convert to a 16 bit integer, truncating towards zero as the C cast
+   does. Returns 1 if the result does not fit. */
+
+int
+flt1750_fix (short *input, short *output)
+{
+  long m;
+  int e;
+
+  unpack (input, &m, &e);
+  if (m == 0 || e < 0)
+    {
+      *output = 0;
+      return 0;
+    }
+  if (e > 16)
+    return 1;			/* signalize overflow */
+  m = (m < 0) ? -(-m >> (23 - e)) : m >> (23 - e);
+  if (m < -32768L || m > 32767L)
+    return 1;
+  *output = (short) m;
+  return 0;
+}
+
+void
+flt1750_flt (short input, short output[2])
+{
+  pack ((long) input, 23, output);
+}
+
+
+/* The same for 1750A 48-bit extended floats, whose 40 bit mantissa is
+   m * 2^(e-39). The integer versions need long long; without LONGLONG
+   the operations fall back on host doubles, whose 53 bit mantissa
+   still holds any extended operand exactly. */
+
+#ifdef LONGLONG
+
+#define E_BIT38  0x4000000000LL
+#define E_BIT39  0x8000000000LL
+
+static void
+unpack_ext (short *input, long long *mant, int *exp)
+{
+  long long m = ((long long) input[0] << 24)
+		| ((long long) (input[1] & 0xFF00) << 8)
+		| (long long) (input[2] & 0xFFFF);
+  int e = (signed char) (input[1] & 0xFF);
+
+  if (m != 0)
+    while (m < E_BIT38 && m >= -E_BIT38)
+      {
+	m <<= 1;
+	e--;
+      }
+  *mant = m;
+  *exp = e;
+}
+
+static int
+pack_ext (long long m, int e, short output[3])
+{
+  if (m == 0)
+    {
+      output[0] = output[1] = output[2] = 0;
+      return 0;
+    }
+  while (m >= E_BIT39 || m < -E_BIT39)
+    {
+      m = FLOOR_SHIFT (m, 1);
+      e++;
+    }
+  while (m < E_BIT38 && m >= -E_BIT38)
+    {
+      m <<= 1;
+      e--;
+    }
+  if (e < -128)
+    return -1;			/* signalize underflow */
+  else if (e > 127)
+    return 1;			/* signalize overflow */
+  output[0] = (short) (m >> 24);
+  output[1] = (short) (((m >> 8) & 0xFF00) | (e & 0xFF));
+  output[2] = (short) (m & 0xFFFF);
+  return 0;
+}
+
+static int
+add_ext (long long m0, int e0, long long m1, int e1, short output[3])
+{
+  int d;
+
+  if (m1 == 0)
+    return pack_ext (m0, e0, output);
+  if (m0 == 0)
+    return pack_ext (m1, e1, output);
+  if (e0 < e1)
+    {
+      long long m = m0;
+      int e = e0;
+
+      m0 = m1, e0 = e1;
+      m1 = m, e1 = e;
+    }
+  d = e0 - e1;
+  if (d > 62)
+    d = 62;
+  m0 <<= GUARD;
+  m1 <<= GUARD;
+  return pack_ext (m0 + FLOOR_SHIFT (m1, d), e0 - GUARD, output);
+}
+
+int
+flt1750_eadd (short *op0, short *op1, short output[3])
+{
+  long long m0, m1;
+  int e0, e1;
+
+  unpack_ext (op0, &m0, &e0);
+  unpack_ext (op1, &m1, &e1);
+  return add_ext (m0, e0, m1, e1, output);
+}
+
+int
+flt1750_esub (short *op0, short *op1, short output[3])
+{
+  long long m0, m1;
+  int e0, e1;
+
+  unpack_ext (op0, &m0, &e0);
+  unpack_ext (op1, &m1, &e1);
+  return add_ext (m0, e0, -m1, e1, output);
+}
+
+/* As for 32-bit floats, with 20 bit halves and product / 2^36 */
+
+int
+flt1750_emul (short *op0, short *op1, short output[3])
+{
+  long long m0, m1, h0, l0, h1, l1, mid, low;
+  int e0, e1;
+
+  unpack_ext (op0, &m0, &e0);
+  unpack_ext (op1, &m1, &e1);
+  if (m0 == 0 || m1 == 0)
+    return pack_ext (0LL, 0, output);
+  h0 = FLOOR_SHIFT (m0, 20);
+  l0 = m0 & 0xFFFFF;
+  h1 = FLOOR_SHIFT (m1, 20);
+  l1 = m1 & 0xFFFFF;
+  low = l0 * l1;
+  mid = h0 * l1 + l0 * h1 + (low >> 20);
+  return pack_ext (h0 * h1 * 16 + FLOOR_SHIFT (mid, 16), e0 + e1 - 3, output);
+}
+
+int
+flt1750_ediv (short *op0, short *op1, short output[3])
+{
+  long long m0, m1, q, r;
+  int e0, e1, i, negative;
+
+  unpack_ext (op0, &m0, &e0);
+  unpack_ext (op1, &m1, &e1);
+  if (m1 == 0 || e1 < -129 || (e1 == -129 && m1 != -E_BIT39))
+    return 2;			/* signalize zero divide */
+  if (m0 == 0)
+    return pack_ext (0LL, 0, output);
+  negative = ((m0 < 0) != (m1 < 0));
+  if (m0 < 0)
+    m0 = -m0;
+  if (m1 < 0)
+    m1 = -m1;
+  q = m0 / m1;
+  r = m0 % m1;
+  for (i = 0; i < 41; i++)
+    {
+      q <<= 1;
+      r <<= 1;
+      if (r >= m1)
+	{
+	  r -= m1;
+	  q |= 1;
+	}
+    }
+  if (negative)
+    q = -q - (r != 0);
+  return pack_ext (q, e0 - e1 - 2, output);
+}
+
+int
+flt1750_ecmp (short *op0, short *op1)
+{
+  long long m0, m1;
+  int e0, e1;
+
+  unpack_ext (op0, &m0, &e0);
+  unpack_ext (op1, &m1, &e1);
+  if (m0 == 0 || m1 == 0 || (m0 < 0) != (m1 < 0))
+    return (m0 > m1) - (m0 < m1);
+  if (e0 != e1)
+    return ((m0 > 0) == (e0 > e1)) ? 1 : -1;
+  return (m0 > m1) - (m0 < m1);
+}
+
+/* Convert to a 32 bit integer in output[0..1], truncating towards zero.
+   Returns 1 if the result does not fit. */
+
+int
+flt1750_efix (short *input, short output[2])
+{
+  long long m;
+  int e;
+
+  unpack_ext (input, &m, &e);
+  if (m == 0 || e < 0)
+    m = 0;
+  else if (e > 32)
+    return 1;			/* signalize overflow */
+  else
+    m = (m < 0) ? -(-m >> (39 - e)) : m >> (39 - e);
+  if (m < -0x80000000LL || m > 0x7FFFFFFFLL)
+    return 1;
+  output[0] = (short) (m >> 16);
+  output[1] = (short) (m & 0xFFFF);
+  return 0;
+}
+
+void
+flt1750_eflt (short input[2], short output[3])
+{
+  pack_ext (((long long) input[0] << 16) | (input[1] & 0xFFFF), 39, output);
+}
+
+#else  /* no LONGLONG */
+
+#define DBL_1750_MIN  \
+ 1.469367938527859384960920671527807097273331945965109401885939632848E-39
+
+int
+flt1750_eadd (short *op0, short *op1, short output[3])
+{
+  return to_1750eflt (from_1750eflt (op0) + from_1750eflt (op1), output);
+}
+
+int
+flt1750_esub (short *op0, short *op1, short output[3])
+{
+  return to_1750eflt (from_1750eflt (op0) - from_1750eflt (op1), output);
+}
+
+int
+flt1750_emul (short *op0, short *op1, short output[3])
+{
+  return to_1750eflt (from_1750eflt (op0) * from_1750eflt (op1), output);
+}
+
+int
+flt1750_ediv (short *op0, short *op1, short output[3])
+{
+  double divisor = from_1750eflt (op1);
+
+  if (fabs (divisor) < DBL_1750_MIN)
+    return 2;			/* signalize zero divide */
+  return to_1750eflt (from_1750eflt (op0) / divisor, output);
+}
+
+int
+flt1750_ecmp (short *op0, short *op1)
+{
+  double fop0 = from_1750eflt (op0), fop1 = from_1750eflt (op1);
+
+  return (fop0 > fop1) - (fop0 < fop1);
+}
+
+int
+flt1750_efix (short *input, short output[2])
+{
+  double help = from_1750eflt (input);
+  long l;
+
+  if (help <= -2147483649.0 || help >= 2147483648.0)
+    return 1;			/* signalize overflow */
+  l = (long) help;
+  output[0] = (short) (l >> 16);
+  output[1] = (short) (l & 0xFFFF);
+  return 0;
+}
+
+void
+flt1750_eflt (short input[2], short output[3])
+{
+  to_1750eflt ((double) (((long) input[0] << 16) | (input[1] & 0xFFFFL)),
+	       output);
 }
 
+#endif
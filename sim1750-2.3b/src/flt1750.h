@@ -5,3 +5,21 @@ extern int      to_1750flt  (double input, short output[2]);
 extern double from_1750eflt (short  *input);  /* input: array of 3 shorts */
 extern int      to_1750eflt (double input, short output[3]);
 
+
+/* Integer arithmetic on 32-bit floats; see flt1750.c for status values */
+extern int  flt1750_add (short *op0, short *op1, short output[2]);
+extern int  flt1750_sub (short *op0, short *op1, short output[2]);
+extern int  flt1750_mul (short *op0, short *op1, short output[2]);
+extern int  flt1750_div (short *op0, short *op1, short output[2]);
+extern int  flt1750_cmp (short *op0, short *op1);
+extern int  flt1750_fix (short *input, short *output);
+extern void flt1750_flt (short input, short output[2]);
+
+/* The same for 48-bit extended floats */
+extern int  flt1750_eadd (short *op0, short *op1, short output[3]);
+extern int  flt1750_esub (short *op0, short *op1, short output[3]);
+extern int  flt1750_emul (short *op0, short *op1, short output[3]);
+extern int  flt1750_ediv (short *op0, short *op1, short output[3]);
+extern int  flt1750_ecmp (short *op0, short *op1);
+extern int  flt1750_efix (short *input, short output[2]);
+extern void flt1750_eflt (short input[2], short output[3]);
@@ -0,0 +1,858 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : fltcheck.c -- float arithmetic cross-check                  */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* fltcheck.c  --  sim1750-fltcheck, check the float arithmetic of
+   flt1750.c against an exact reference.
+
+   Usage:  sim1750-fltcheck [<cases> [<threads>]]
+
+   FA, FS, FM, FD, FC and FIX on 32-bit floats and EFA, EFS, EFM, EFD,
+   EFC and EFIX on 48-bit extended floats are each run on <cases>
+   random operands (default 1000000), FLT on all 65536 integers and
+   EFLT on <cases> random long integers. The cases are shared out among
+   <threads> threads, by default one per processor.
+
+   The reference works on exact values n * 2^k, n being an integer of
+   up to BIG_BITS bits, which hold any sum, product or quotient of two
+   floats without loss. The exact result is then truncated towards
+   minus infinity to the largest float not above it, as the 1750A does
+   by dropping the low bits of the two's complement mantissa.
+
+   The operands include unnormalized ones, extreme exponents, special
+   mantissas, and pairs of nearly equal or nearly opposite values. Each
+   difference found is listed (the first MAX_REPORTS of them), and the
+   exit status tells whether there were any. `make fltcheck' builds and
+   runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "type.h"
+#include "flt1750.h"
+
+#define MAX_THREADS   256
+#define MAX_REPORTS   20
+#define DEFAULT_CASES 1000000L
+
+
+/* Exact values: sign and magnitude in 16 bit limbs, least significant
+   first, times a power of two */
+
+#define N_LIMBS   24
+#define BIG_BITS  (N_LIMBS * 16)
+
+struct big
+  {
+    int neg;
+    ulong d[N_LIMBS];
+  };
+
+struct value
+  {
+    struct big n;
+    int k;		/* the value is n * 2^k */
+  };
+
+static void
+big_zero (struct big *b)
+{
+  memset ((void *) b, 0, sizeof (struct big));
+}
+
+static int
+is_zero (struct big *b)
+{
+  int i;
+
+  for (i = 0; i < N_LIMBS; i++)
+    if (b->d[i] != 0)
+      return FALSE;
+  return TRUE;
+}
+
+static int
+bit_length (struct big *b)
+{
+  int i, n;
+  ulong x;
+
+  for (i = N_LIMBS - 1; i >= 0; i--)
+    if (b->d[i] != 0)
+      {
+	for (n = 0, x = b->d[i]; x != 0; x >>= 1)
+	  n++;
+	return i * 16 + n;
+      }
+  return 0;
+}
+
+static int
+mag_cmp (struct big *a, struct big *b)
+{
+  int i;
+
+  for (i = N_LIMBS - 1; i >= 0; i--)
+    if (a->d[i] != b->d[i])
+      return (a->d[i] > b->d[i]) ? 1 : -1;
+  return 0;
+}
+
+/* r = a + b and r = a - b (a >= b) on the magnitudes; r may be a or b */
+
+static void
+mag_add (struct big *r, struct big *a, struct big *b)
+{
+  ulong carry = 0;
+  int i;
+
+  for (i = 0; i < N_LIMBS; i++)
+    {
+      carry += a->d[i] + b->d[i];
+      r->d[i] = carry & 0xFFFF;
+      carry >>= 16;
+    }
+}
+
+static void
+mag_sub (struct big *r, struct big *a, struct big *b)
+{
+  ulong borrow = 0, x;
+  int i;
+
+  for (i = 0; i < N_LIMBS; i++)
+    {
+      x = a->d[i] - b->d[i] - borrow;
+      borrow = (a->d[i] < b->d[i] + borrow);
+      r->d[i] = x & 0xFFFF;
+    }
+}
+
+static void
+mag_shl (struct big *b, int n)
+{
+  int i, limbs = n / 16, bits = n % 16;
+
+  if (n <= 0)
+    return;
+  for (i = N_LIMBS - 1; i >= 0; i--)
+    {
+      ulong x = (i >= limbs) ? b->d[i - limbs] << bits : 0;
+
+      if (bits && i > limbs)
+	x |= b->d[i - limbs - 1] >> (16 - bits);
+      b->d[i] = x & 0xFFFF;
+    }
+}
+
+/* Shift right, returning whether any of the bits shifted out was set */
+
+static int
+mag_shr (struct big *b, int n)
+{
+  int i, limbs = n / 16, bits = n % 16, lost = FALSE;
+
+  if (n <= 0)
+    return FALSE;
+  for (i = 0; i < limbs && i < N_LIMBS; i++)
+    if (b->d[i] != 0)
+      lost = TRUE;
+  if (limbs < N_LIMBS && (b->d[limbs] & ((1UL << bits) - 1)) != 0)
+    lost = TRUE;
+  for (i = 0; i < N_LIMBS; i++)
+    {
+      ulong x = (i + limbs < N_LIMBS) ? b->d[i + limbs] >> bits : 0;
+
+      if (bits && i + limbs + 1 < N_LIMBS)
+	x |= b->d[i + limbs + 1] << (16 - bits);
+      b->d[i] = x & 0xFFFF;
+    }
+  return lost;
+}
+
+/* Signed r = a + b; r may be a or b */
+
+static void
+big_add (struct big *r, struct big *a, struct big *b)
+{
+  if (a->neg == b->neg)
+    {
+      r->neg = a->neg;
+      mag_add (r, a, b);
+    }
+  else if (mag_cmp (a, b) >= 0)
+    {
+      r->neg = a->neg;
+      mag_sub (r, a, b);
+    }
+  else
+    {
+      r->neg = b->neg;
+      mag_sub (r, b, a);
+    }
+  if (is_zero (r))
+    r->neg = FALSE;
+}
+
+/* r = a * b; r must be neither a nor b */
+
+static void
+big_mul (struct big *r, struct big *a, struct big *b)
+{
+  int i, j;
+
+  big_zero (r);
+  for (i = 0; i < N_LIMBS; i++)
+    {
+      ulong carry = 0;
+
+      if (a->d[i] == 0)
+	continue;
+      for (j = 0; i + j < N_LIMBS; j++)
+	{
+	  carry += r->d[i + j] + a->d[i] * b->d[j];
+	  r->d[i + j] = carry & 0xFFFF;
+	  carry >>= 16;
+	}
+    }
+  r->neg = (a->neg != b->neg) && ! is_zero (r);
+}
+
+/* Magnitudes q = a / b and r = a % b, bit by bit */
+
+static void
+mag_divmod (struct big *q, struct big *r, struct big *a, struct big *b)
+{
+  int i;
+
+  big_zero (q);
+  big_zero (r);
+  for (i = bit_length (a) - 1; i >= 0; i--)
+    {
+      mag_shl (r, 1);
+      r->d[0] |= (a->d[i / 16] >> (i % 16)) & 1;
+      if (mag_cmp (r, b) >= 0)
+	{
+	  mag_sub (r, r, b);
+	  q->d[i / 16] |= 1UL << (i % 16);
+	}
+    }
+}
+
+/* Load a 48 bit two's complement number given as three 16 bit limbs */
+
+static void
+load_limbs (struct big *b, ulong t0, ulong t1, ulong t2)
+{
+  big_zero (b);
+  b->d[0] = t0 & 0xFFFF;
+  b->d[1] = t1 & 0xFFFF;
+  b->d[2] = t2 & 0xFFFF;
+  if (t2 & 0x8000)
+    {
+      ulong carry = 1;
+      int i;
+
+      b->neg = TRUE;
+      for (i = 0; i < 3; i++)
+	{
+	  carry += ~b->d[i] & 0xFFFF;
+	  b->d[i] = carry & 0xFFFF;
+	  carry >>= 16;
+	}
+    }
+}
+
+static int
+exponent (short word)
+{
+  int e = word & 0xFF;
+
+  return (e > 127) ? e - 256 : e;
+}
+
+/* The 24 bit mantissa is the 16 bits of word 0 and the upper 8 bits of
+   word 1; the 40 bit one continues with the 16 bits of word 2 */
+
+static void
+load_flt (struct value *v, short *w)
+{
+  ulong w0 = (ushort) w[0], w1 = (ushort) w[1];
+  ulong sign = (w0 & 0x8000) ? 0xFFFF : 0;
+
+  load_limbs (&v->n, ((w0 & 0xFF) << 8) | (w1 >> 8),
+	      (w0 >> 8) | (sign & 0xFF00), sign);
+  v->k = exponent (w[1]) - 23;
+}
+
+static void
+load_eflt (struct value *v, short *w)
+{
+  ulong w0 = (ushort) w[0], w1 = (ushort) w[1], w2 = (ushort) w[2];
+  ulong sign = (w0 & 0x8000) ? 0xFF00 : 0;
+
+  load_limbs (&v->n, w2, (w1 >> 8) | ((w0 & 0xFF) << 8), (w0 >> 8) | sign);
+  v->k = exponent (w[1]) - 39;
+}
+
+static void
+load_int (struct value *v, long i)
+{
+  ulong u = (ulong) i & 0xFFFFFFFFUL;
+  ulong sign = (u & 0x80000000UL) ? 0xFFFF : 0;
+
+  load_limbs (&v->n, u & 0xFFFF, u >> 16, sign);
+  v->k = 0;
+}
+
+
+/* Truncate v towards minus infinity to a float with a <bits> bit
+   mantissa (24 or 40), returning what flt1750.c does: 0 on success,
+   1 on overflow, -1 on underflow. */
+
+static int
+to_float (struct value *v, int bits, short *out)
+{
+  struct big m;
+  ulong t[3];
+  int i, s, e;
+
+  if (is_zero (&v->n))
+    {
+      out[0] = out[1] = 0;
+      if (bits == 40)
+	out[2] = 0;
+      return 0;
+    }
+  /* A magnitude of bit_length bits goes to bits-1 bits; a negative
+     mantissa is rounded up in magnitude. Only for a negative power of
+     two does that leave the mantissa unnormalized, at -2^(bits-2). */
+  m = v->n;
+  s = bit_length (&m) - (bits - 1);
+  if (s < 0)
+    mag_shl (&m, -s);
+  else if (mag_shr (&m, s) && m.neg)
+    {
+      struct big one;
+
+      big_zero (&one);
+      one.d[0] = 1;
+      mag_add (&m, &m, &one);
+    }
+  if (m.neg && bit_length (&m) == bits - 1)
+    {
+      struct big p;
+
+      big_zero (&p);
+      p.d[(bits - 2) / 16] = 1UL << ((bits - 2) % 16);
+      if (mag_cmp (&m, &p) == 0)
+	{
+	  mag_shl (&m, 1);
+	  s--;
+	}
+    }
+  e = s + v->k + bits - 1;
+  if (e < -128)
+    return -1;
+  else if (e > 127)
+    return 1;
+
+  for (i = 0; i < 3; i++)
+    t[i] = m.d[i];
+  if (m.neg)
+    {
+      ulong carry = 1;
+
+      for (i = 0; i < 3; i++)
+	{
+	  carry += ~t[i] & 0xFFFF;
+	  t[i] = carry & 0xFFFF;
+	  carry >>= 16;
+	}
+    }
+  if (bits == 24)
+    {
+      out[0] = (short) ((t[0] >> 8) | ((t[1] & 0xFF) << 8));
+      out[1] = (short) (((t[0] & 0xFF) << 8) | (e & 0xFF));
+    }
+  else
+    {
+      out[0] = (short) ((t[1] >> 8) | ((t[2] & 0xFF) << 8));
+      out[1] = (short) (((t[1] & 0xFF) << 8) | (e & 0xFF));
+      out[2] = (short) t[0];
+    }
+  return 0;
+}
+
+/* Bring both values to the smaller of the two exponents */
+
+static void
+align (struct value *a, struct value *b)
+{
+  if (a->k > b->k)
+    {
+      mag_shl (&a->n, a->k - b->k);
+      a->k = b->k;
+    }
+  else
+    {
+      mag_shl (&b->n, b->k - a->k);
+      b->k = a->k;
+    }
+}
+
+static int
+ref_add (struct value a, struct value b, int subtract, int bits, short *out)
+{
+  if (subtract && ! is_zero (&b.n))
+    b.n.neg = ! b.n.neg;
+  align (&a, &b);
+  big_add (&a.n, &a.n, &b.n);
+  return to_float (&a, bits, out);
+}
+
+static int
+ref_mul (struct value a, struct value b, int bits, short *out)
+{
+  struct value p;
+
+  big_mul (&p.n, &a.n, &b.n);
+  p.k = a.k + b.k;
+  return to_float (&p, bits, out);
+}
+
+/* Anything smaller in magnitude than 2^-129 counts as a zero divisor.
+   The quotient is worked out to more than <bits> bits; truncating the
+   truncated quotient gives the same as truncating the exact one. */
+
+static int
+ref_div (struct value a, struct value b, int bits, short *out)
+{
+  struct value q;
+  struct big r;
+  int t, p = -129 - b.k;
+
+  if (is_zero (&b.n) || (p > 0 && bit_length (&b.n) <= p))
+    return 2;
+  if (is_zero (&a.n))
+    return to_float (&a, bits, out);
+  t = bit_length (&b.n) - bit_length (&a.n) + bits + 2;
+  if (t < 0)
+    t = 0;
+  mag_shl (&a.n, t);
+  mag_divmod (&q.n, &r, &a.n, &b.n);
+  q.n.neg = (a.n.neg != b.n.neg);
+  if (q.n.neg && ! is_zero (&r))
+    {
+      big_zero (&r);
+      r.d[0] = 1;
+      mag_add (&q.n, &q.n, &r);
+    }
+  q.k = a.k - b.k - t;
+  return to_float (&q, bits, out);
+}
+
+static int
+ref_cmp (struct value a, struct value b)
+{
+  if (! is_zero (&b.n))
+    b.n.neg = ! b.n.neg;
+  align (&a, &b);
+  big_add (&a.n, &a.n, &b.n);
+  if (is_zero (&a.n))
+    return 0;
+  return a.n.neg ? -1 : 1;
+}
+
+/* Truncate towards zero to a <bits> bit integer (16 or 32) in out[],
+   returning 1 if it does not fit */
+
+static int
+ref_fix (struct value v, int bits, short *out)
+{
+  ulong u, limit;
+
+  if (v.k >= 0)
+    {
+      if (! is_zero (&v.n) && bit_length (&v.n) + v.k > bits)
+	return 1;
+      mag_shl (&v.n, v.k);
+    }
+  else
+    mag_shr (&v.n, -v.k);
+  u = v.n.d[0] | (v.n.d[1] << 16);
+  if (bit_length (&v.n) > 32)
+    return 1;
+  limit = (1UL << (bits - 1)) - 1 + (v.n.neg ? 1 : 0);
+  if (u > limit)
+    return 1;
+  if (v.n.neg)
+    u = (~u + 1) & 0xFFFFFFFFUL;
+  if (bits == 16)
+    out[0] = (short) (u & 0xFFFF);
+  else
+    {
+      out[0] = (short) (u >> 16);
+      out[1] = (short) (u & 0xFFFF);
+    }
+  return 0;
+}
+
+
+/* The operations checked */
+
+enum op
+  {
+    FA, FS, FM, FD, FC, FIX, FLT,
+    EFA, EFS, EFM, EFD, EFC, EFIX, EFLT,
+    N_OPS
+  };
+
+static char *op_name[N_OPS] =
+  {
+    "FA", "FS", "FM", "FD", "FC", "FIX", "FLT",
+    "EFA", "EFS", "EFM", "EFD", "EFC", "EFIX", "EFLT"
+  };
+
+struct worker
+  {
+    pthread_t thread;
+    int index;
+    long cases;
+    ulong seed;
+    ulong done[N_OPS], errors[N_OPS];
+  };
+
+static struct worker workers[MAX_THREADS];
+static int n_workers;
+
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static int n_reports;
+
+
+static void
+print_words (char *label, short *w, int n)
+{
+  int i;
+
+  printf ("  %s", label);
+  for (i = 0; i < n; i++)
+    printf (" %04X", (ushort) w[i]);
+}
+
+/* Count a case, and report it if flt1750.c returned something else than
+   the reference. The results are only compared when the status is 0;
+   n_out is 0 for the compares, whose status is the result. */
+
+static void
+check (struct worker *w, enum op op, short *a, short *b, int n_in,
+       int stat, short *out, int ref_stat, short *ref_out, int n_out)
+{
+  int i, differ = (stat != ref_stat);
+
+  w->done[op]++;
+  if (! differ && stat == 0)
+    for (i = 0; i < n_out; i++)
+      if (out[i] != ref_out[i])
+	differ = TRUE;
+  if (! differ)
+    return;
+  w->errors[op]++;
+  pthread_mutex_lock (&report_lock);
+  if (n_reports++ < MAX_REPORTS)
+    {
+      printf ("%-4s", op_name[op]);
+      print_words ("op0", a, n_in);
+      if (b != NULL)
+	print_words ("op1", b, n_in);
+      printf ("  got %d", stat);
+      if (stat == 0)
+	print_words ("", out, n_out);
+      printf ("  want %d", ref_stat);
+      if (ref_stat == 0)
+	print_words ("", ref_out, n_out);
+      putchar ('\n');
+    }
+  pthread_mutex_unlock (&report_lock);
+}
+
+
+/* xorshift32, each thread with its own state */
+
+static ulong
+next_random (ulong *state)
+{
+  ulong x = *state;
+
+  x ^= (x << 13) & 0xFFFFFFFFUL;
+  x ^= x >> 17;
+  x ^= (x << 5) & 0xFFFFFFFFUL;
+  return *state = x;
+}
+
+#define RANDOM(n)  ((int) (next_random (&w->seed) % (ulong) (n)))
+#define WORD()     ((short) (next_random (&w->seed) & 0xFFFF))
+
+static ushort special[][3] =
+  {
+    { 0x0000, 0x00, 0x0000 },		/* zero */
+    { 0x4000, 0x00, 0x0000 },		/* 0.5 */
+    { 0x8000, 0x00, 0x0000 },		/* -1.0 */
+    { 0xC000, 0x00, 0x0000 },		/* -0.5, unnormalized */
+    { 0x7FFF, 0xFF, 0xFFFF },		/* largest mantissa */
+    { 0xBFFF, 0xFF, 0xFFFF },		/* just below -0.5 */
+    { 0xFFFF, 0xFF, 0xFFFF },		/* smallest negative */
+    { 0x0000, 0x00, 0x0001 },		/* smallest positive */
+    { 0x4000, 0x00, 0x0001 },
+    { 0x8000, 0x00, 0x0001 }
+  };
+
+#define N_SPECIAL  (sizeof (special) / sizeof (special[0]))
+
+/* A float operand in f[0..2], word 2 only being used by extended ones */
+
+static void
+random_float (struct worker *w, short *f)
+{
+  int e;
+
+  f[0] = WORD ();
+  f[1] = WORD ();
+  f[2] = WORD ();
+  switch (RANDOM (8))
+    {
+    case 0:
+    case 1:			/* anything, mostly unnormalized */
+      return;
+    case 2:
+    case 3:
+    case 4:
+    case 5:			/* normalized, moderate exponent */
+      f[0] = (f[0] & 0x8000) ? f[0] & ~0x4000 : f[0] | 0x4000;
+      e = RANDOM (41) - 20;
+      break;
+    case 6:			/* special mantissa, any exponent */
+      {
+	ushort *s = special[RANDOM (N_SPECIAL)];
+
+	f[0] = (short) s[0];
+	f[1] = (short) (s[1] << 8);
+	f[2] = (short) s[2];
+	e = RANDOM (256) - 128;
+      }
+      break;
+    default:			/* normalized, extreme exponent */
+      f[0] = (f[0] & 0x8000) ? f[0] & ~0x4000 : f[0] | 0x4000;
+      e = RANDOM (2) ? 127 - RANDOM (4) : -128 + RANDOM (4);
+    }
+  f[1] = (short) ((f[1] & 0xFF00) | (e & 0xFF));
+}
+
+/* A second operand: independent, equal, close to the first, or close
+   to its negation */
+
+static void
+random_pair (struct worker *w, short *a, short *b)
+{
+  int e;
+
+  random_float (w, a);
+  switch (RANDOM (4))
+    {
+    case 0:
+      random_float (w, b);
+      return;
+    case 1:
+      memcpy ((void *) b, (void *) a, 3 * sizeof (short));
+      return;
+    case 2:
+      memcpy ((void *) b, (void *) a, 3 * sizeof (short));
+      b[2] ^= (short) RANDOM (16);
+      b[1] ^= (short) (RANDOM (16) << 8);
+      break;
+    default:
+      b[0] = ~a[0];
+      b[1] = (short) (~a[1] & 0xFF00) | (a[1] & 0xFF);
+      b[2] = ~a[2];
+    }
+  e = exponent (a[1]) + RANDOM (5) - 2;
+  if (e >= -128 && e <= 127)
+    b[1] = (short) ((b[1] & 0xFF00) | (e & 0xFF));
+}
+
+/* An operand for FIX/EFIX, mostly near the integer range */
+
+static void
+random_fix (struct worker *w, short *f, int bits)
+{
+  random_float (w, f);
+  if (RANDOM (2))
+    f[1] = (short) ((f[1] & 0xFF00) | ((RANDOM (bits + 5) - 2) & 0xFF));
+}
+
+static long
+random_long (struct worker *w)
+{
+  long n = (long) ((ulong) WORD () << 16 | (ushort) WORD ());
+
+  switch (RANDOM (4))
+    {
+    case 0:
+      return (n & 0x80000000L) ? n | ~0x7FFFFFFFL : n & 0x7FFFFFFFL;
+    case 1:
+      return RANDOM (2001) - 1000;
+    case 2:
+      n = 1L << RANDOM (31);
+      return RANDOM (2) ? -n : n - RANDOM (2);
+    default:
+      return RANDOM (2) ? 0x7FFFFFFFL : -0x7FFFFFFFL - 1;
+    }
+}
+
+
+static void *
+worker_main (void *arg)
+{
+  struct worker *w = (struct worker *) arg;
+  struct value va, vb;
+  short a[3], b[3], out[3], ref[3], in[2];
+  long i, n;
+  int stat;
+
+  /* FLT on all 16 bit integers */
+  for (n = w->index; n < 0x10000L; n += n_workers)
+    {
+      in[0] = (short) (n - 0x8000L);
+      flt1750_flt (in[0], out);
+      load_int (&va, (long) in[0]);
+      check (w, FLT, in, NULL, 1, 0, out, to_float (&va, 24, ref), ref, 2);
+    }
+
+  for (i = 0; i < w->cases; i++)
+    {
+      random_pair (w, a, b);
+      load_flt (&va, a);
+      load_flt (&vb, b);
+      stat = flt1750_add (a, b, out);
+      check (w, FA, a, b, 2, stat, out, ref_add (va, vb, 0, 24, ref), ref, 2);
+      stat = flt1750_sub (a, b, out);
+      check (w, FS, a, b, 2, stat, out, ref_add (va, vb, 1, 24, ref), ref, 2);
+      stat = flt1750_mul (a, b, out);
+      check (w, FM, a, b, 2, stat, out, ref_mul (va, vb, 24, ref), ref, 2);
+      stat = flt1750_div (a, b, out);
+      check (w, FD, a, b, 2, stat, out, ref_div (va, vb, 24, ref), ref, 2);
+      check (w, FC, a, b, 2, flt1750_cmp (a, b), out, ref_cmp (va, vb),
+	     ref, 0);
+
+      random_pair (w, a, b);
+      load_eflt (&va, a);
+      load_eflt (&vb, b);
+      stat = flt1750_eadd (a, b, out);
+      check (w, EFA, a, b, 3, stat, out, ref_add (va, vb, 0, 40, ref), ref, 3);
+      stat = flt1750_esub (a, b, out);
+      check (w, EFS, a, b, 3, stat, out, ref_add (va, vb, 1, 40, ref), ref, 3);
+      stat = flt1750_emul (a, b, out);
+      check (w, EFM, a, b, 3, stat, out, ref_mul (va, vb, 40, ref), ref, 3);
+      stat = flt1750_ediv (a, b, out);
+      check (w, EFD, a, b, 3, stat, out, ref_div (va, vb, 40, ref), ref, 3);
+      check (w, EFC, a, b, 3, flt1750_ecmp (a, b), out, ref_cmp (va, vb),
+	     ref, 0);
+
+      random_fix (w, a, 16);
+      load_flt (&va, a);
+      stat = flt1750_fix (a, out);
+      check (w, FIX, a, NULL, 2, stat, out, ref_fix (va, 16, ref), ref, 1);
+
+      random_fix (w, a, 32);
+      load_eflt (&va, a);
+      stat = flt1750_efix (a, out);
+      check (w, EFIX, a, NULL, 3, stat, out, ref_fix (va, 32, ref), ref, 2);
+
+      n = random_long (w);
+      in[0] = (short) ((ulong) n >> 16);
+      in[1] = (short) (n & 0xFFFF);
+      flt1750_eflt (in, out);
+      load_int (&va, n);
+      check (w, EFLT, in, NULL, 2, 0, out, to_float (&va, 40, ref), ref, 3);
+    }
+  return NULL;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  long cases = (argc > 1) ? atol (argv[1]) : DEFAULT_CASES;
+  ulong done, errors = 0;
+  int i, op;
+
+  n_workers = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+  n_workers = (int) sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+  if (argc > 2)
+    n_workers = atoi (argv[2]);
+  if (n_workers < 1)
+    n_workers = 1;
+  if (n_workers > MAX_THREADS)
+    n_workers = MAX_THREADS;
+  if (cases < 0 || argc > 3)
+    {
+      fprintf (stderr, "usage: sim1750-fltcheck [<cases> [<threads>]]\n");
+      return (EXIT_FAILURE);
+    }
+
+  for (i = 0; i < n_workers; i++)
+    {
+      workers[i].index = i;
+      workers[i].cases = cases / n_workers + (i < cases % n_workers);
+      workers[i].seed = 0x9E3779B9UL ^ ((ulong) i * 0x85EBCA6BUL & 0xFFFFFFFFUL);
+      if (pthread_create (&workers[i].thread, NULL, worker_main,
+			  (void *) &workers[i]) != 0)
+	{
+	  fprintf (stderr, "sim1750-fltcheck: cannot create thread\n");
+	  return (EXIT_FAILURE);
+	}
+    }
+  for (i = 0; i < n_workers; i++)
+    pthread_join (workers[i].thread, NULL);
+
+  for (op = 0; op < N_OPS; op++)
+    {
+      ulong op_errors = 0;
+
+      for (done = 0, i = 0; i < n_workers; i++)
+	{
+	  done += workers[i].done[op];
+	  op_errors += workers[i].errors[op];
+	}
+      printf ("%-4s %10lu cases %8lu errors\n", op_name[op], done, op_errors);
+      errors += op_errors;
+    }
+  printf ("total %lu errors, %d threads\n", errors, n_workers);
+  return (errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
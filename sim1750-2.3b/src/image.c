@@ -0,0 +1,210 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : image.c -- binary machine images                            */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* image.c  --  binary machine images.
+
+   An image holds the complete state of the machine: registers, page
+   registers, timers and all allocated memory pages with their
+   was_written[] bitmaps. It is written in the host's own layout so
+   that loading it takes no parsing: the file is mapped into memory and
+   its pages are lent to the machine copy-on-write, just like the pages
+   of a snapshot (see machine.c). Images can therefore only be loaded by
+   a simulator built for the same host; the header records what it was
+   built with, and a mismatch is refused.
+
+   File layout: struct image_header, then n_pages times a mem_t. The
+   header size is a multiple of its alignment, which is at least that
+   of mem_t, so the pages can be used where they are mapped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "status.h"
+#include "utils.h"
+#include "arith.h"
+#include "cpu.h"
+#include "sched.h"
+#include "image.h"
+
+#define IMAGE_MAGIC       "sim1750 image 1"
+#define IMAGE_BYTE_ORDER  0x01020304L
+
+struct image_header
+  {
+    char   magic[16];		/* IMAGE_MAGIC, zero padded */
+    ulong  byte_order;		/* IMAGE_BYTE_ORDER */
+    ulong  header_size;		/* sizeof (struct image_header) */
+    ulong  page_size;		/* sizeof (mem_t) */
+    ulong  n_pages;		/* number of pages following the header */
+    short  page[N_PAGES];	/* index of each page in the file, or -1 */
+    struct regs   regs;
+    struct mmureg mmu[2][16][16];
+    ulong  instructions;	/* instcnt */
+    double time_in_us;		/* total_time_in_us */
+    ulong  cycles, cycles_synced;	/* sched_now, timers_synced */
+    ulong  tatick_in_ns;	/* timer prescalers (see cpu.c) */
+    ushort tbtick_in_tatix, gotick_in_10usec;
+    ushort bex_index;
+  };
+
+
+int
+save_image (char *filename)
+{
+  struct image_header h;
+  FILE *fp;
+  int i;
+
+  sync_timers ();
+  flush_cs ();
+  memset ((void *) &h, 0, sizeof (h));
+  strcpy (h.magic, IMAGE_MAGIC);
+  h.byte_order = IMAGE_BYTE_ORDER;
+  h.header_size = sizeof (h);
+  h.page_size = sizeof (mem_t);
+  for (i = 0; i < N_PAGES; i++)
+    h.page[i] = (mem[i] != MNULL) ? (short) h.n_pages++ : -1;
+  h.regs = simreg;
+  memcpy ((void *) h.mmu, (void *) pagereg, sizeof (h.mmu));
+  h.instructions = instcnt;
+  h.time_in_us = total_time_in_us;
+  h.cycles = sched_now;
+  h.cycles_synced = machine->timers_synced;
+  h.tatick_in_ns = machine->one_tatick_in_ns;
+  h.tbtick_in_tatix = machine->one_tbtick_in_tatix;
+  h.gotick_in_10usec = machine->one_gotick_in_10usec;
+  h.bex_index = machine->bex_index;
+
+  if ((fp = fopen (filename, "wb")) == (FILE *) 0)
+    return error ("cannot create image file '%s'", filename);
+  fwrite ((void *) &h, sizeof (h), 1, fp);
+  for (i = 0; i < N_PAGES; i++)
+    if (mem[i] != MNULL)
+      fwrite ((void *) mem[i], sizeof (mem_t), 1, fp);
+  if (ferror (fp) | fclose (fp))
+    return error ("error writing image file '%s'", filename);
+  return OKAY;
+}
+
+
+int
+load_image (char *filename)
+{
+  struct image_header *h;
+  char *base;
+  ulong size;
+  int i;
+
+  if ((base = map_file (filename, &size)) == (char *) 0)
+    return error ("cannot read image file '%s'", filename);
+  h = (struct image_header *) base;
+  if (size < sizeof (struct image_header)
+      || strncmp (h->magic, IMAGE_MAGIC, sizeof (h->magic)) != 0)
+    {
+      unmap_file (base, size);
+      return error ("'%s' is not an image file", filename);
+    }
+  if (h->byte_order != IMAGE_BYTE_ORDER
+      || h->header_size != sizeof (struct image_header)
+      || h->page_size != sizeof (mem_t))
+    {
+      unmap_file (base, size);
+      return error ("image file '%s' was saved on a different host", filename);
+    }
+  if (h->n_pages > N_PAGES
+      || size < h->header_size + h->n_pages * h->page_size)
+    {
+      unmap_file (base, size);
+      return error ("image file '%s' is truncated", filename);
+    }
+  for (i = 0; i < N_PAGES; i++)
+    if (h->page[i] >= (long) h->n_pages)
+      {
+	unmap_file (base, size);
+	return error ("image file '%s' is corrupt", filename);
+      }
+
+  /* Drop the current memory, which may have been lent by the
+     previous image, before letting go of that */
+  init_mem ();
+  image_release (machine);
+  machine->image = base;
+  machine->image_size = size;
+  for (i = 0; i < N_PAGES; i++)
+    if (h->page[i] >= 0)
+      {
+	mem[i] = (mem_t *) (base + h->header_size
+			    + (ulong) h->page[i] * h->page_size);
+	cow_page[i] = 1;
+      }
+
+  simreg = h->regs;
+  machine->cs_lazy = FALSE;
+  memcpy ((void *) pagereg, (void *) h->mmu, sizeof (h->mmu));
+  mmu_changed ();
+  instcnt = h->instructions;
+  total_time_in_us = h->time_in_us;
+  sched_now = h->cycles;
+  machine->timers_synced = h->cycles_synced;
+  machine->one_tatick_in_ns = h->tatick_in_ns;
+  machine->one_tbtick_in_tatix = h->tbtick_in_tatix;
+  machine->one_gotick_in_10usec = h->gotick_in_10usec;
+  machine->bex_index = h->bex_index;
+  timers_changed ();
+  return OKAY;
+}
+
+
+/* Unmap the image of machine `m'. None of its pages may be in use. */
+
+void
+image_release (struct machine *m)
+{
+  if (m->image == (char *) 0)
+    return;
+  unmap_file (m->image, m->image_size);
+  m->image = (char *) 0;
+  m->image_size = 0;
+}
+
+
+int
+si_imsave (int argc, char *argv[])
+{
+  if (argc <= 1)
+    return error ("filename missing");
+  return save_image (argv[1]);
+}
+
+
+int
+si_imload (int argc, char *argv[])
+{
+  if (argc <= 1)
+    return error ("filename missing");
+  return load_image (argv[1]);
+}
@@ -0,0 +1,14 @@
+/* image.h -- exports of image.c */
+
+#ifndef _IMAGE_H
+#define _IMAGE_H
+
+#include "machine.h"
+
+extern int  save_image (char *filename);
+extern int  load_image (char *filename);
+extern void image_release (struct machine *m);
+extern int  si_imsave (int argc, char *argv[]);
+extern int  si_imload (int argc, char *argv[]);
+
+#endif
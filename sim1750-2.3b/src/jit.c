@@ -0,0 +1,683 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component :         jit.c -- x86-64 translation of hot basic blocks     */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* Dynamic translation of basic blocks (see execute_block() in cpu.c)
+   into x86-64 machine code.
+   The translated code works directly on the simulator's struct regs.
+   A small set of frequent register-to-register instructions and the
+   relative branches are expanded inline; they reproduce the handlers in
+   cpu.c exactly, including the condition status in SW and the cycle
+   counts from stime.h. Every other instruction is executed by calling
+   back into the cpu.c handler through the call-out function.
+   Inline arithmetic falls back to the handler when it overflows, so that
+   the PIR bits and messages always come from arith().
+   After each call-out, the code returns to the caller if the handler
+   failed, if it changed the PIR, or if it wrote into code that has been
+   translated (signalled through the `stale' flag).
+
+   Register usage of the generated code:
+	r15	pointer to struct regs
+	rbx	cycle count
+	r13	instruction count
+	r12	pointer to the result array
+	r14w	PIR at entry
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdarg.h>
+
+#include "arch.h"
+#include "status.h"
+#include "stime.h"
+#include "jit.h"
+
+#if defined (__x86_64__) && defined (__GNUC__) && defined (__unix__)
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define JIT_BUF_SIZE  (4L * 1024L * 1024L)
+#define JIT_OP_MAX    256   /* upper bound of code bytes per instruction */
+
+/* The cycles of conditional branches and SOJ depend on the way taken
+   only on the PACE and the F9450; nc_BRcc and nc_SOJ then read
+   branch_taken and jump_taken (see stime.h). */
+#if defined (PACE) || defined (F9450)
+#define TIMING_BY_DIRECTION
+#endif
+
+bool jit_available = TRUE;   /* cleared if no executable memory */
+
+static THREAD_LOCAL uchar *jit_buf;
+static THREAD_LOCAL ulong  jit_used;
+
+/* Displacements of the register file members from r15 */
+#define R_OFF(n)  ((int) (offsetof (struct regs, r) + 2 * (n)))
+#define PIR_OFF   ((int) offsetof (struct regs, pir))
+#define IC_OFF    ((int) offsetof (struct regs, ic))
+#define SW_OFF    ((int) offsetof (struct regs, sw))
+
+/* x86 condition codes */
+#define CC_O      0x0
+#define CC_Z      0x4
+#define CC_NZ     0x5
+#define CC_S      0x8
+#define JMP       (-1)
+
+static THREAD_LOCAL uchar *pc;		/* code emission pointer */
+static THREAD_LOCAL uchar *exit_ok;	/* return OKAY */
+static THREAD_LOCAL uchar *exit_ret;	/* return status in eax */
+static THREAD_LOCAL bool   closed;	/* block ended with an inline branch */
+static THREAD_LOCAL int  (*call_out) (void *);
+static THREAD_LOCAL bool  *stale;
+
+/* IC increments, cycles and instruction count of the inline
+   instructions not yet added to the registers */
+static THREAD_LOCAL long pend_ic, pend_cycles, pend_ops;
+
+
+/******************************* Emitters **********************************/
+
+static void
+emit (int n, ...)
+{
+  va_list bytes;
+
+  va_start (bytes, n);
+  while (n-- > 0)
+    *pc++ = (uchar) va_arg (bytes, int);
+  va_end (bytes);
+}
+
+static void
+emit16 (ulong value)
+{
+  emit (2, (int) (value & 0xFF), (int) ((value >> 8) & 0xFF));
+}
+
+static void
+emit32 (ulong value)
+{
+  emit16 (value & 0xFFFF);
+  emit16 ((value >> 16) & 0xFFFF);
+}
+
+static void
+emit64 (ulong value)
+{
+  emit32 (value & 0xFFFFFFFFL);
+  emit32 (value >> 32);
+}
+
+/* Jump to a known location; cc is a condition code or JMP */
+static void
+jump (int cc, uchar *target)
+{
+  if (cc == JMP)
+    emit (1, 0xE9);
+  else
+    emit (2, 0x0F, 0x80 | cc);
+  emit32 ((ulong) (target - (pc + 4)));
+}
+
+/* Forward jumps: return the displacement to be filled in by land8/32 */
+static uchar *
+jump8 (int cc)
+{
+  emit (2, cc == JMP ? 0xEB : 0x70 | cc, 0);
+  return pc - 1;
+}
+
+static void
+land8 (uchar *displacement)
+{
+  *displacement = (uchar) (pc - (displacement + 1));
+}
+
+static uchar *
+jump32 (int cc)
+{
+  jump (cc, pc);
+  return pc - 4;
+}
+
+static void
+land32 (uchar *displacement)
+{
+  uchar *save = pc;
+  ulong rel = (ulong) (save - (displacement + 4));
+
+  pc = displacement;
+  emit32 (rel);
+  pc = save;
+}
+
+/* movzx eax/ecx, word [r15+offset] and mov word [r15+offset], ax/cx */
+
+static void
+load_ax (int offset)
+{
+  emit (5, 0x41, 0x0F, 0xB7, 0x47, offset);
+}
+
+static void
+load_cx (int offset)
+{
+  emit (5, 0x41, 0x0F, 0xB7, 0x4F, offset);
+}
+
+static void
+store_ax (int offset)
+{
+  emit (5, 0x66, 0x41, 0x89, 0x47, offset);
+}
+
+static void
+store_cx (int offset)
+{
+  emit (5, 0x66, 0x41, 0x89, 0x4F, offset);
+}
+
+static void
+store_imm (int offset, ushort value)
+{
+  emit (5, 0x66, 0x41, 0xC7, 0x47, offset);
+  emit16 (value);
+}
+
+static void
+flush_pending (void)
+{
+  short ic_delta = (short) (pend_ic & 0xFFFF);
+
+  if (ic_delta >= -128 && ic_delta <= 127 && ic_delta != 0)
+    emit (6, 0x66, 0x41, 0x83, 0x47, IC_OFF, ic_delta & 0xFF);
+  else if (ic_delta != 0)
+    {
+      emit (5, 0x66, 0x41, 0x81, 0x47, IC_OFF);
+      emit16 ((ulong) (ushort) ic_delta);
+    }
+  if (pend_cycles != 0)
+    {
+      emit (3, 0x48, 0x81, 0xC3);	/* add rbx, imm32 */
+      emit32 ((ulong) pend_cycles);
+    }
+  if (pend_ops == 1)
+    emit (3, 0x49, 0xFF, 0xC5);		/* inc r13 */
+  else if (pend_ops != 0)
+    {
+      emit (3, 0x49, 0x81, 0xC5);	/* add r13, imm32 */
+      emit32 ((ulong) pend_ops);
+    }
+  pend_ic = pend_cycles = pend_ops = 0L;
+}
+
+static void
+pending (int ic_delta, int cycles)
+{
+  pend_ic += ic_delta;
+  pend_cycles += cycles;
+  pend_ops++;
+}
+
+/* The equivalent of update_cs (VAR_INT) on the value in ax.
+   With `carry' set, the carry bit is taken from dl instead of being
+   preserved, as done by arith(). */
+
+static void
+update_cs (bool carry)
+{
+  uchar *zero, *negative, *done1, *done2;
+
+  load_cx (SW_OFF);
+  emit (2, 0x81, 0xE1);			/* and ecx, imm32 */
+  emit32 (carry ? 0x0FFFL : 0x8FFFL);
+  if (carry)
+    emit (8, 0x0F, 0xB6, 0xD2,		/* movzx edx, dl */
+	     0xC1, 0xE2, 0x0F,		/* shl edx, 15 */
+	     0x09, 0xD1);		/* or ecx, edx */
+  emit (3, 0x66, 0x85, 0xC0);		/* test ax, ax */
+  zero = jump8 (CC_Z);
+  negative = jump8 (CC_S);
+  emit (2, 0x81, 0xC9);			/* or ecx, imm32 */
+  emit32 (CS_POSITIVE);
+  done1 = jump8 (JMP);
+  land8 (zero);
+  emit (2, 0x81, 0xC9);
+  emit32 (CS_ZERO);
+  done2 = jump8 (JMP);
+  land8 (negative);
+  emit (2, 0x81, 0xC9);
+  emit32 (CS_NEGATIVE);
+  land8 (done1);
+  land8 (done2);
+  store_cx (SW_OFF);
+}
+
+/* Condition status of a constant VAR_INT result */
+static void
+constant_cs (ushort value)
+{
+  ushort cs = (value == 0) ? CS_ZERO
+	    : (value & 0x8000) ? CS_NEGATIVE : CS_POSITIVE;
+
+  emit (5, 0x66, 0x41, 0x81, 0x67, SW_OFF);	/* and word [sw], imm16 */
+  emit16 (0x8FFFL);
+  emit (5, 0x66, 0x41, 0x81, 0x4F, SW_OFF);	/* or word [sw], imm16 */
+  emit16 ((ulong) cs);
+}
+
+
+/************************* Instruction translation *************************/
+
+/* Call the cpu.c handler for the instruction */
+static void
+translate_call (struct jit_op *op)
+{
+  flush_pending ();
+  emit (2, 0x48, 0xBF);			/* mov rdi, entry */
+  emit64 ((ulong) op->entry);
+  emit (2, 0x48, 0xB8);			/* mov rax, call_out */
+  emit64 ((ulong) call_out);
+  emit (2, 0xFF, 0xD0);			/* call rax */
+  emit (2, 0x85, 0xC0);			/* test eax, eax */
+  jump (CC_S, exit_ret);		/* BREAKPT or MEMERR */
+  emit (5, 0x89, 0xC0,			/* mov eax, eax */
+	   0x48, 0x01, 0xC3);		/* add rbx, rax */
+  emit (3, 0x49, 0xFF, 0xC5);		/* inc r13 */
+  emit (5, 0x66, 0x45, 0x39, 0x77, PIR_OFF);	/* cmp [pir], r14w */
+  jump (CC_NZ, exit_ok);
+  emit (2, 0x48, 0xB8);			/* mov rax, stale */
+  emit64 ((ulong) stale);
+  emit (3, 0x80, 0x38, 0x00);		/* cmp byte [rax], 0 */
+  jump (CC_NZ, exit_ok);
+}
+
+/* AR, SR, AISP, SISP: add or subtract a register (reg >= 0) or constant
+   to ax. On overflow the handler is called instead. */
+static void
+translate_arith (struct jit_op *op, bool subtract, int reg, ushort constant,
+		 int cycles)
+{
+  int upper = (op->opcode >> 4) & 0xF;
+  long save_ic = pend_ic, save_cycles = pend_cycles, save_ops = pend_ops;
+  uchar *slow, *join;
+
+  load_ax (R_OFF (upper));
+  if (reg >= 0)
+    emit (5, 0x66, 0x41, subtract ? 0x2B : 0x03, 0x47, R_OFF (reg));
+  else
+    {
+      emit (2, 0x66, subtract ? 0x2D : 0x05);
+      emit16 ((ulong) constant);
+    }
+  slow = jump32 (CC_O);
+  emit (3, 0x0F, 0x92, 0xC2);		/* setc dl */
+  store_ax (R_OFF (upper));
+  update_cs (TRUE);
+  pending (1, cycles);
+  flush_pending ();
+  join = jump32 (JMP);
+
+  land32 (slow);
+  pend_ic = save_ic;
+  pend_cycles = save_cycles;
+  pend_ops = save_ops;
+  translate_call (op);
+  land32 (join);
+}
+
+/* Relative branches, which always end a block. `mask' selects the
+   condition status bits tested; the branch is taken if any of them is
+   set, or, with `if_clear', if none is. A mask of 0 means BR. */
+static void
+translate_branch (struct jit_op *op, ushort mask, bool if_clear)
+{
+  int distance = op->opcode & 0xFF;
+  long save_ic = pend_ic, save_cycles = pend_cycles, save_ops = pend_ops;
+#ifdef TIMING_BY_DIRECTION
+  bool branch_taken;
+#endif
+  uchar *not_taken;
+
+  if (distance >= 0x80)
+    distance -= 0x100;
+  if (mask == 0)
+    {
+      pending (distance, nc_BR);
+      flush_pending ();
+      jump (JMP, exit_ok);
+      closed = TRUE;
+      return;
+    }
+  emit (5, 0x66, 0x41, 0xF7, 0x47, SW_OFF);	/* test word [sw], imm16 */
+  emit16 ((ulong) mask);
+  not_taken = jump8 (if_clear ? CC_NZ : CC_Z);
+#ifdef TIMING_BY_DIRECTION
+  branch_taken = TRUE;
+#endif
+  pending (distance, nc_BRcc);
+  flush_pending ();
+  jump (JMP, exit_ok);
+  land8 (not_taken);
+  pend_ic = save_ic;
+  pend_cycles = save_cycles;
+  pend_ops = save_ops;
+#ifdef TIMING_BY_DIRECTION
+  branch_taken = FALSE;
+#endif
+  pending (1, nc_BRcc);
+  flush_pending ();
+  jump (JMP, exit_ok);
+  closed = TRUE;
+}
+
+/* SOJ, which always ends a block */
+static void
+translate_soj (struct jit_op *op)
+{
+  int upper = (op->opcode >> 4) & 0xF, lower = op->opcode & 0xF;
+  long save_ic = pend_ic, save_cycles = pend_cycles, save_ops = pend_ops;
+#ifdef TIMING_BY_DIRECTION
+  int jump_taken;
+#endif
+  uchar *slow, *end_of_loop;
+
+  load_ax (R_OFF (upper));
+  emit (4, 0x66, 0x2D, 0x01, 0x00);	/* sub ax, 1 */
+  slow = jump32 (CC_O);
+  emit (3, 0x0F, 0x92, 0xC2);		/* setc dl */
+  store_ax (R_OFF (upper));
+  update_cs (TRUE);
+  emit (3, 0x66, 0x85, 0xC0);		/* test ax, ax */
+  end_of_loop = jump8 (CC_Z);
+  if (lower == 0)
+    store_imm (IC_OFF, op->immed);
+  else
+    {
+      emit (1, 0xB8);			/* mov eax, imm32 */
+      emit32 ((ulong) op->immed);
+      emit (5, 0x66, 0x41, 0x03, 0x47, R_OFF (lower));  /* add ax, rx */
+      store_ax (IC_OFF);
+    }
+#ifdef TIMING_BY_DIRECTION
+  jump_taken = 1;
+#endif
+  pend_ic = 0L;
+  pending (0, nc_SOJ);
+  flush_pending ();
+  jump (JMP, exit_ok);
+  land8 (end_of_loop);
+  pend_ic = save_ic;
+  pend_cycles = save_cycles;
+  pend_ops = save_ops;
+#ifdef TIMING_BY_DIRECTION
+  jump_taken = 0;
+#endif
+  pending (2, nc_SOJ);
+  flush_pending ();
+  jump (JMP, exit_ok);
+
+  land32 (slow);
+  pend_ic = save_ic;
+  pend_cycles = save_cycles;
+  pend_ops = save_ops;
+  translate_call (op);
+  jump (JMP, exit_ok);
+  closed = TRUE;
+}
+
+/* Translate the instruction inline if possible. Returns FALSE if the
+   handler has to be called. */
+static bool
+translate_inline (struct jit_op *op, bool last)
+{
+  int upper = (op->opcode >> 4) & 0xF, lower = op->opcode & 0xF;
+  ushort value;
+
+  switch (op->opcode >> 8)
+    {
+    case 0x81:			/* LR */
+      load_ax (R_OFF (lower));
+      store_ax (R_OFF (upper));
+      update_cs (FALSE);
+      pending (1, nc_LR);
+      break;
+    case 0x82:			/* LISP */
+    case 0x83:			/* LISN */
+      value = (op->opcode >> 8) == 0x82 ? lower + 1 : -(lower + 1);
+      store_imm (R_OFF (upper), value);
+      constant_cs (value);
+      pending (1, (op->opcode >> 8) == 0x82 ? nc_LISP : nc_LISN);
+      break;
+    case 0x85:			/* LIM */
+      if (! op->has_immed)
+	return FALSE;
+      if (lower == 0)
+	{
+	  store_imm (R_OFF (upper), op->immed);
+	  constant_cs (op->immed);
+	}
+      else
+	{
+	  emit (1, 0xB8);		/* mov eax, imm32 */
+	  emit32 ((ulong) op->immed);
+	  emit (5, 0x66, 0x41, 0x03, 0x47, R_OFF (lower));  /* add ax, rx */
+	  store_ax (R_OFF (upper));
+	  update_cs (FALSE);
+	}
+      pending (2, nc_LIM);
+      break;
+    case 0xE1:			/* ORR */
+    case 0xE3:			/* ANDR */
+    case 0xE5:			/* XORR */
+    case 0xE7:			/* NR */
+      load_ax (R_OFF (upper));
+      load_cx (R_OFF (lower));
+      switch (op->opcode >> 8)
+	{
+	case 0xE1:
+	  emit (3, 0x66, 0x09, 0xC8);
+	  pending (1, nc_ORR);
+	  elsecase 0xE3:
+	  emit (3, 0x66, 0x21, 0xC8);
+	  pending (1, nc_ANDR);
+	  elsecase 0xE5:
+	  emit (3, 0x66, 0x31, 0xC8);
+	  pending (1, nc_XORR);
+	  elsecase 0xE7:
+	  emit (6, 0x66, 0x21, 0xC8, 0x66, 0xF7, 0xD0);	/* and; not */
+	  pending (1, nc_NR);
+	}
+      store_ax (R_OFF (upper));
+      update_cs (FALSE);
+      break;
+    case 0xA1:			/* AR */
+      translate_arith (op, FALSE, lower, 0, nc_AR);
+      break;
+    case 0xA2:			/* AISP */
+      translate_arith (op, FALSE, -1, lower + 1, nc_AISP);
+      break;
+    case 0xB1:			/* SR */
+      translate_arith (op, TRUE, lower, 0, nc_SR);
+      break;
+    case 0xB2:			/* SISP */
+      translate_arith (op, TRUE, -1, lower + 1, nc_SISP);
+      break;
+    case 0x73:			/* SOJ */
+      if (! last || ! op->has_immed)
+	return FALSE;
+      translate_soj (op);
+      break;
+    case 0x74:			/* BR */
+    case 0x75:			/* BEZ */
+    case 0x76:			/* BLT */
+    case 0x78:			/* BLE */
+    case 0x79:			/* BGT */
+    case 0x7A:			/* BNZ */
+    case 0x7B:			/* BGE */
+      if (! last)
+	return FALSE;
+      switch (op->opcode >> 8)
+	{
+	case 0x74:
+	  translate_branch (op, 0, FALSE);
+	  elsecase 0x75:
+	  translate_branch (op, CS_ZERO, FALSE);
+	  elsecase 0x76:
+	  translate_branch (op, CS_NEGATIVE, FALSE);
+	  elsecase 0x78:
+	  translate_branch (op, CS_ZERO | CS_NEGATIVE, FALSE);
+	  elsecase 0x79:
+	  translate_branch (op, CS_POSITIVE, FALSE);
+	  elsecase 0x7A:
+	  translate_branch (op, CS_ZERO, TRUE);
+	  elsecase 0x7B:
+	  translate_branch (op, CS_ZERO | CS_POSITIVE, FALSE);
+	}
+      break;
+    default:
+      return FALSE;
+    }
+  return TRUE;
+}
+
+
+/****************************** Entry points *******************************/
+
+static bool
+jit_init (void)
+{
+  void *area;
+#ifdef MAP_ANONYMOUS
+  area = mmap ((void *) 0, JIT_BUF_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+	       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#else
+  int fd = open ("/dev/zero", O_RDWR);
+
+  area = MAP_FAILED;
+  if (fd >= 0)
+    {
+      area = mmap ((void *) 0, JIT_BUF_SIZE,
+		   PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE, fd, 0);
+      close (fd);
+    }
+#endif
+  if (area == MAP_FAILED)
+    {
+      warning ("no executable memory for the JIT, translation disabled");
+      jit_available = FALSE;
+      return FALSE;
+    }
+  jit_buf = (uchar *) area;
+  jit_used = 0L;
+  return TRUE;
+}
+
+/* Translate a basic block. Returns NULL if the code buffer is full (in
+   which case *full is set and the caller should jit_flush() all
+   translations), or if translation is not available. */
+
+jit_code
+jit_translate (struct jit_op *ops, int n_ops,
+	       int (*call_out_fn) (void *), bool *stale_flag, bool *full)
+{
+  uchar *entry;
+  int i;
+
+  *full = FALSE;
+  if (! jit_available || (jit_buf == (uchar *) 0 && ! jit_init ()))
+    return (jit_code) 0;
+  if (jit_used + (ulong) n_ops * JIT_OP_MAX + 64L > JIT_BUF_SIZE)
+    {
+      *full = TRUE;
+      return (jit_code) 0;
+    }
+  call_out = call_out_fn;
+  stale = stale_flag;
+  pc = jit_buf + jit_used;
+
+  /* The exits precede the entry point so that all jumps to them
+     go backwards. */
+  exit_ok = pc;
+  emit (2, 0x31, 0xC0);			/* xor eax, eax */
+  exit_ret = pc;
+  emit (9, 0x49, 0x89, 0x1C, 0x24,	/* mov [r12], rbx */
+	   0x4D, 0x89, 0x6C, 0x24, 0x08);	/* mov [r12+8], r13 */
+  emit (10, 0x41, 0x5F, 0x41, 0x5E,	/* pop r15; pop r14 */
+	    0x41, 0x5D, 0x41, 0x5C,	/* pop r13; pop r12 */
+	    0x5B, 0xC3);		/* pop rbx; ret */
+
+  entry = pc;
+  emit (9, 0x53, 0x41, 0x54, 0x41, 0x55,	/* push rbx, r12, r13 */
+	   0x41, 0x56, 0x41, 0x57);		/* push r14, r15 */
+  emit (6, 0x49, 0x89, 0xFF,		/* mov r15, rdi */
+	   0x49, 0x89, 0xF4);		/* mov r12, rsi */
+  emit (5, 0x31, 0xDB,			/* xor ebx, ebx */
+	   0x45, 0x31, 0xED);		/* xor r13d, r13d */
+  emit (5, 0x45, 0x0F, 0xB7, 0x77, PIR_OFF);	/* movzx r14d, [pir] */
+
+  pend_ic = pend_cycles = pend_ops = 0L;
+  closed = FALSE;
+  for (i = 0; i < n_ops; i++)
+    if (! translate_inline (&ops[i], i == n_ops - 1))
+      translate_call (&ops[i]);
+  if (! closed)
+    {
+      flush_pending ();
+      jump (JMP, exit_ok);
+    }
+
+  jit_used = ((ulong) (pc - jit_buf) + 15L) & ~15L;
+  return (jit_code) entry;
+}
+
+/* Discard all translations */
+void
+jit_flush (void)
+{
+  jit_used = 0L;
+}
+
+#else  /* no code generator for this host */
+
+bool jit_available = FALSE;
+
+jit_code
+jit_translate (struct jit_op *ops, int n_ops,
+	       int (*call_out_fn) (void *), bool *stale_flag, bool *full)
+{
+  *full = FALSE;
+  return (jit_code) 0;
+}
+
+void
+jit_flush (void)
+{
+}
+
+#endif
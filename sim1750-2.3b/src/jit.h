@@ -0,0 +1,31 @@
+/* jit.h -- exports of jit.c */
+
+#ifndef _JIT_H
+#define _JIT_H
+
+#include "arch.h"
+
+/* One instruction of a basic block as handed to jit_translate().
+   `entry' is passed back to the call-out function for instructions
+   which are not translated inline. */
+
+struct jit_op
+  {
+    ushort opcode;
+    ushort immed;	/* word at IC+1, if has_immed */
+    bool   has_immed;
+    void  *entry;
+  };
+
+/* Translated code: returns OKAY or the negative status of the handler
+   that failed. result[0] receives the number of cycles, result[1] the
+   number of instructions executed. */
+typedef int (*jit_code) (struct regs *regs, long *result);
+
+extern bool     jit_available;
+extern jit_code jit_translate (struct jit_op *ops, int n_ops,
+			       int (*call_out) (void *entry),
+			       bool *stale, bool *full);
+extern void     jit_flush (void);
+
+#endif
@@ -25,16 +25,17 @@
 #include <time.h>
 #include <ctype.h>
 
-#include "peekpoke.h"
+#include "phys_mem.h"
 #include "loadfile.h"
 #include "arch.h"
 #include "status.h"
 #include "utils.h"
+#include "symtab.h"
 
 
-static int optf = 0;   /* print file header */
-static int opts = 1;   /* print section headers */
-static int optz = 0;   /* print strings */
+static THREAD_LOCAL int optf = 0;   /* print file header */
+static THREAD_LOCAL int opts = 1;   /* print section headers */
+static THREAD_LOCAL int optz = 0;   /* print strings */
 
 
 /*
@@ -51,7 +52,8 @@ struct filehdr {
   byte f_nsyms [4];    /* number of symtab entries */
   byte f_opthdr [2];   /* sizeof (optional hdr)    */
   byte f_flags [2];    /* flags                    */
-} file_header;
+};
+static THREAD_LOCAL struct filehdr file_header;
 
 #define FILHDR struct filehdr
 #define FILHSZ sizeof (FILHDR)
@@ -108,7 +110,7 @@ typedef struct
   byte text_start [4];   /* base of text used for this file       */
   byte data_start [4];   /* base of data used for this file       */
 } AOUTHDR;
-AOUTHDR aout_header;
+THREAD_LOCAL AOUTHDR aout_header;
 
 #define AOUTSZ 28
 #define AOUTHDRSZ 28
@@ -128,7 +130,8 @@ struct scnhdr {
   byte s_nreloc [2];  /* number of relocation entries     */
   byte s_nlnno [2];   /* number of line number entries    */
   byte s_flags [4];   /* flags                            */
-} sec_header;
+};
+static THREAD_LOCAL struct scnhdr sec_header;
 
 /*
  * names of "special" sections
@@ -153,7 +156,7 @@ struct reloc {
 #ifdef M1750_COFF_OFFSET
   byte r_offset[4];
 #endif
-} re;
+};
 
 #define RELOC struct reloc
 #define RELSZ (sizeof (RELOC))
@@ -220,6 +223,9 @@ struct reloc {
 #define C_FIELD         18      /* bit field                    */
 #define C_AUTOARG       19      /* auto argument                */
 #define C_LASTENT       20      /* dummy entry (end of block)   */
+#define C_BLOCK         100     /* ".bb" or ".eb"               */
+#define C_FCN           101     /* ".bf" or ".ef"               */
+#define C_FILE          103     /* file name                    */
 
 /*
  * Symbol table entries 
@@ -242,7 +248,8 @@ struct syment
   byte e_type [2];
   byte e_sclass [1];
   byte e_numaux [1];
-} se;
+};
+static THREAD_LOCAL struct syment se;
 
 struct internal_syment 
 {
@@ -256,7 +263,8 @@ struct internal_syment
   unsigned short e_type;
   char e_sclass;
   char e_numaux;
-} *syms = NULL;
+};
+static THREAD_LOCAL struct internal_syment *syms = NULL;
 
 
 #define N_BTMASK  (017)
@@ -305,67 +313,80 @@ union auxent {
     byte x_tvlen[2];     /* length of .tv */
     byte x_tvran[2][2];  /* tv range */
   } x_tv;         /* info about .tv section (in auxent of symbol .tv)) */
-} ae;
+};
 
 #define SYMENT struct syment
 #define SYMESZ 18      
 #define AUXENT union auxent
 #define AUXESZ 18
 
+/* The auxiliary entries of the symbol table, raw, at the same index as
+   in the file. Only a few fields are used, at these offsets: */
+#define X_FNAME    0    /* file name of C_FILE, or 0 and string offset */
+#define X_LNNO     4    /* line number of .bf (2 bytes) */
+
+static THREAD_LOCAL byte (*aux_ent) [AUXESZ] = NULL;
+
+/* Line number entries */
+#define LINESZ 6        /* l_symndx or l_paddr [4], l_lnno [2] */
+
+static THREAD_LOCAL struct source_line *lines = NULL;
+static THREAD_LOCAL long n_lines = 0, n_lines_allocated = 0;
+
 
 /* Contents of file header
  */
-static ushort f_magic; 
-static ushort f_nscns;
-static long f_timdat;          
-static long f_symptr;        
-static long f_nsyms;       
-static ushort f_opthdr;  
-static ushort f_flags; 
+static THREAD_LOCAL ushort f_magic; 
+static THREAD_LOCAL ushort f_nscns;
+static THREAD_LOCAL long f_timdat;          
+static THREAD_LOCAL long f_symptr;        
+static THREAD_LOCAL long f_nsyms;       
+static THREAD_LOCAL ushort f_opthdr;  
+static THREAD_LOCAL ushort f_flags; 
 
 /* Contents of the optional header
  */
-static short magic;
-static short vstamp;
-static long tsize;
-static long dsize;
-static long bsize;
-static long entry;
-static long text_start;
-static long data_start;
+static THREAD_LOCAL short magic;
+static THREAD_LOCAL short vstamp;
+static THREAD_LOCAL long tsize;
+static THREAD_LOCAL long dsize;
+static THREAD_LOCAL long bsize;
+static THREAD_LOCAL long entry;
+static THREAD_LOCAL long text_start;
+static THREAD_LOCAL long data_start;
 
 /* The string table
 */
-static char *str_tab = NULL;
-static int str_length = 0;
+static THREAD_LOCAL char *str_tab = NULL;
+static THREAD_LOCAL int str_length = 0;
 
 /* Contents of most recent section header
  */
-static char   s_name [9];
-static ulong  s_paddr;
-static ulong  s_vaddr;
-static ulong  s_size; 
-static ulong  s_scnptr;
-static ulong  s_relptr;
-static ulong  s_lnnoptr;
-static ushort s_nreloc;
-static ushort s_nlnno; 
-static ulong  s_flags;
+static THREAD_LOCAL char   s_name [9];
+static THREAD_LOCAL ulong  s_paddr;
+static THREAD_LOCAL ulong  s_vaddr;
+static THREAD_LOCAL ulong  s_size; 
+static THREAD_LOCAL ulong  s_scnptr;
+static THREAD_LOCAL ulong  s_relptr;
+static THREAD_LOCAL ulong  s_lnnoptr;
+static THREAD_LOCAL ushort s_nreloc;
+static THREAD_LOCAL ushort s_nlnno; 
+static THREAD_LOCAL ulong  s_flags;
 
 /* Contents of most recent reloc record
  */
-static ulong r_vaddr;
-static ulong r_symndx;
-static ushort r_type;
+static THREAD_LOCAL ulong r_vaddr;
+static THREAD_LOCAL ulong r_symndx;
+static THREAD_LOCAL ushort r_type;
 #ifdef M1750_COFF_OFFSET
-static ulong r_offset;
+static THREAD_LOCAL ulong r_offset;
 #endif
 
 /* Contents of the most recent line number record
 */
-static ulong l_symndx; 
-static ulong l_paddr; 
-static ushort l_lnno; 
+static THREAD_LOCAL ulong l_symndx; 
+static THREAD_LOCAL ulong l_paddr; 
+static THREAD_LOCAL ushort l_lnno; 
 
 
 static void 
@@ -400,47 +421,47 @@ get_file_header ()
 static void 
 dump_file_header ()
 {
-  printf ("----File-Header---------------------------------------------\n");
-  printf ("Magic number (in octal)  = 0%o\n",    f_magic);
-  printf ("Number of sections       = %d\n",     f_nscns);
-  printf ("Time & date stamp        = %s", ctime ((unsigned long *)&f_timdat));
-  printf ("File pointer to symtab   = 0x%08lX\n", f_symptr);
-  printf ("Number of symtab entries = %ld\n",     f_nsyms);
-  printf ("Sizeof (optional hdr)    = %d\n",     f_opthdr);
-  printf ("Flags                    = 0x%04X\n", f_flags);
+  lprintf ("----File-Header---------------------------------------------\n");
+  lprintf ("Magic number (in octal)  = 0%o\n",    f_magic);
+  lprintf ("Number of sections       = %d\n",     f_nscns);
+  lprintf ("Time & date stamp        = %s", ctime ((unsigned long *)&f_timdat));
+  lprintf ("File pointer to symtab   = 0x%08lX\n", f_symptr);
+  lprintf ("Number of symtab entries = %ld\n",     f_nsyms);
+  lprintf ("Sizeof (optional hdr)    = %d\n",     f_opthdr);
+  lprintf ("Flags                    = 0x%04X\n", f_flags);
 
   if (f_flags) 
     {
-      printf ("Known flags: ");
+      lprintf ("Known flags: ");
       if (f_flags & F_M1750B1)
-        printf ("M1750B1 ");
+        lprintf ("M1750B1 ");
       if (f_flags & F_M1750B2)
-        printf ("M1750B2 ");
+        lprintf ("M1750B2 ");
       if (f_flags & F_M1750B3)
-        printf ("M1750B3 ");
+        lprintf ("M1750B3 ");
       if (f_flags & F_M1750MMU)
-        printf ("M1750MMU ");
+        lprintf ("M1750MMU ");
       if (f_flags & F_RELFLG)
-        printf ("RELFLG ");
+        lprintf ("RELFLG ");
       if (f_flags & F_EXEC)   
-        printf ("EXEC ");
+        lprintf ("EXEC ");
       if (f_flags & F_LNNO)  
-        printf ("LNNO ");
+        lprintf ("LNNO ");
       if (f_flags & F_LSYMS)
-        printf ("LSYMS ");
+        lprintf ("LSYMS ");
       if (f_flags & F_AR16WR) 
-        printf ("AR16W ");
+        lprintf ("AR16W ");
       if (f_flags & F_AR32WR)
-        printf ("AR16WR ");
+        lprintf ("AR16WR ");
       if (f_flags & F_AR32W)     
-        printf ("AR32W ");
+        lprintf ("AR32W ");
       if (f_flags & F_DYNLOAD)   
-        printf ("DYNLOAD ");
+        lprintf ("DYNLOAD ");
       if (f_flags & F_SHROBJ)   
-        printf ("SHROBJ ");
+        lprintf ("SHROBJ ");
       if (f_flags & F_DLL)
-        printf ("DLL");
-      printf ("\n");
+        lprintf ("DLL");
+      lprintf ("\n");
     }
 }
 
@@ -486,15 +507,15 @@ get_opt_header ()
 static void 
 dump_opt_header ()
 {
-  printf ("----Optional-header------------------------------------------\n");
-  printf ("Magic number             = %o\n", magic);
-  printf ("Version stamp            = %X\n", vstamp);
-  printf ("Size of first .text      = %ld\n", tsize);
-  printf ("Size of first .data      = %ld\n", dsize);
-  printf ("Size of first .bss       = %ld\n", bsize);
-  printf ("Entry point              = 0x%08lX\n", entry);
-  printf ("Start of text            = 0x%08lX\n", text_start);
-  printf ("Start of data            = 0x%08lX\n", data_start);
+  lprintf ("----Optional-header------------------------------------------\n");
+  lprintf ("Magic number             = %o\n", magic);
+  lprintf ("Version stamp            = %X\n", vstamp);
+  lprintf ("Size of first .text      = %ld\n", tsize);
+  lprintf ("Size of first .data      = %ld\n", dsize);
+  lprintf ("Size of first .bss       = %ld\n", bsize);
+  lprintf ("Entry point              = 0x%08lX\n", entry);
+  lprintf ("Start of text            = 0x%08lX\n", text_start);
+  lprintf ("Start of data            = 0x%08lX\n", data_start);
 }
 
 static void 
@@ -548,17 +569,17 @@ get_sec_header ()
 static void 
 dump_sec_header (int sec)
 {
-  printf ("----Section-%d-header----------------------------------------\n", sec);
-  printf ("Section name             = %s\n", s_name);
-  printf ("Physical address         = %08lX\n", s_paddr);    
-  printf ("Virtual address          = %08lX\n", s_vaddr);    
-  printf ("Section size             = %08lX (%ld)\n", s_size, s_size);     
+  lprintf ("----Section-%d-header----------------------------------------\n", sec);
+  lprintf ("Section name             = %s\n", s_name);
+  lprintf ("Physical address         = %08lX\n", s_paddr);    
+  lprintf ("Virtual address          = %08lX\n", s_vaddr);    
+  lprintf ("Section size             = %08lX (%ld)\n", s_size, s_size);     
 }
 
 static void
 summarize_sec_header (int sec)
 {
-  printf ("%08lX %05lX (%ld) %s\n", s_paddr >> 1, s_size >> 1, s_size >> 1, s_name);
+  lprintf ("%08lX %05lX (%ld) %s\n", s_paddr >> 1, s_size >> 1, s_size >> 1, s_name);
 }
 
 void
@@ -604,7 +625,7 @@ get_strings (FILE *input_file)
 static void 
 dump_strings ()
 {
-  printf ("----The-string-table-----------------------------------------\n");
+  lprintf ("----The-string-table-----------------------------------------\n");
 
   if (str_tab != NULL)
     {
@@ -612,7 +633,7 @@ dump_strings ()
       char *ptr = str_tab;
       do 
          {
-           printf ("%08X : %s\n", (ptr - str_tab), ptr);
+           lprintf ("%08X : %s\n", (ptr - str_tab), ptr);
            while (*ptr++ != '\0')
              ;
          }  
@@ -657,13 +678,18 @@ get_se (struct internal_syment *ise)
 static void 
 get_dst (FILE *input_file)
 {
-  /* Read the debug symbol table into memory
+  /* Read the debug symbol table into memory.
+     The slots of auxiliary entries in syms[] are left zero.
    */
   int i;
   int j;
+  int numaux;
 
   /* Allocate space for f_nsyms */
-  syms = (struct internal_syment *)malloc (sizeof (struct internal_syment) * f_nsyms);
+  syms = (struct internal_syment *)calloc (f_nsyms + 1, sizeof (struct internal_syment));
+  aux_ent = (byte (*) [AUXESZ])calloc (f_nsyms + 1, AUXESZ);
+  if (syms == NULL || aux_ent == NULL)
+    problem ("load_coff (get_dst): no memory for the symbol table");
 
   fseek (input_file, f_symptr, SEEK_SET);
   i = 0;
@@ -671,17 +697,172 @@ get_dst (FILE *input_file)
     {
       fread (&se, SYMESZ, 1, input_file);
       get_se (&syms [i]);
+      numaux = syms [i].e_numaux;
       i++;
-      for (j = 0; j < syms [i].e_numaux; j++)
+      for (j = 0; j < numaux && i < f_nsyms; j++)
         {
-          fread (&ae, AUXESZ, 1, input_file);
-/*          get_ae (); */
+          fread (aux_ent [i], AUXESZ, 1, input_file);
+          if (j == 0 && syms [i - 1].e_sclass == C_FILE)
+            aux_ent [i] [E_FILNMLEN] = '\0';  /* X_FNAME: a C string */
           i++;
         }
     }
 
 }
 
+
+/* Name of symbol i; short names are copied to a static buffer */
+
+static char *
+symbol_name (long i)
+{
+  static THREAD_LOCAL char short_id [9];
+
+  if (syms [i].e.e_zeroes == 0)
+    return &str_tab [(syms [i].e.e_offset - 4)];
+  strncpy (short_id, syms [i].e_name, 8);
+  short_id [8] = '\0';
+  return short_id;
+}
+
+
+/* Add the labels to the symbol index: the symbols of a section, other
+   than the section names and such starting with '.', at their word
+   address */
+
+static void
+index_symbols (void)
+{
+  long i;
+
+  sym_reset ();
+  for (i = 0; i < f_nsyms; i += 1 + syms [i].e_numaux)
+    {
+      struct internal_syment *se = &syms [i];
+      char *key;
+
+      if (se->e_scnum < 1 ||
+          (se->e_sclass != C_NULL && se->e_sclass != C_EXT &&
+           se->e_sclass != C_STAT && se->e_sclass != C_AUTO))
+        continue;
+      key = symbol_name (i);
+      if (key [0] != '.')
+        sym_add (key, (ulong) (se->e_value >> 1));
+    }
+}
+
+
+/* Source file of symbol i: that of the C_FILE symbol before it */
+
+static char *
+source_file (long i)
+{
+  char *name = "?";
+  long k;
+  byte *x;
+
+  for (k = 0; k < i && k < f_nsyms; k += 1 + syms [k].e_numaux)
+    if (syms [k].e_sclass == C_FILE && syms [k].e_numaux > 0)
+      {
+        x = aux_ent [k + 1] + X_FNAME;
+        if (x [0] || x [1] || x [2] || x [3])
+          name = (char *) x;
+        else
+          name = &str_tab [(((ulong) x [4] << 24) + ((ulong) x [5] << 16)
+                            + ((ulong) x [6] << 8) + (ulong) x [7]) - 4];
+      }
+  return name;
+}
+
+
+/* Line number of function symbol i: that of the .bf following it,
+   which line number entries of the function are relative to */
+
+static int
+function_line (long i)
+{
+  long k;
+
+  for (k = i + 1 + syms [i].e_numaux; k < f_nsyms && k < i + 8;
+       k += 1 + syms [k].e_numaux)
+    if (syms [k].e_sclass == C_FCN && strcmp (symbol_name (k), ".bf") == 0
+        && syms [k].e_numaux > 0)
+      return ((int) aux_ent [k + 1] [X_LNNO] << 8)
+             + (int) aux_ent [k + 1] [X_LNNO + 1];
+  return 1;
+}
+
+
+/* Read the line number entries of the current section into lines[].
+   An entry with l_lnno 0 gives the symbol index of a function, the
+   others a physical address and a line relative to the function. */
+
+static void
+get_lines (FILE *input_file)
+{
+  byte entry [LINESZ];
+  struct source_line *sl;
+  char *file = "?";
+  int base = 1;
+  ushort n;
+
+  fseek (input_file, s_lnnoptr, SEEK_SET);
+  for (n = 0; n < s_nlnno; n++)
+    {
+      if (fread (entry, LINESZ, 1, input_file) != 1)
+        break;
+      l_symndx = l_paddr = ((ulong) entry [0] << 24) + ((ulong) entry [1] << 16)
+                           + ((ulong) entry [2] << 8) + (ulong) entry [3];
+      l_lnno = ((ushort) entry [4] << 8) + (ushort) entry [5];
+      if (l_lnno == 0 && l_symndx >= (ulong) f_nsyms)
+        continue;
+      if (n_lines == n_lines_allocated)
+        {
+          n_lines_allocated = n_lines_allocated ? 2 * n_lines_allocated : 256;
+          lines = (struct source_line *)realloc (lines, n_lines_allocated
+                                                 * sizeof (struct source_line));
+          if (lines == NULL)
+            problem ("load_coff (get_lines): no memory for line numbers");
+        }
+      sl = &lines [n_lines++];
+      if (l_lnno == 0)
+        {
+          file = source_file ((long) l_symndx);
+          base = function_line ((long) l_symndx);
+          sl->address = (ulong) (syms [l_symndx].e_value >> 1);
+          sl->line = base;
+          sl->function = strdup (symbol_name ((long) l_symndx));
+        }
+      else
+        {
+          sl->address = l_paddr >> 1;
+          sl->line = base + l_lnno - 1;
+          sl->function = NULL;
+        }
+      sl->file = file;
+    }
+}
+
+static int
+by_address (const void *a, const void *b)
+{
+  ulong x = ((const struct source_line *) a)->address;
+  ulong y = ((const struct source_line *) b)->address;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+static void
+free_lines ()
+{
+  while (n_lines > 0)
+    if (lines [--n_lines].function != NULL)
+      free (lines [n_lines].function);
+  free (lines);
+  lines = NULL;
+  n_lines_allocated = 0;
+}
+
 static void 
 print_se (struct internal_syment *se)
 {
@@ -709,32 +890,32 @@ print_se (struct internal_syment *se)
     }
 
   /* print the section number */
-  printf ("%3d %s ", se->e_scnum, class);
+  lprintf ("%3d %s ", se->e_scnum, class);
 
   switch (se->e_type & 0xf)
     {
-    case T_NULL:   printf ("        "); break;
-    case T_CHAR:   printf ("char    "); break;
-    case T_SHORT:  printf ("short   "); break;
-    case T_INT:    printf ("int     "); break;
-    case T_LONG:   printf ("long    "); break;
-    case T_FLOAT:  printf ("float   "); break;
-    case T_DOUBLE: printf ("double  "); break;
-    case T_STRUCT: printf ("struct  "); break;
-    case T_UNION:  printf ("union   "); break;
-    case T_ENUM:   printf ("enum    "); break;
-    case T_MOE:    printf ("member  "); break;
-    case T_UCHAR:  printf ("uchar   "); break;
-    case T_USHORT: printf ("ushort  "); break;
-    case T_ULONG:  printf ("ulong   "); break;
-    default:       printf ("%6d  ", se->e_type); break;
+    case T_NULL:   lprintf ("        "); break;
+    case T_CHAR:   lprintf ("char    "); break;
+    case T_SHORT:  lprintf ("short   "); break;
+    case T_INT:    lprintf ("int     "); break;
+    case T_LONG:   lprintf ("long    "); break;
+    case T_FLOAT:  lprintf ("float   "); break;
+    case T_DOUBLE: lprintf ("double  "); break;
+    case T_STRUCT: lprintf ("struct  "); break;
+    case T_UNION:  lprintf ("union   "); break;
+    case T_ENUM:   lprintf ("enum    "); break;
+    case T_MOE:    lprintf ("member  "); break;
+    case T_UCHAR:  lprintf ("uchar   "); break;
+    case T_USHORT: lprintf ("ushort  "); break;
+    case T_ULONG:  lprintf ("ulong   "); break;
+    default:       lprintf ("%6d  ", se->e_type); break;
     }
  
   /* print the value */
-  printf ("%08lX  ", se->e_value >> 1);
+  lprintf ("%08lX  ", se->e_value >> 1);
 
   if (ISPTR (se->e_type))
-    printf ("*");
+    lprintf ("*");
 
   /* print the name of the symbol */
   if (se->e.e_zeroes)
@@ -742,20 +923,20 @@ print_se (struct internal_syment *se)
       for (i = 0; i < 8; i++)
         {
           if ((se->e_name [i] > 0x1f) && (se->e_name [i] < 0x7f))
-            printf ("%c", se->e_name [i]);
+            lprintf ("%c", se->e_name [i]);
           else
-            printf (" ");
+            lprintf (" ");
         }
     }
   else
-    printf ("%s", &str_tab [(se->e.e_offset - 4)]);
+    lprintf ("%s", &str_tab [(se->e.e_offset - 4)]);
 
   if (ISFCN (se->e_type))
-    printf (" ()");
+    lprintf (" ()");
   else if (ISARY (se->e_type))
-    printf (" []");
+    lprintf (" []");
 
-  printf ("\n");
+  lprintf ("\n");
 }
 
 static void
@@ -764,7 +945,7 @@ pretty_print_dst ()
   int i;
 
   /*         4  static          00008141  floating_overflow_old    */
-  printf ("-sec--class----type---address--name--------------------------\n");
+  lprintf ("-sec--class----type---address--name--------------------------\n");
 
   i = 0;
   while (i < f_nsyms)
@@ -776,10 +957,11 @@ pretty_print_dst ()
 
 
 static int 
-process_file (FILE* input_file)
+process_file (FILE* input_file, unsigned char *image, ulong image_size)
 {
   /*
-   * Read the file header and any sections
+   * Read the file header and any sections. The raw data of the
+   * sections is taken from `image', the file mapped into memory.
    */
   int sec;
   long offset;  /* offset in file */
@@ -803,7 +985,7 @@ process_file (FILE* input_file)
       offset += f_opthdr;
 
       if (verbose)
-        printf ("Entry point = 0x%08lX\n", entry >> 1);
+        lprintf ("Entry point = 0x%08lX\n", entry >> 1);
       simreg.ic = entry >> 1;
     }
 
@@ -812,6 +994,7 @@ process_file (FILE* input_file)
     dump_strings ();
 
   get_dst (input_file);
+  index_symbols ();
 
   if (optf)
     dump_file_header ();
@@ -831,33 +1014,21 @@ process_file (FILE* input_file)
         summarize_sec_header (sec);
 
       /* load section */
-      if (1)
-	{
-	  unsigned char *raw_data = (unsigned char *)malloc (s_size);
-	  int j;
-	  long address = s_paddr >> 1;
-
-	  fseek (input_file, s_scnptr, 0);
-	  fread (raw_data, s_size, 1, input_file);
-
-	  j = 0;
-	  while (j < s_size)
-	    {
-	      /* poke a word */
-	      poke (address++, ((ushort) raw_data [j] << 8)
-                              + (ushort) raw_data [j + 1]);
-	      j += 2;
-	    }
-	  free (raw_data);
-	}
+      if (s_scnptr > image_size || s_size > image_size - s_scnptr)
+	return error ("section data beyond end of file");
+      if (write_words (s_paddr >> 1, image + s_scnptr, s_size / 2) != OKAY)
+	return ERROR;
 
       if (s_nreloc > 0)
 	{
 	  return error ("File contains relocations");
 	}
 
+      if (s_nlnno > 0)
+        get_lines (input_file);
     }
 
+  qsort (lines, n_lines, sizeof (struct source_line), by_address);
   return OKAY;
 }
 
@@ -868,12 +1039,19 @@ load_coff (char *filename)
   FILE *loadfile;
   /* char lline [strlen (filename) + 5]; */
   char * lline;
+  char * image;
+  ulong image_size;
   int retval;
 
   /* remove any previous COFF info */
   if (syms != NULL)
     free (syms);
 
+  if (aux_ent != NULL)
+    free (aux_ent);
+
+  free_lines ();
+
   if (str_tab != NULL)
     free (str_tab);
 
@@ -885,17 +1063,25 @@ load_coff (char *filename)
                  + 5);
     }
 
-  if ((loadfile = fopen (filename, "rb")) == (FILE *) 0)
+  strcpy (lline, filename);
+  if ((loadfile = fopen (lline, "rb")) == (FILE *) 0)
     {
-      strcat (strcpy (lline, filename), ".cof");
+      strcat (lline, ".cof");
       if ((loadfile = fopen (lline, "rb")) == (FILE *) 0)
         {
            free(lline);
            return error ("cannot open COFF file '%s'", filename);
         }
     }
+  if ((image = map_file (lline, &image_size)) == (char *) 0)
+    {
+      fclose (loadfile);
+      free (lline);
+      return error ("cannot read COFF file '%s'", filename);
+    }
 
-  retval = process_file (loadfile);
+  retval = process_file (loadfile, (unsigned char *) image, image_size);
+  unmap_file (image, image_size);
   free (lline);
   fclose (loadfile);
   return retval;
@@ -922,51 +1108,6 @@ si_lcf (int argc, char *argv[])
 }
 
 
-long
-find_coff_address (char *id)
-{
-  /* Given a symbol id, search the symbol table for an
-     an entry with this name, and return the value.
-     Return -1 if not found.
-   */
-  int i;
-
-  i = 0;
-  while (i < f_nsyms)
-    {
-      char short_id [9];
-      char *key;
-      struct internal_syment *se = &syms [i];
-      int j;
-
-      if (se->e_scnum >= 1 &&
-          (se->e_sclass == C_NULL ||
-           se->e_sclass == C_EXT ||
-           se->e_sclass == C_STAT ||
-           se->e_sclass == C_AUTO))
-        {
-          if (se->e.e_zeroes)
-            {
-              for (j = 0; j < 8; j++)
-                short_id [j] = se->e_name [j];
-    
-              short_id [8] = '\0';
-              key = short_id;
-            }
-          else
-            key = &str_tab [(se->e.e_offset - 4)];
-
-          if (key [0] != '.' && strcmp (key, id) == 0)
-            return se->e_value >> 1;
-        }
-
-      i++;
-    }
-
-  return -1;
-}
-
-
 int
 display_coff_symbols ()
 {
@@ -977,3 +1118,11 @@ display_coff_symbols ()
 }
 
 
+/* Return the n-th entry of the line number table, sorted by address,
+   or NULL if there are not that many */
+
+struct source_line *
+nth_coff_line (long n)
+{
+  return (n < n_lines) ? &lines [n] : NULL;
+}
@@ -0,0 +1,201 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : loadbench.c -- load file throughput benchmark               */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* loadbench.c  --  sim1750-loadbench, measure how fast load files
+   are read.
+
+   Usage:  sim1750-loadbench [<directory> [<loads>]]
+
+   A Tek Hex file holding the lower 512 Kwords of physical memory (as
+   far as its five digit byte addresses reach) and a TLD LDM file
+   holding all of the 1 Mword are generated in <directory> (default
+   /tmp). Each is then loaded <loads> times (default 5), as by the LOAD
+   and LDM commands, and the throughput is printed in MB/s. The memory
+   is checked against the generated contents after each format.
+   `make loadbench' builds and runs it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arch.h"
+#include "status.h"
+#include "utils.h"
+#include "cmd.h"
+#include "phys_mem.h"
+#include "peekpoke.h"
+#include "loadfile.h"
+#include "tekhex.h"
+
+/* Defined in main.c for the simulator proper */
+char *program_name = "sim1750-loadbench";
+char *program_version = "$Id$";
+THREAD_LOCAL bool verbose = FALSE;
+THREAD_LOCAL bool need_speed = TRUE;
+
+#define N_WORDS    (N_PAGES * 4096L)
+#define TEK_WORDS  0x80000L
+
+#define PATTERN(a)  ((ushort) ((a) * 0x9E37L ^ (a) >> 7))
+
+
+static void
+make_tekhex (char *filename)
+{
+  ulong a;
+
+  if (create_tekfile (filename) != OKAY)
+    {
+      fprintf (stderr, "sim1750-loadbench: cannot create %s\n", filename);
+      exit (EXIT_FAILURE);
+    }
+  for (a = 0; a < TEK_WORDS; a++)
+    emit_tekword (a, PATTERN (a));
+  close_tekfile (0L);
+}
+
+
+/* The checksum of an /M record (see check_ldmline() in tldldm.c) */
+
+#define ROTL16(w)  ((((w) << 1) | ((w) >> 15)) & 0xFFFF)
+
+static void
+make_ldm (char *filename)
+{
+  ulong a, i, n;
+  unsigned code;
+  FILE *fp;
+
+  if ((fp = fopen (filename, "w")) == NULL)
+    {
+      fprintf (stderr, "sim1750-loadbench: cannot create %s\n", filename);
+      exit (EXIT_FAILURE);
+    }
+  for (a = 0; a < N_WORDS; a += n)
+    {
+      n = (N_WORDS - a < 15) ? N_WORDS - a : 15;
+      code = ROTL16 ((0x9 << 1) ^ (unsigned) (a & 0xFFFF))
+	     ^ (unsigned) (a >> 16);
+      for (i = 0; i < n; i++)
+	code = ROTL16 (code) ^ PATTERN (a + i);
+      fprintf (fp, "/M%05lX%lX%04X", a, n, code);
+      for (i = 0; i < n; i++)
+	fprintf (fp, "%04X", PATTERN (a + i));
+      fputc ('\n', fp);
+    }
+  fprintf (fp, "/T0000000018\n");	/* transfer address 0 */
+  fclose (fp);
+}
+
+
+static long
+file_size (char *filename)
+{
+  FILE *fp;
+  long size;
+
+  if ((fp = fopen (filename, "rb")) == NULL)
+    return 0L;
+  fseek (fp, 0L, SEEK_END);
+  size = ftell (fp);
+  fclose (fp);
+  return size;
+}
+
+
+static int
+check_memory (ulong n_words)
+{
+  ushort value;
+  ulong a;
+
+  for (a = 0; a < n_words; a++)
+    if (! peek (a, &value) || value != PATTERN (a))
+      {
+	fprintf (stderr, "sim1750-loadbench: wrong contents at %05lX\n", a);
+	return ERROR;
+      }
+  return OKAY;
+}
+
+
+static int
+bench (char *format, int (*loader) (int argc, char *argv[]),
+       char *filename, ulong n_words, int n_loads)
+{
+  char *argv[3];
+  double seconds, megabytes = file_size (filename) / 1e6;
+  clock_t start;
+  int i;
+
+  argv[0] = format;
+  argv[1] = filename;
+  argv[2] = NULL;
+  start = clock ();
+  for (i = 0; i < n_loads; i++)
+    {
+      init_mem ();
+      if ((*loader) (2, argv) != OKAY)
+	{
+	  fprintf (stderr, "sim1750-loadbench: loading %s failed\n", filename);
+	  return ERROR;
+	}
+    }
+  seconds = (double) (clock () - start) / CLOCKS_PER_SEC;
+  printf ("%-8s %7.1f MB  %3d loads  %7.3f s  %8.1f MB/s\n", format,
+	  megabytes, n_loads, seconds,
+	  seconds > 0.0 ? megabytes * n_loads / seconds : 0.0);
+  return check_memory (n_words);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  char *dir = (argc > 1) ? argv[1] : "/tmp";
+  int n_loads = (argc > 2) ? atoi (argv[2]) : 5;
+  char tekname[256], ldmname[256];
+  int status = OKAY;
+
+  if (n_loads < 1 || strlen (dir) > sizeof (tekname) - 32)
+    {
+      fprintf (stderr, "usage: sim1750-loadbench [<directory> [<loads>]]\n");
+      return (EXIT_FAILURE);
+    }
+  if (init_system (0))
+    problem ("simulator initialization failed");
+  sprintf (tekname, "%s/loadbench.hex", dir);
+  sprintf (ldmname, "%s/loadbench.ldm", dir);
+  make_tekhex (tekname);
+  make_ldm (ldmname);
+
+  status |= bench ("load", si_lo, tekname, TEK_WORDS, n_loads);
+  status |= bench ("ldm", si_ldm, ldmname, N_WORDS, n_loads);
+
+  remove (tekname);
+  remove (ldmname);
+  return (status == OKAY) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
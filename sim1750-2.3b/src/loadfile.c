@@ -40,6 +40,7 @@
 #include "tekops.h"
 #include "coffops.h"
 #include "loadfile.h"
+#include "symtab.h"
 #include "peekpoke.h"
 
 
@@ -74,41 +75,58 @@ init_load_formats ()
 {
   loadfile_type = NONE;
 
+  sym_reset ();
   init_tekops();
   /* insert further loadfile specific initialization calls if needed */
 }
 
 
-loadfile_t loadfile_type = NONE;
+THREAD_LOCAL loadfile_t loadfile_type = NONE;
+
+/* The labels of the TekHex or COFF file last loaded are kept in the
+   index of symtab.c */
 
 char *
 find_labelname (ulong address)
 {
-  switch (loadfile_type)
-    {
-    case TEK_HEX:
-      return find_tek_label (address);
+  return sym_label (address);
+}
 
-    /* other load formats To Be Done */
 
-    default:
-      return NULL;
-    }
+/* The label at or below the address nearest to it, see sym_nearest() */
+
+char *
+find_nearest_label (ulong address, ulong *offset)
+{
+  return sym_nearest (address, offset);
+}
+
+
+/* Enumerate the labels of the file last loaded, in the order of the file */
+
+char *
+nth_label (int n, ulong *address)
+{
+  return sym_nth ((long) n, address);
+}
+
+
+/* Enumerate the line number table of the file last loaded, sorted by
+   address. Only COFF files have one. */
+
+struct source_line *
+nth_line (long n)
+{
+  if (loadfile_type == COFF)
+    return nth_coff_line (n);
+  return (struct source_line *) 0;
 }
 
 
 long
 find_address (char *labelname)
 {
-  switch (loadfile_type)
-    {
-    case TEK_HEX:
-      return find_tek_address (labelname);
-    case COFF:
-      return find_coff_address (labelname);
-    default:
-      return -1L;
-    }
+  return sym_address (labelname);
 }
 
 
@@ -134,11 +152,10 @@ si_dispsym (int argc, char *argv[])
 int
 si_prolo (int argc, char *argv[])
 {
-  ushort word;
-  ulong  abs_addr = 0L;
   char  *filename = argv[1];
-  FILE  *loadfile;
-  bool   verbose_save = verbose;
+  char  *image;
+  ulong  size;
+  int    status;
 
   if (argc <= 1)
     return error ("filename missing");
@@ -147,30 +164,27 @@ si_prolo (int argc, char *argv[])
       *filename++ = '\0';
       *(filename + strlen (filename) - 1) = '\0';
     }
-  if ((loadfile = fopen (filename, "rb")) == NULL)
+  if ((image = map_file (filename, &size)) == (char *) 0)
     return error ("cannot open load file '%s'", filename);
-  verbose = FALSE;  /* avoid info messages from poke() */
-  while (get_hilo16 (&word, loadfile) != EOF)
-    {
-      poke (abs_addr, word);
-      abs_addr++;
-    }
-  fclose (loadfile);
-  verbose = verbose_save;
-  return (0);
+  status = write_words (0L, (unsigned char *) image, size / 2);
+  unmap_file (image, size);
+  return (status);
 }
 
 
 /* load binary file in IBM User Console PS (Program Store) format */
 
+#define HILO16(p)  ((ushort) ((p)[0] << 8 | (p)[1]))
+
 int
 si_pslo (int argc, char *argv[])
 {
-  ushort loadaddr_hiword, loadaddr_loword, n_words, i, word;
-  ulong  abs_addr = 0L;
-  bool status = OKAY, verbose_save = verbose;
-  char *filename = argv[1];
-  FILE  *loadfile;
+  ushort loadaddr_hiword, n_words;
+  ulong  abs_addr = 0L, size;
+  int    status = OKAY;
+  char  *filename = argv[1];
+  char  *file;
+  unsigned char *p, *end;
 
   if (argc <= 1)
     return error ("filename missing");
@@ -179,51 +193,46 @@ si_pslo (int argc, char *argv[])
       *filename++ = '\0';
       *(filename + strlen (filename) - 1) = '\0';
     }
-  if ((loadfile = fopen (filename, "rb")) == NULL)
+  if ((file = map_file (filename, &size)) == (char *) 0)
     return error ("cannot open load file '%s'", filename);
-  verbose = FALSE;  /* avoid info messages from poke() */
-  while (! feof (loadfile))
+  p = (unsigned char *) file;
+  end = p + size;
+  /* Each record is: load address high word, low word, word count,
+     and the data words */
+  while (end - p >= 2)
     {
-      if (get_hilo16 (&loadaddr_hiword, loadfile) == EOF)
-	{
-/*	  error ("pslo: unexpected end-of-file reading load address high word");
- */
-	  break;
-	}
+      loadaddr_hiword = HILO16 (p);
       if (loadaddr_hiword > 1)
 	{
 	  status = error ("pslo: cannot load code above 0x1FFFF");
 	  break;
 	}
-      if (get_hilo16 (&loadaddr_loword, loadfile) == EOF)
+      if (end - p < 4)
 	{
 	  status = error ("pslo: unexpected EOF reading load address low word");
 	  break;
 	}
-      abs_addr = (ulong) loadaddr_hiword << 16 | (ulong) loadaddr_loword;
-      if (get_hilo16 (&n_words, loadfile) == EOF)
+      abs_addr = (ulong) loadaddr_hiword << 16 | (ulong) HILO16 (p + 2);
+      if (end - p < 6)
 	{
 	  status = error ("pslo: unexpected end-of-file reading wordcount");
 	  break;
 	}
-      for (i = 0; i < n_words; i++)
+      n_words = HILO16 (p + 4);
+      p += 6;
+      if ((ulong) (end - p) / 2 < (ulong) n_words)
 	{
-	  if (get_hilo16 (&word, loadfile) == EOF)
-	    {
-	      status = error ("pslo: unexpected EOF while reading data");
-	      break;
-	    }
-	  poke (abs_addr++, word);
+	  /* load what there is, as the data is stored before
+	     running into the end of the file */
+	  write_words (abs_addr, p, (ulong) (end - p) / 2);
+	  status = error ("pslo: unexpected EOF while reading data");
+	  break;
 	}
-      if (status == ERROR)
+      if ((status = write_words (abs_addr, p, (ulong) n_words)) != OKAY)
 	break;
+      p += 2 * n_words;
     }
-/*
-  if (status != OKAY)
-    error ("  above error occurred at filepos = %ld\n", ftell (loadfile));
- */
-  fclose (loadfile);
-  verbose = verbose_save;
+  unmap_file (file, size);
   return (status);
 }
 
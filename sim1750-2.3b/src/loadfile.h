@@ -3,7 +3,23 @@
 #ifndef _LOADFILE_H
 #define _LOADFILE_H
 
+#include "type.h"
+
 extern char *find_labelname (unsigned long address);
+extern char *find_nearest_label (unsigned long address, unsigned long *offset);
+extern char *nth_label (int n, unsigned long *address);
+
+/* Entry of the line number table of the file last loaded, if it has
+   one (COFF compiled with -g) */
+struct source_line
+  {
+    unsigned long address;	/* first address of the line */
+    int   line;
+    char *file;
+    char *function;		/* name, on the first line of a function */
+  };
+
+extern struct source_line *nth_line (long n);
 extern long find_address (char *labelname);
 extern void init_load_formats ();
 extern int  si_dispsym (int argc, char *argv[]);
@@ -16,7 +32,7 @@ extern int  si_lcf (int argc, char *argv[]);	/* load_coff.c */
 
 typedef enum { TEK_HEX, TLD_LDM, COFF, NONE} loadfile_t;
 
-extern loadfile_t loadfile_type;
+extern THREAD_LOCAL loadfile_t loadfile_type;
 
 #endif
 
@@ -0,0 +1,249 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : machine.c -- machine context handling                       */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "machine.h"
+#include "cpu.h"
+#include "status.h"
+#include "utils.h"
+#include "btrace.h"
+#include "profile.h"
+#include "coverage.h"
+#include "image.h"
+
+THREAD_LOCAL struct machine *machine = (struct machine *) 0;
+
+
+/* Create a machine with zeroed registers and memory and the page
+   registers set up to behave as if there were no MMU. */
+
+struct machine *
+new_machine (void)
+{
+  struct machine *m;
+  int as, logaddr_hinibble, i = 0;
+
+  if ((m = (struct machine *) calloc (1, sizeof (struct machine))) == 0)
+    problem ("new_machine: out of memory");
+  for (as = 0; as <= 15; as++)
+    for (logaddr_hinibble = 0; logaddr_hinibble <= 0xF; logaddr_hinibble++)
+      {
+	m->mmu[CODE][as][logaddr_hinibble].ppa = i;
+	m->mmu[DATA][as][logaddr_hinibble].ppa = i++;
+      }
+  m->timer_event = -1;
+  return m;
+}
+
+
+/* Make `m' the machine run by the calling thread. The per-thread
+   caches of the execution engines refer to the previous machine's
+   memory and page registers, so they are dropped. */
+
+void
+select_machine (struct machine *m)
+{
+  if (m == machine)
+    return;
+  machine = m;
+  if (m == (struct machine *) 0)
+    return;
+  flush_decoded ();
+  mmu_changed ();
+}
+
+
+/* Drop snapshot `s' of machine `m'. Pages that `m' still borrows from
+   it are handed over to `m'. */
+
+static void
+release_snapshot (struct machine *m, struct snapshot *s)
+{
+  int i;
+
+  for (i = 0; i < N_PAGES; i++)
+    {
+      mem_t *page = s->state.memory[i];
+
+      if (page == MNULL)
+	continue;
+      if (m->memory[i] == page)
+	m->cow[i] = 0;
+      else
+	xfree ((void *) page, sizeof (mem_t));
+    }
+  free ((void *) s);
+}
+
+
+void
+delete_machine (struct machine *m)
+{
+  struct machine *current = (m == machine) ? (struct machine *) 0 : machine;
+  struct snapshot *s;
+  int i;
+
+  /* xfree() counts the snapshot pages off the selected machine */
+  select_machine (m);
+  while ((s = m->snapshots) != (struct snapshot *) 0)
+    {
+      m->snapshots = s->next;
+      release_snapshot (m, s);
+    }
+  select_machine (current);
+  bt_release (&m->bt);
+  profile_release (m);
+  coverage_release (m);
+  for (i = 0; i < N_PAGES; i++)
+    if (m->memory[i] != MNULL && ! m->cow[i])
+      free ((void *) m->memory[i]);
+  image_release (m);
+  free ((void *) m);
+}
+
+
+/* Snapshots.
+   Taking a snapshot hands the current machine's memory pages over to
+   the snapshot and lets the machine borrow them. The first write to a
+   borrowed page makes a private copy (see unshare_page(), called by
+   poke()). Restoring swaps back only the pages that differ from the
+   snapshot, so its cost is proportional to the pages written since. */
+
+static struct snapshot *
+find_snapshot (char *name, struct snapshot ***link)
+{
+  struct snapshot **sp;
+
+  for (sp = &machine->snapshots; *sp != (struct snapshot *) 0;
+       sp = &(*sp)->next)
+    if (eq ((*sp)->name, name))
+      break;
+  if (link != (struct snapshot ***) 0)
+    *link = sp;
+  return *sp;
+}
+
+
+/* Give the current machine a private copy of a borrowed page */
+
+void
+unshare_page (unsigned page)
+{
+  mem_t *copy;
+
+  if ((copy = (mem_t *) xalloc (1, sizeof (mem_t))) == MNULL)
+    problem ("unshare_page: memory allocation request refused by OS");
+  memcpy ((void *) copy, (void *) mem[page], sizeof (mem_t));
+  mem[page] = copy;
+  cow_page[page] = 0;
+  tlb_flush ();
+}
+
+
+int
+snapshot_machine (char *name)
+{
+  struct snapshot **link, *s;
+  int i;
+
+  if (strlen (name) >= sizeof (s->name))
+    return error ("snapshot name too long");
+  if ((s = find_snapshot (name, &link)) != (struct snapshot *) 0)
+    {
+      *link = s->next;
+      release_snapshot (machine, s);
+    }
+  if ((s = (struct snapshot *) calloc (1, sizeof (struct snapshot))) == 0)
+    return error ("no memory for snapshot");
+  /* A page may only belong to one snapshot */
+  for (i = 0; i < N_PAGES; i++)
+    if (mem[i] != MNULL && cow_page[i])
+      unshare_page (i);
+  sync_timers ();
+  strcpy (s->name, name);
+  s->state = *machine;
+  s->state.snapshots = (struct snapshot *) 0;
+  memset ((void *) &s->state.bt, 0, sizeof (struct bt_ring));
+  memset ((void *) s->state.prof, 0, sizeof (s->state.prof));
+  memset ((void *) s->state.cov, 0, sizeof (s->state.cov));
+  s->state.image = (char *) 0;
+  for (i = 0; i < N_PAGES; i++)
+    cow_page[i] = (mem[i] != MNULL);
+  s->next = machine->snapshots;
+  machine->snapshots = s;
+  return OKAY;
+}
+
+
+int
+restore_machine (char *name)
+{
+  struct snapshot *s, *snapshots = machine->snapshots;
+  struct bt_ring bt = machine->bt;
+  char *image = machine->image;
+  ulong image_size = machine->image_size;
+  struct prof_page *prof[N_PAGES];
+  struct cov_page *cov[N_PAGES];
+  ulong mem_allocated;
+  int i;
+
+  if ((s = find_snapshot (name, (struct snapshot ***) 0)) == 0)
+    return error ("no snapshot named %s", name);
+  for (i = 0; i < N_PAGES; i++)
+    if (mem[i] != s->state.memory[i])
+      {
+	if (mem[i] != MNULL && ! cow_page[i])
+	  xfree ((void *) mem[i], sizeof (mem_t));
+	invalidate_page (i);
+      }
+  mem_allocated = allocated;
+  memcpy ((void *) prof, (void *) machine->prof, sizeof (prof));
+  memcpy ((void *) cov, (void *) machine->cov, sizeof (cov));
+  *machine = s->state;
+  machine->snapshots = snapshots;
+  machine->bt = bt;		/* the backtrace goes on, */
+  bt_timers_changed ();		/* from the timers restored */
+  machine->image = image;	/* and the image stays mapped */
+  machine->image_size = image_size;
+  memcpy ((void *) machine->prof, (void *) prof, sizeof (prof));  /* and the profile */
+  memcpy ((void *) machine->cov, (void *) cov, sizeof (cov));  /* and the coverage */
+  allocated = mem_allocated;
+  for (i = 0; i < N_PAGES; i++)
+    cow_page[i] = (mem[i] != MNULL);
+  mmu_changed ();
+  return OKAY;
+}
+
+
+void
+list_snapshots (void)
+{
+  struct snapshot *s;
+
+  for (s = machine->snapshots; s != (struct snapshot *) 0; s = s->next)
+    lprintf ("\t%-32s IC %04hX\n", s->name, s->state.regs.ic);
+}
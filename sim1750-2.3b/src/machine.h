@@ -0,0 +1,135 @@
+/* machine.h -- exports of machine.c */
+
+#ifndef _MACHINE_H
+#define _MACHINE_H
+
+#include "arch.h"
+#include "phys_mem.h"
+
+#define MAX_EVENTS  16      /* timed events per machine (sched.c) */
+
+struct event
+  {
+    void (*handler) (void);
+    ulong when;
+    bool  armed;
+  };
+
+/* Backtrace ring (btrace.c) */
+struct bt_entry
+  {
+    struct regs regs;		/* simreg, */
+    bool   cs_lazy;		/* machine->cs_lazy and cs_result */
+    long   cs_result;		/* before an instruction */
+    unsigned cycle;		/* sched_now then, modulo 2^32 */
+  };
+
+struct bt_sync
+  {
+    unsigned synced;		/* timers_synced, modulo 2^32 */
+    ulong  tatick_in_ns;	/* and the timer prescalers then */
+    ushort tbtick_in_tatix, gotick_in_10usec;
+  };
+
+struct bt_key
+  {
+    ulong  entry, offset;	/* entry number, byte offset in buf */
+  };
+
+struct bt_ring
+  {
+    struct bt_entry *stage, *next;	/* entries not packed yet */
+    struct bt_entry *end;	/* stage + BT_BATCH, or next for bt_sync() */
+    unsigned char *buf;		/* packed entries, mask + 1 bytes */
+    ulong  mask, head;		/* bytes written in all */
+    ulong  packed;		/* entries packed in all */
+    struct bt_key *keys;
+    ulong  n_keys, key_total, since_key;
+    struct regs last;		/* last entry packed, with its CS */
+    unsigned last_cycle;
+    struct bt_sync sync;	/* in effect for the staged entries */
+    bool   sync_pending;	/* timers synced since the last pack */
+  };
+
+/* Execution counts of one page of physical memory (profile.c) */
+struct prof_page
+  {
+    ulong count[4096];		/* instructions executed at each address */
+    ulong cycles[4096];		/* cycles taken by them */
+  };
+
+/* Coverage of one page of physical memory (coverage.c), one bit per
+   address laid out like mem_t.was_written[] */
+struct cov_page
+  {
+    ulong executed[PAGE_MAP_LONGS];	/* an instruction started here */
+    ulong taken[PAGE_MAP_LONGS];	/* conditional branch here was taken */
+    ulong not_taken[PAGE_MAP_LONGS];	/* ... and was not taken */
+  };
+
+/* All state of one simulated 1750 system. Any number of machines may
+   exist; each host thread runs the one selected by select_machine(). */
+
+struct machine
+  {
+    struct regs   regs;			/* the 1750 register file */
+    bool   cs_lazy;			/* CS in regs.sw not yet updated */
+    long   cs_result;			/* last result for the CS (arith.h) */
+					/* (these three first, and as in */
+					/* struct bt_entry) */
+    struct mmureg mmu[2][16][16];	/* page registers */
+    mem_t        *memory[N_PAGES];	/* physical memory */
+    struct prof_page *prof[N_PAGES];	/* profile of memory[] (profile.c) */
+    struct cov_page  *cov[N_PAGES];	/* coverage of memory[] (coverage.c) */
+    ulong  mem_allocated;		/* bytes obtained through xalloc() */
+    ulong  instcnt;			/* instructions executed */
+    double total_time_in_us;		/* simulation time */
+    struct bt_ring bt;			/* backtrace (btrace.c) */
+    /* event queue (sched.c) */
+    ulong  sched_now, sched_deadline;
+    struct event events[MAX_EVENTS];
+    int    n_events;
+    /* timer prescalers (cpu.c) */
+    ulong  timers_synced, one_tatick_in_ns;
+    ushort one_tbtick_in_tatix, one_gotick_in_10usec;
+    int    timer_event;
+    ushort bex_index;			/* vector offset of the last BEX (cpu.c) */
+    /* snapshots (machine.c) */
+    struct snapshot *snapshots;
+    char   cow[N_PAGES];		/* memory[] page is borrowed from one, */
+					/* or from the image */
+    char  *image;			/* mapped image file (image.c) */
+    ulong  image_size;
+  };
+
+/* A snapshot holds a copy of the machine. Its memory pages are never
+   written; the snapshot owns them, and the live machine borrows them
+   copy-on-write after snapshot_machine() or restore_machine(). */
+
+struct snapshot
+  {
+    char   name[32];
+    struct snapshot *next;
+    struct machine state;
+  };
+
+extern THREAD_LOCAL struct machine *machine;  /* machine of this thread */
+
+extern struct machine *new_machine (void);
+extern void  select_machine (struct machine *m);
+extern void  delete_machine (struct machine *m);
+extern int   snapshot_machine (char *name);
+extern int   restore_machine (char *name);
+extern void  list_snapshots (void);
+extern void  unshare_page (unsigned page);
+
+/* Shorthands for the state of the current machine */
+#define simreg            (machine->regs)
+#define pagereg           (machine->mmu)
+#define mem               (machine->memory)
+#define allocated         (machine->mem_allocated)
+#define instcnt           (machine->instcnt)
+#define total_time_in_us  (machine->total_time_in_us)
+#define cow_page          (machine->cow)
+
+#endif
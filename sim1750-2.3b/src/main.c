@@ -41,6 +41,9 @@
 #include "targsys.h"
 #include "cmd.h"
 #include "loadfile.h"
+#include "image.h"
+#include "farm.h"
+#include "server.h"
 
 
 /*
@@ -52,8 +55,8 @@ char *program_version = "$Id$";
 /*
  * Options for this run
  */
-bool verbose = TRUE;      /* use -q to turn off excessive output */
-bool need_speed = FALSE;  /* use -n to increase speed (see the SP command) */
+THREAD_LOCAL bool verbose = TRUE;      /* use -q to turn off excessive output */
+THREAD_LOCAL bool need_speed = FALSE;  /* use -n to increase speed (see SP) */
 
 
 static void
@@ -65,15 +68,22 @@ print_optionhelp ()
   puts ("  -c <coff_loadfile>      (directly run COFF file)");
   puts ("  -t <tekhex_loadfile>    (directly run TEKHEX file)");
   puts ("  -l <tldldm_loadfile>    (directly run TLDLDM file)");
+  puts ("  -s <image>              (start from a saved machine image)");
   puts ("  -n                      (gain speed/disable backtracing)");
+  puts ("  -m <manifest>           (run the jobs of a regression manifest)");
+  puts ("  -j <threads>            (number of threads for -m, default 1)");
+  puts ("  -F <socket>             (fork server for the -c/-l/-t file)");
+  puts ("  -u <marker>             (warm up -F until label/address)");
 }
 
 
 int
 main (int argc, char *argv[])
 {
-  char *batchfile = NULL, *loadfile = NULL, *chip;
+  char *batchfile = NULL, *loadfile = NULL, *manifest = NULL, *chip;
+  char *server = NULL, *marker = NULL, *image = NULL;
   loadfile_t filetype = NONE;
+  int  n_threads = 1;
 
 #if defined   (F9450)
   chip = "F9450";
@@ -113,8 +123,18 @@ main (int argc, char *argv[])
                 elsecase 't':        /* tek startfile */
                   loadfile = argv[++i];
                   filetype = TEK_HEX;
+                elsecase 's':        /* machine image startfile */
+                  image = argv[++i];
                 elsecase 'n':        /* no backtrace */
                   need_speed = TRUE;
+                elsecase 'm':        /* regression farm manifest */
+                  manifest = argv[++i];
+                elsecase 'j':        /* farm worker threads */
+                  n_threads = atoi (argv[++i]);
+                elsecase 'F':        /* fork server socket */
+                  server = argv[++i];
+                elsecase 'u':        /* fork server warm-up marker */
+                  marker = argv[++i];
 		elsecase 'h':        /* help on command line options */
                   print_optionhelp ();
                   break;
@@ -126,6 +146,15 @@ main (int argc, char *argv[])
         }
     }
 
+  if (manifest != NULL)
+    return (farm (manifest, n_threads) == OKAY) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if (server != NULL && loadfile == NULL)
+    problem ("-F needs a file to run (-c, -l or -t)");
+
+  if (image != NULL && load_image (image) != OKAY)
+    problem ("Could not load image (see above)");
+
   if (loadfile != NULL)
     {
       int  ans = 0, f_argc = 2;
@@ -148,6 +177,9 @@ main (int argc, char *argv[])
         }
       if (ans != OKAY)
 	problem ("Could not run (see above)");
+      if (server != NULL)
+	return (fork_server (server, marker) == OKAY)
+	       ? EXIT_SUCCESS : EXIT_FAILURE;
       f_argc = 0;
       f_argv [0] = NULL;
       ans = si_go (f_argc, f_argv);
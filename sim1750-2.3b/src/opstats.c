@@ -0,0 +1,253 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : opstats.c -- opcode and instruction class statistics        */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* opstats.c  --  opcode and instruction class statistics.
+
+   When compiled with -DOPSTATS, execute() counts the instructions
+   executed and their cycles per opcode high byte and sub-opcode (see
+   opstats.h). The STATS command reports from these the instruction
+   mix, the share of each instruction class, and which entries of the
+   opcode table (exfunc[] in cpu.c) were executed at all. Without
+   -DOPSTATS nothing is counted and STATS only says so.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "status.h"
+#include "utils.h"
+#include "cpu.h"
+#include "opstats.h"
+
+#ifdef OPSTATS
+
+extern int dism1750 (char *, ushort *);	/* dism1750.c */
+
+THREAD_LOCAL ulong op_count[256][16], op_cycles[256][16];
+
+#define INTEGER   0
+#define FLOAT     1
+#define EXTENDED  2
+#define BRANCH    3
+#define XIO       4
+#define N_CLASSES 5
+
+static const char *class_name[N_CLASSES] =
+  { "integer", "float", "extended float", "branch", "XIO" };
+
+/* Class by opcode high byte; 40..43 depend on the sub-opcode */
+#define I INTEGER
+#define F FLOAT
+#define E EXTENDED
+#define B BRANCH
+#define X XIO
+
+static const char op_class[256] =
+  {
+    I, I, I, I,  I, I, I, I,  I, I, I, I,  I, I, I, I,	/* 00 - 0F */
+    I, I, I, I,  I, I, I, I,  I, I, I, I,  I, I, I, I,	/* 10 - 1F */
+    F, F, F, F,  F, F, F, F,  F, F, F, F,  F, F, F, F,	/* 20 - 2F */
+    I, I, I, I,  I, I, I, I,  I, I, I, I,  F, F, F, F,	/* 30 - 3F */
+    I, I, I, I,  I, I, I, I,  X, X, I, I,  I, E, F, I,	/* 40 - 4F */
+    I, I, I, I,  I, I, I, I,  I, I, I, I,  I, I, I, I,	/* 50 - 5F */
+    I, I, I, I,  I, I, I, I,  I, I, I, I,  I, I, I, I,	/* 60 - 6F */
+    B, B, B, B,  B, B, B, B,  B, B, B, B,  B, B, B, B,	/* 70 - 7F */
+    I, I, I, I,  I, I, I, I,  I, I, E, I,  I, I, I, I,	/* 80 - 8F */
+    I, I, I, I,  I, I, I, I,  I, I, E, I,  I, I, I, I,	/* 90 - 9F */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  F, I, I, I,	/* A0 - AF */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  F, I, I, I,	/* B0 - BF */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  I, I, I, I,	/* C0 - CF */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  I, I, I, I,	/* D0 - DF */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  I, I, I, I,	/* E0 - EF */
+    I, I, I, I,  I, I, I, I,  F, F, E, E,  I, I, I, I	/* F0 - FF */
+  };
+
+#undef I
+#undef F
+#undef E
+#undef B
+#undef X
+
+static int
+class_of (unsigned hibyte, unsigned sub)
+{
+  if ((hibyte & 0xFC) == 0x40)	/* FABX .. FDBX, FCBX */
+    return ((sub >= 8 && sub <= 11) || sub == 13) ? FLOAT : INTEGER;
+  return op_class[hibyte];
+}
+
+
+/* Mnemonic of the instruction with the given high byte and sub-opcode,
+   or "" if there is none */
+
+static void
+mnemonic (unsigned hibyte, unsigned sub, char *name)
+{
+  char text[80];
+  ushort word[2];
+
+  if ((hibyte & 0xFC) == 0x40)
+    word[0] = (ushort) ((hibyte << 8) | (sub << 4));
+  else if (hibyte == 0xFF)
+    word[0] = (ushort) (0xFF00 | (sub << 4) | sub);
+  else
+    word[0] = (ushort) ((hibyte << 8) | sub);
+  word[1] = 0;
+  dism1750 (text, word);
+  if (sscanf (text, "%7s", name) != 1 || strncmp (name, "??", 2) == 0)
+    *name = '\0';
+}
+
+
+struct mix
+  {
+    char     name[8];
+    unsigned hibyte;
+    ulong    count, cycles;
+  };
+
+static int
+by_count (const void *a, const void *b)
+{
+  ulong x = ((const struct mix *) a)->count;
+  ulong y = ((const struct mix *) b)->count;
+
+  return (x > y) ? -1 : (x < y);
+}
+
+
+static int
+report (int max_lines)
+{
+  struct mix *mix, *m;
+  ulong class_count[N_CLASSES], class_cycles[N_CLASSES];
+  ulong total_count = 0, total_cycles = 0;
+  unsigned hibyte, sub;
+  int i, n_mix = 0, n_valid = 0, n_run = 0, column;
+  char name[8];
+
+  if ((mix = (struct mix *) malloc (256 * 16 * sizeof (struct mix))) == 0)
+    return error ("no memory for the statistics");
+  memset (class_count, 0, sizeof (class_count));
+  memset (class_cycles, 0, sizeof (class_cycles));
+
+  /* Sub-opcodes of the same mnemonic (normally all 16) make one line */
+  for (hibyte = 0; hibyte < 256; hibyte++)
+    for (sub = 0; sub < 16; sub++)
+      {
+	if (op_count[hibyte][sub] == 0)
+	  continue;
+	mnemonic (hibyte, sub, name);
+	if (n_mix > 0 && mix[n_mix - 1].hibyte == hibyte
+	    && strcmp (mix[n_mix - 1].name, name) == 0)
+	  m = &mix[n_mix - 1];
+	else
+	  {
+	    m = &mix[n_mix++];
+	    strcpy (m->name, name);
+	    m->hibyte = hibyte;
+	    m->count = m->cycles = 0;
+	  }
+	m->count += op_count[hibyte][sub];
+	m->cycles += op_cycles[hibyte][sub];
+	class_count[class_of (hibyte, sub)] += op_count[hibyte][sub];
+	class_cycles[class_of (hibyte, sub)] += op_cycles[hibyte][sub];
+	total_count += op_count[hibyte][sub];
+	total_cycles += op_cycles[hibyte][sub];
+      }
+  if (total_count == 0)
+    {
+      free ((void *) mix);
+      info ("No instructions counted");
+      return (OKAY);
+    }
+
+  qsort (mix, n_mix, sizeof (struct mix), by_count);
+  lprintf ("\t Instructions      %%        Cycles      %%  Opcode\n");
+  for (i = 0; i < n_mix && i < max_lines; i++)
+    lprintf ("\t%13lu %6.2f  %12lu %6.2f  %02X %s\n", mix[i].count,
+	     100.0 * mix[i].count / total_count, mix[i].cycles,
+	     100.0 * mix[i].cycles / total_cycles, mix[i].hibyte,
+	     mix[i].name);
+  lprintf ("\t%13lu 100.00  %12lu 100.00  total\n\n",
+	   total_count, total_cycles);
+  free ((void *) mix);
+
+  lprintf ("\t Instructions      %%        Cycles      %%  Class\n");
+  for (i = 0; i < N_CLASSES; i++)
+    lprintf ("\t%13lu %6.2f  %12lu %6.2f  %s\n", class_count[i],
+	     100.0 * class_count[i] / total_count, class_cycles[i],
+	     100.0 * class_cycles[i] / total_cycles, class_name[i]);
+
+  for (hibyte = 0; hibyte < 256; hibyte++)
+    if (valid_opcode (hibyte))
+      {
+	n_valid++;
+	for (sub = 0; sub < 16 && op_count[hibyte][sub] == 0; sub++)
+	  ;
+	n_run += (sub < 16);
+      }
+  lprintf ("\n\tISA coverage: %d of %d opcodes executed", n_run, n_valid);
+  if (n_run < n_valid)
+    lprintf (", not executed:");
+  for (hibyte = 0, column = 0; hibyte < 256; hibyte++)
+    {
+      if (! valid_opcode (hibyte))
+	continue;
+      for (sub = 0; sub < 16 && op_count[hibyte][sub] == 0; sub++)
+	;
+      if (sub < 16)
+	continue;
+      for (sub = 0, *name = '\0'; sub < 16 && *name == '\0'; sub++)
+	mnemonic (hibyte, sub, name);
+      lprintf ("%s%02X %-5s", (column++ % 8) ? "  " : "\n\t", hibyte, name);
+    }
+  lprintf ("\n");
+  return (OKAY);
+}
+
+#endif /* OPSTATS */
+
+
+int
+si_stats (int argc, char *argv[])
+{
+#ifdef OPSTATS
+  int max_lines = 20;
+
+  if (argc > 1 && eq (argv[1], "reset"))
+    {
+      memset (op_count, 0, sizeof (op_count));
+      memset (op_cycles, 0, sizeof (op_cycles));
+      return (OKAY);
+    }
+  if (argc > 1 && sscanf (argv[1], "%d", &max_lines) != 1)
+    return error ("invalid argument -- must be RESET or a number of lines");
+  return report (max_lines);
+#else
+  return error ("no statistics -- sim1750 was compiled without -DOPSTATS");
+#endif
+}
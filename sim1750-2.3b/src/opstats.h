@@ -0,0 +1,28 @@
+/* opstats.h -- exports of opstats.c */
+
+#ifndef _OPSTATS_H
+#define _OPSTATS_H
+
+#include "type.h"
+
+/* The counters exist only when compiled with -DOPSTATS; otherwise
+   COUNT_OPCODE() in execute() expands to nothing. They are indexed by
+   the high byte of the opcode and the sub-opcode, which is bits 8..11
+   of the opcode for 40..43 (LBX etc.) and bits 12..15 otherwise. */
+
+#ifdef OPSTATS
+extern THREAD_LOCAL ulong op_count[256][16], op_cycles[256][16];
+#define SUB_OPCODE(opc) \
+	  ((((opc) >> 8) & 0xFC) == 0x40 ? ((opc) >> 4) & 0xF : (opc) & 0xF)
+#define COUNT_OPCODE(opc,cycles) \
+	  (op_count[(opc) >> 8][SUB_OPCODE (opc)]++, \
+	   op_cycles[(opc) >> 8][SUB_OPCODE (opc)] += (ulong) (cycles))
+#define OPSTATS_ENABLED  TRUE
+#else
+#define COUNT_OPCODE(opc,cycles)
+#define OPSTATS_ENABLED  FALSE
+#endif
+
+extern int si_stats (int argc, char *argv[]);
+
+#endif
@@ -34,6 +34,14 @@
 #include "phys_mem.h"
 #include "status.h"
 #include "utils.h"  /* for problem() */
+#include "cpu.h"    /* for invalidate_decoded(), tlb_flush() */
+#include "machine.h"   /* for unshare_page() */
+#include "tracefile.h"
+#include "peekpoke.h"
+
+THREAD_LOCAL struct journal_entry journal[JOURNAL_SIZE];
+static THREAD_LOCAL int journal_len = -1;	/* -1 when not recording */
+static THREAD_LOCAL int journal_used;
 
 
 /* peek() returns FALSE on reading an uninitialized location. */
@@ -44,20 +52,14 @@ peek (ulong phys_address, ushort *value)
   unsigned page     = (unsigned) (phys_address >> 12);
   unsigned log_addr = (unsigned) (phys_address & 0x0FFF);
   mem_t *memptr;
-  ulong was_written;
 
   if (page > 0xFF)
     problem ("peek: absolute memory address too large");
   if ((memptr = mem[page]) == MNULL)
-    {
-      if (verbose)
-        lprintf ("peek: dynamically allocating page %02X\n", page);
-      if ((memptr = mem[page] = (mem_t *) xalloc (1, sizeof (mem_t))) == MNULL)
-	problem ("peek: memory allocation request refused by OS\n");
-    }
+    memptr = &zero_page;	/* reading does not allocate */
   *value = memptr->word[log_addr];
-  was_written = memptr->was_written[log_addr / 32] & (1L << (log_addr % 32));
-  return was_written != 0;
+  return (memptr->was_written[PAGE_MAP_INDEX (log_addr)]
+	  & PAGE_MAP_BIT (log_addr)) != 0;
 }
 
 
@@ -76,9 +78,69 @@ poke (ulong phys_address, ushort value)
         lprintf ("poke: dynamically allocating page %02X\n", page);
       if ((memptr = mem[page] = (mem_t *) xalloc (1, sizeof (mem_t))) == MNULL)
 	problem ("poke: dynamic memory exhausted");
+      tlb_flush ();		/* it may map the page to zero_page */
+    }
+  else if (cow_page[page])
+    {
+      unshare_page (page);	/* copy-on-write (see machine.c) */
+      memptr = mem[page];
     }
+  if (journal_len >= 0)
+    {
+      struct journal_entry *j;
+
+      if (journal_len >= JOURNAL_SIZE)
+	problem ("poke: write journal overflow");
+      j = &journal[journal_len++];
+      j->phys_address = phys_address;
+      j->old_value = memptr->word[log_addr];
+      j->new_value = value;
+      j->was_written = (memptr->was_written[PAGE_MAP_INDEX (log_addr)]
+			& PAGE_MAP_BIT (log_addr)) != 0;
+    }
+  if (tracing)
+    trace_store (phys_address, memptr->word[log_addr], value);
   memptr->word[log_addr] = value;
-  memptr->was_written[log_addr / 32] |= 1L << (log_addr % 32);
+  memptr->was_written[PAGE_MAP_INDEX (log_addr)] |= PAGE_MAP_BIT (log_addr);
+  invalidate_decoded (phys_address);
+}
+
+
+
+
+/* Memory write journal. Between journal_start() and journal_stop(),
+   poke() records each write in journal[] so that it can be inspected and
+   undone by journal_undo(). Used by the lockstep engine (see cpu.c). */
+
+void
+journal_start (void)
+{
+  journal_len = 0;
 }
 
+/* Returns the number of entries recorded */
+int
+journal_stop (void)
+{
+  journal_used = journal_len;
+  journal_len = -1;
+  return journal_used;
+}
 
+void
+journal_undo (void)
+{
+  while (journal_used > 0)
+    {
+      struct journal_entry *j = &journal[--journal_used];
+      unsigned log_addr = (unsigned) (j->phys_address & 0x0FFF);
+      mem_t *memptr = mem[(unsigned) (j->phys_address >> 12)];
+
+      memptr->word[log_addr] = j->old_value;
+      if (j->was_written)
+	memptr->was_written[PAGE_MAP_INDEX (log_addr)] |= PAGE_MAP_BIT (log_addr);
+      else
+	memptr->was_written[PAGE_MAP_INDEX (log_addr)] &= ~PAGE_MAP_BIT (log_addr);
+      invalidate_decoded (j->phys_address);
+    }
+}
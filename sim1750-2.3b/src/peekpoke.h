@@ -1,7 +1,26 @@
 /* peekpoke.h  -- exports of peekpoke.c */
 
+#ifndef _PEEKPOKE_H
+#define _PEEKPOKE_H
+
 #include "type.h"
 
 extern bool peek (ulong phys_address, ushort *value);
 extern void poke (ulong phys_address, ushort value);
 
+/* Memory write journal */
+struct journal_entry
+  {
+    ulong  phys_address;
+    ushort old_value, new_value;
+    bool   was_written;		/* state of the was_written bit before */
+  };
+
+#define JOURNAL_SIZE  1024
+
+extern THREAD_LOCAL struct journal_entry journal[JOURNAL_SIZE];
+extern void journal_start (void);
+extern int  journal_stop (void);
+extern void journal_undo (void);
+
+#endif
@@ -34,23 +34,35 @@
 #include <string.h>
 
 #include "phys_mem.h"
+#include "status.h"
+#include "utils.h"  /* for problem() */
+#include "cpu.h"  /* for flush_decoded(), tlb_flush(), invalidate_page() */
+#include "machine.h"  /* for unshare_page() */
+#include "peekpoke.h"
+#include "tracefile.h"
 
-mem_t *mem[256];  /* 1 Mword address space */
+mem_t zero_page;
 
-ulong allocated = 0;  /* statistic of total amount allocated by xalloc() */
+
+/* Pages are only allocated on writing them, so memory is reset by
+   releasing all pages. Pages borrowed from a snapshot stay with it. */
 
 void
 init_mem ()
 {
   int i;
 
-  /* allocate the first 4Kword page (just for convenience) */
-  if (mem[0] == MNULL)
-    mem[0] = (mem_t *) xalloc (1, sizeof (mem_t));
-  /* fill simulation memory with zeros */
-  for (i = 0; i < 256; i++)
+  for (i = 0; i < N_PAGES; i++)
     if (mem[i] != MNULL)
-      memset ((void *) mem[i], 0, sizeof (mem_t));
+      {
+	if (cow_page[i])
+	  cow_page[i] = 0;
+	else
+	  xfree ((void *) mem[i], sizeof (mem_t));
+	mem[i] = MNULL;
+      }
+  tlb_flush ();
+  flush_decoded ();
 }
 
 
@@ -62,7 +74,76 @@ was_written (ulong phys_address)
 
   if (mem[page] == MNULL)
     return 0;
-  return (mem[page]->was_written[address / 32] & (1L << (address % 32))) != 0;
+  return (mem[page]->was_written[PAGE_MAP_INDEX (address)]
+	  & PAGE_MAP_BIT (address)) != 0;
+}
+
+
+/* Set the bits of addresses first .. first+n-1 of a page bitmap */
+
+static void
+set_page_map (ulong *map, unsigned first, unsigned n)
+{
+  unsigned i = PAGE_MAP_INDEX (first), last = PAGE_MAP_INDEX (first + n - 1);
+  ulong head = ~0UL << (first % PAGE_MAP_BITS);
+  ulong tail = ~0UL >> (PAGE_MAP_BITS - 1 - (first + n - 1) % PAGE_MAP_BITS);
+
+  if (i == last)
+    {
+      map[i] |= head & tail;
+      return;
+    }
+  map[i++] |= head;
+  while (i < last)
+    map[i++] = ~0UL;
+  map[last] |= tail;
+}
+
+
+/* Bulk version of poke() for the loaders: store `n_words' words at
+   `phys_address' onwards, taken from `bytes' most significant byte
+   first as they come in load files. Works a page at a time. */
+
+int
+write_words (ulong phys_address, unsigned char *bytes, ulong n_words)
+{
+  unsigned page, offset, i, n;
+  mem_t *memptr;
+
+  if (phys_address + n_words > (ulong) N_PAGES << 12)
+    return error ("load data beyond the physical address space");
+  if (tracing)
+    {
+      /* each store goes to the trace file */
+      for (; n_words > 0; n_words--, bytes += 2)
+	poke (phys_address++, (ushort) (bytes[0] << 8 | bytes[1]));
+      return OKAY;
+    }
+  while (n_words > 0)
+    {
+      page = (unsigned) (phys_address >> 12);
+      offset = (unsigned) (phys_address & 0x0FFF);
+      n = (n_words < 4096 - offset) ? (unsigned) n_words : 4096 - offset;
+      if ((memptr = mem[page]) == MNULL)
+	{
+	  if ((memptr = mem[page] = (mem_t *) xalloc (1, sizeof (mem_t)))
+	      == MNULL)
+	    problem ("write_words: dynamic memory exhausted");
+	  tlb_flush ();
+	}
+      else if (cow_page[page])
+	{
+	  unshare_page (page);
+	  memptr = mem[page];
+	}
+      for (i = 0; i < n; i++, bytes += 2)
+	memptr->word[offset + i] = (ushort) (bytes[0] << 8 | bytes[1]);
+      set_page_map (memptr->was_written, offset, n);
+      invalidate_page (page);
+      phys_address += n;
+      n_words -= n;
+    }
+  return OKAY;
 }
 
 
@@ -74,3 +155,9 @@ void *xalloc (ulong number, ulong size)
   return (retval);
 }
 
+void xfree (void *block, ulong size)
+{
+  free (block);
+  allocated -= size;
+}
+
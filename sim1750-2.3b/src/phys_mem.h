@@ -7,9 +7,21 @@
 
 extern void   init_mem ();
 extern bool   was_written (ulong phys_address);
+extern int    write_words (ulong phys_address, unsigned char *bytes,
+			   ulong n_words);
 /* simulation memory allocator */
 extern void  *xalloc (ulong number, ulong size);
-extern ulong allocated;  /* total amount allocated by xalloc() */
+extern void   xfree (void *block, ulong size);
+/* `allocated' (total amount allocated by xalloc()) is kept per machine */
+
+/* Bitmaps with one bit per address of a page, such as was_written[]
+   below, use all bits of a ulong: bit PAGE_MAP_BIT(offset) of element
+   PAGE_MAP_INDEX(offset), `offset' being the address within the page. */
+
+#define PAGE_MAP_BITS   (8 * sizeof (ulong))
+#define PAGE_MAP_LONGS  (4096 / (8 * sizeof (ulong)))
+#define PAGE_MAP_INDEX(offset)  ((unsigned) (offset) / PAGE_MAP_BITS)
+#define PAGE_MAP_BIT(offset)    (1UL << ((unsigned) (offset) % PAGE_MAP_BITS))
 
 /* mem.word[] contains the simulation's allocated memory pages.
    The mem.was_written[] array has one bit for each address within a page.
@@ -20,11 +32,15 @@ extern ulong allocated;  /* total amount allocated by xalloc() */
 typedef struct
   {
     ushort word[4096];
-    ulong  was_written[128];  /* bit-packed, one bit per address */
+    ulong  was_written[PAGE_MAP_LONGS];  /* bit-packed, one bit per address */
   } mem_t;
 
+/* Pages not allocated yet read as zero_page, whose was_written[] bits
+   are all clear. It is never written. */
+extern mem_t zero_page;
+
 #define N_PAGES   256  /* 1 Mword address space */
-extern mem_t *mem[N_PAGES];
+/* mem[] is part of the machine context (machine.h) */
 
 #define MNULL  (mem_t *) 0
 
@@ -0,0 +1,477 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : profile.c -- flat execution profiler                        */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* profile.c  --  flat execution profile.
+
+   While profiling is on, execute() counts the instructions executed
+   and the cycles they took (as given by stime.h) per physical address.
+   The counts are kept per page of memory in machine->prof[], allocated
+   as code in a page is first executed.
+
+   The report attributes each address to the nearest label at or below
+   it -- for code, normally the function containing it -- using the
+   symbol index of the file last loaded (COFF or Tek hex, see symtab.c),
+   and lists these by the cycles spent in them.
+
+   For the call graph, a shadow call stack follows the control flow:
+   SJS and JS push a frame, as does the entry of an interrupt (BEX
+   included, since it enters its handler as an interrupt does), and
+   URS, LST and LSTI pop one. A frame popped or still open adds its
+   count and the cycles and instructions executed since it was pushed
+   (the inclusive cost) to the arc from the call site to the callee.
+   A routine called with JS normally returns with JS/BR to the word
+   after the call, so a JS frame also ends when execution gets there.
+   "profile callgrind" writes the flat counts and the arcs in the
+   format of callgrind, for KCachegrind and callgrind_annotate; the
+   exclusive cost of a function is the flat count of its addresses.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "status.h"
+#include "utils.h"
+#include "loadfile.h"
+#include "machine.h"
+#include "smemacc.h"
+#include "profile.h"
+
+THREAD_LOCAL bool profiling = FALSE;
+
+#define MAX_DEPTH   1024
+#define ARC_BUCKETS 1024
+
+struct frame
+  {
+    ulong site, callee, ret;	/* physical addresses */
+    ulong cycles, count;	/* running totals when pushed */
+    int   kind;			/* PROF_SJS, PROF_JS or PROF_INTR */
+  };
+
+struct arc
+  {
+    struct arc *next;
+    ulong site, callee;
+    ulong calls, cycles, count;
+  };
+
+static THREAD_LOCAL struct frame stack[MAX_DEPTH];
+static THREAD_LOCAL int   depth, overflow;  /* frames beyond MAX_DEPTH */
+static THREAD_LOCAL bool  site_pending, pop_pending;
+static THREAD_LOCAL ulong total_cycles, total_count, last_phys;
+static THREAD_LOCAL struct arc **arcs;
+
+struct func
+  {
+    char  *name;		/* in the symbol index, see func_name() */
+    ulong count, cycles;
+  };
+
+
+static void
+add_arc (ulong site, ulong callee, ulong calls, ulong cycles, ulong count)
+{
+  unsigned h = (unsigned) ((site * 31 + callee) % ARC_BUCKETS);
+  struct arc *a;
+
+  if (arcs == (struct arc **) 0)
+    {
+      arcs = (struct arc **) calloc (ARC_BUCKETS, sizeof (struct arc *));
+      if (arcs == (struct arc **) 0)
+	problem ("profile: no memory for the call graph");
+    }
+  for (a = arcs[h]; a != (struct arc *) 0; a = a->next)
+    if (a->site == site && a->callee == callee)
+      break;
+  if (a == (struct arc *) 0)
+    {
+      if ((a = (struct arc *) calloc (1, sizeof (struct arc))) == 0)
+	problem ("profile: no memory for the call graph");
+      a->site = site;
+      a->callee = callee;
+      a->next = arcs[h];
+      arcs[h] = a;
+    }
+  a->calls += calls;
+  a->cycles += cycles;
+  a->count += count;
+}
+
+
+static void
+pop_frame (void)
+{
+  struct frame *f;
+
+  if (overflow > 0)
+    overflow--;
+  else if (depth > 0)
+    {
+      f = &stack[--depth];
+      add_arc (f->site, f->callee, 1, total_cycles - f->cycles,
+	       total_count - f->count);
+    }
+}
+
+
+/* Called by ex_sjs() and ex_js() after setting the new IC, and by
+   workout_interrupts() after switching to the interrupt context. The
+   call site of SJS and JS is filled in when their execution is counted
+   by profile_insn(); that of an interrupt is the instruction counted
+   last. */
+
+void
+profile_call (int kind)
+{
+  struct frame *f;
+
+  if (depth == MAX_DEPTH)
+    {
+      overflow++;
+      return;
+    }
+  f = &stack[depth++];
+  f->kind = kind;
+  f->callee = get_phys_address (CODE, simreg.sw & 0x000F, simreg.ic);
+  if (kind == PROF_INTR)
+    {
+      f->site = last_phys;
+      f->cycles = total_cycles;
+      f->count = total_count;
+    }
+  else
+    site_pending = TRUE;
+}
+
+
+/* Called by ex_urs(), ex_lst() and ex_lsti(); the frame is popped
+   once the returning instruction has been counted */
+
+void
+profile_return (void)
+{
+  pop_pending = TRUE;
+}
+
+
+/* Called by execute() after each instruction */
+
+void
+profile_insn (ulong phys_address, int cycles)
+{
+  struct prof_page **pp = &machine->prof[(unsigned) (phys_address >> 12)];
+  unsigned offset = (unsigned) phys_address & 0x0FFF;
+  struct frame *f;
+
+  while (depth > 0 && overflow == 0 && ! site_pending
+	 && stack[depth - 1].kind == PROF_JS
+	 && stack[depth - 1].ret == phys_address)
+    pop_frame ();
+
+  if (*pp == (struct prof_page *) 0)
+    {
+      *pp = (struct prof_page *) calloc (1, sizeof (struct prof_page));
+      if (*pp == (struct prof_page *) 0)
+	problem ("profile: no memory for execution counts");
+    }
+  (*pp)->count[offset]++;
+  (*pp)->cycles[offset] += (ulong) cycles;
+  total_cycles += (ulong) cycles;
+  total_count++;
+
+  if (site_pending)
+    {
+      f = &stack[depth - 1];
+      f->site = phys_address;
+      f->ret = phys_address + 2;
+      f->cycles = total_cycles;
+      f->count = total_count;
+      site_pending = FALSE;
+    }
+  if (pop_pending)
+    {
+      pop_frame ();
+      pop_pending = FALSE;
+    }
+  last_phys = phys_address;
+}
+
+
+void
+profile_release (struct machine *m)
+{
+  int i;
+
+  for (i = 0; i < N_PAGES; i++)
+    if (m->prof[i] != (struct prof_page *) 0)
+      {
+	free ((void *) m->prof[i]);
+	m->prof[i] = (struct prof_page *) 0;
+      }
+}
+
+
+/* Forget the call graph */
+
+static void
+clear_graph (void)
+{
+  struct arc *a;
+  int i;
+
+  if (arcs != (struct arc **) 0)
+    {
+      for (i = 0; i < ARC_BUCKETS; i++)
+	while ((a = arcs[i]) != (struct arc *) 0)
+	  {
+	    arcs[i] = a->next;
+	    free ((void *) a);
+	  }
+    }
+  depth = overflow = 0;
+  site_pending = pop_pending = FALSE;
+  total_cycles = total_count = last_phys = 0;
+}
+
+
+static int
+by_cycles (const void *a, const void *b)
+{
+  ulong x = ((const struct func *) a)->cycles;
+  ulong y = ((const struct func *) b)->cycles;
+
+  return (x > y) ? -1 : (x < y);
+}
+
+
+#define PROF_END  ((ulong) N_PAGES << 12)
+
+/* The lowest address at or above `address' that has a count, or
+   PROF_END if there is none */
+
+static ulong
+next_counted (ulong address)
+{
+  for (; address < PROF_END; address++)
+    {
+      struct prof_page *p = machine->prof[(unsigned) (address >> 12)];
+
+      if (p == (struct prof_page *) 0)
+	address |= 0x0FFF;
+      else if (p->count[(unsigned) address & 0x0FFF] != 0)
+	return address;
+    }
+  return PROF_END;
+}
+
+
+/* The function containing `address', i.e. the nearest label at or below
+   it in the symbol index of the file last loaded. The name stays valid
+   until the next load. */
+
+static char *
+func_name (ulong address)
+{
+  ulong offset;
+  char *name = find_nearest_label (address, &offset);
+
+  return (name != NULL) ? name : "(no label)";
+}
+
+
+static int
+profile_report (int max_lines)
+{
+  struct func *func = (struct func *) 0, *f;
+  int i, n_funcs = 0, n_allocated = 0;
+  ulong address, total_count = 0, total_cycles = 0;
+  char *name;
+
+  /* A function covers the addresses from its label up to the next one,
+     so in address order its counts come in one run */
+  for (address = next_counted (0); address < PROF_END;
+       address = next_counted (address + 1))
+    {
+      struct prof_page *p = machine->prof[(unsigned) (address >> 12)];
+      unsigned offset = (unsigned) address & 0x0FFF;
+
+      name = func_name (address);
+      if (n_funcs == 0 || func[n_funcs - 1].name != name)
+	{
+	  if (n_funcs == n_allocated)
+	    {
+	      n_allocated = n_allocated ? 2 * n_allocated : 64;
+	      f = (struct func *) realloc (func, n_allocated
+						 * sizeof (struct func));
+	      if (f == (struct func *) 0)
+		{
+		  free ((void *) func);
+		  return error ("no memory for the profile report");
+		}
+	      func = f;
+	    }
+	  f = &func[n_funcs++];
+	  f->name = name;
+	  f->count = f->cycles = 0;
+	}
+      f->count += p->count[offset];
+      f->cycles += p->cycles[offset];
+      total_count += p->count[offset];
+      total_cycles += p->cycles[offset];
+    }
+
+  qsort (func, n_funcs, sizeof (struct func), by_cycles);
+  lprintf ("\t      Cycles      %%  Instructions  Function\n");
+  for (i = 0; i < n_funcs && i < max_lines; i++)
+    lprintf ("\t%12lu %6.2f  %12lu  %s\n", func[i].cycles,
+	     100.0 * func[i].cycles / total_cycles, func[i].count,
+	     func[i].name);
+  lprintf ("\t%12lu 100.00  %12lu  total\n", total_cycles, total_count);
+
+  free ((void *) func);
+  return (OKAY);
+}
+
+
+static int
+by_site (const void *a, const void *b)
+{
+  ulong x = (*(struct arc * const *) a)->site;
+  ulong y = (*(struct arc * const *) b)->site;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+
+/* Write the profile in callgrind format. Costs are given per physical
+   address (positions: instr), and a call is listed under the function
+   containing its call site. Costs and call sites are walked together in
+   address order, and an fn= line starts each function on the way. */
+
+static int
+write_callgrind (char *filename)
+{
+  struct arc **arc, *a;
+  FILE *fp;
+  int i, n_arcs = 0, ai = 0;
+  ulong address, site;
+  char *name, *fn = NULL;
+
+  if ((fp = fopen (filename, "w")) == (FILE *) 0)
+    return error ("cannot create %s", filename);
+
+  /* Open frames count as far as they have got */
+  for (i = 0; i < depth; i++)
+    add_arc (stack[i].site, stack[i].callee, 1,
+	     total_cycles - stack[i].cycles, total_count - stack[i].count);
+  for (i = 0; arcs != (struct arc **) 0 && i < ARC_BUCKETS; i++)
+    for (a = arcs[i]; a != (struct arc *) 0; a = a->next)
+      n_arcs++;
+  arc = (struct arc **) malloc ((n_arcs + 1) * sizeof (struct arc *));
+  if (arc == (struct arc **) 0)
+    {
+      fclose (fp);
+      return error ("no memory for the call graph");
+    }
+  for (i = 0, n_arcs = 0; arcs != (struct arc **) 0 && i < ARC_BUCKETS; i++)
+    for (a = arcs[i]; a != (struct arc *) 0; a = a->next)
+      arc[n_arcs++] = a;
+  qsort (arc, n_arcs, sizeof (struct arc *), by_site);
+
+  fprintf (fp, "# callgrind format\nversion: 1\ncreator: sim1750\n");
+  fprintf (fp, "positions: instr\nevents: Cycles Instructions\n");
+  fprintf (fp, "summary: %lu %lu\n", total_cycles, total_count);
+
+  address = next_counted (0);
+  while (address < PROF_END || ai < n_arcs)
+    {
+      site = (ai < n_arcs) ? arc[ai]->site : PROF_END;
+      name = func_name ((address < site) ? address : site);
+      if (name != fn)
+	fprintf (fp, "\nfn=%s\n", fn = name);
+      if (address <= site)
+	{
+	  struct prof_page *p = machine->prof[(unsigned) (address >> 12)];
+	  unsigned offset = (unsigned) address & 0x0FFF;
+
+	  fprintf (fp, "0x%05lX %lu %lu\n", address,
+		   p->cycles[offset], p->count[offset]);
+	  address = next_counted (address + 1);
+	}
+      else
+	{
+	  a = arc[ai++];
+	  fprintf (fp, "cfn=%s\ncalls=%lu 0x%05lX\n0x%05lX %lu %lu\n",
+		   func_name (a->callee), a->calls, a->callee,
+		   a->site, a->cycles, a->count);
+	}
+    }
+
+  for (i = 0; i < depth; i++)
+    add_arc (stack[i].site, stack[i].callee, (ulong) -1,
+	     stack[i].cycles - total_cycles, stack[i].count - total_count);
+  free ((void *) arc);
+  if (fclose (fp) != 0)
+    return error ("error writing %s", filename);
+  info ("Call graph written to %s", filename);
+  return (OKAY);
+}
+
+
+int
+si_profile (int argc, char *argv[])
+{
+  int max_lines = 20;
+
+  if (argc == 1)
+    {
+      info ("Profiling is %s", profiling ? "on" : "off");
+      return (OKAY);
+    }
+  if (eq (argv[1], "on"))
+    {
+      profile_release (machine);
+      clear_graph ();
+      profiling = TRUE;
+    }
+  else if (eq (argv[1], "off"))
+    profiling = FALSE;
+  else if (eq (argv[1], "report"))
+    {
+      if (argc > 2 && sscanf (argv[2], "%d", &max_lines) != 1)
+	return error ("invalid number of lines");
+      return profile_report (max_lines);
+    }
+  else if (eq (argv[1], "callgrind"))
+    {
+      if (argc < 3)
+	return error ("callgrind needs a file name");
+      return write_callgrind (argv[2]);
+    }
+  else
+    return error ("invalid argument -- must be ON, OFF, REPORT or CALLGRIND");
+  return (OKAY);
+}
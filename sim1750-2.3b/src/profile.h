@@ -0,0 +1,21 @@
+/* profile.h -- exports of profile.c */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "machine.h"
+
+/* Kinds of call for profile_call() */
+#define PROF_SJS   0
+#define PROF_JS    1
+#define PROF_INTR  2
+
+extern THREAD_LOCAL bool profiling;
+
+extern void profile_insn (ulong phys_address, int cycles);
+extern void profile_call (int kind);
+extern void profile_return (void);
+extern void profile_release (struct machine *m);
+extern int  si_profile (int argc, char *argv[]);
+
+#endif
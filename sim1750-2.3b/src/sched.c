@@ -0,0 +1,122 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : Cycle based event scheduler                                 */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* sched.c  --  cycle based event queue.
+
+   Time advances only as instructions are executed: the CPU adds the
+   cycles of each instruction to sched_now and compares it against
+   sched_deadline, the cycle of the earliest armed event. Only when the
+   deadline is reached does sched_run() look at the queue and call the
+   handlers that are due.
+
+   Events are registered once (sched_register) and then armed relative
+   to the current time with sched_at(). A handler is disarmed before it
+   is called and may re-arm itself. The timers and the GO watchdog in
+   cpu.c use one event; device models can register their own.
+ */
+
+#include "sched.h"
+#include "utils.h"
+
+/* Deadline used when nothing is armed. Must stay below half the range
+   of ulong so that SCHED_DUE() keeps working across the wrap. */
+#define NEVER  0x7FFFFFFFL
+
+#define queue     (machine->events)
+#define n_events  (machine->n_events)
+
+
+static void
+find_deadline (void)
+{
+  int i;
+
+  sched_deadline = sched_now + NEVER;
+  for (i = 0; i < n_events; i++)
+    if (queue[i].armed && (long) (queue[i].when - sched_deadline) < 0)
+      sched_deadline = queue[i].when;
+}
+
+
+/* Returns the number by which the event is armed and cancelled,
+   or -1 if the queue is full. */
+
+int
+sched_register (void (*handler) (void))
+{
+  if (n_events >= MAX_EVENTS)
+    {
+      problem ("sched_register: too many events");
+      return -1;
+    }
+  queue[n_events].handler = handler;
+  queue[n_events].armed = FALSE;
+  return n_events++;
+}
+
+
+void
+sched_at (int event, ulong delay_in_cycles)
+{
+  if (event < 0 || event >= n_events)
+    return;
+  if (delay_in_cycles > NEVER)
+    delay_in_cycles = NEVER;
+  queue[event].when = sched_now + delay_in_cycles;
+  queue[event].armed = TRUE;
+  find_deadline ();
+}
+
+
+void
+sched_cancel (int event)
+{
+  if (event < 0 || event >= n_events)
+    return;
+  queue[event].armed = FALSE;
+  find_deadline ();
+}
+
+
+/* Call the handlers of all events that are due, earliest first. */
+
+void
+sched_run (void)
+{
+  int i, next;
+
+  for (;;)
+    {
+      next = -1;
+      for (i = 0; i < n_events; i++)
+	if (queue[i].armed && (long) (sched_now - queue[i].when) >= 0
+	    && (next < 0 || (long) (queue[i].when - queue[next].when) < 0))
+	  next = i;
+      if (next < 0)
+	break;
+      queue[next].armed = FALSE;
+      (*queue[next].handler) ();
+    }
+  find_deadline ();
+}
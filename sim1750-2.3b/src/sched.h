@@ -0,0 +1,21 @@
+/* sched.h -- exports of sched.c */
+
+#ifndef _SCHED_H
+#define _SCHED_H
+
+#include "machine.h"
+
+/* Simulated time in processor cycles. Both values wrap around; they are
+   only ever compared through SCHED_DUE(). The queue is part of the
+   machine context. */
+#define sched_now       (machine->sched_now)
+#define sched_deadline  (machine->sched_deadline) /* earliest armed event */
+
+#define SCHED_DUE()  ((long) (sched_now - sched_deadline) >= 0)
+
+extern int  sched_register (void (*handler) (void));
+extern void sched_at (int event, ulong delay_in_cycles);
+extern void sched_cancel (int event);
+extern void sched_run (void);
+
+#endif
@@ -10,7 +10,7 @@ extern int dism1750 (char *, ushort *);
 char *
 disassemble ()
 {
-  static char disasm_text[80];
+  static THREAD_LOCAL char disasm_text[80];
   ushort words[2], as = simreg.sw & 0xF;
   get_raw (CODE, as, simreg.ic, &words[0]);
   if (simreg.ic < 0xFFFF)
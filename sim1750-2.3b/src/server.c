@@ -0,0 +1,167 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : server.c -- fork server for mass test execution             */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* server.c  --  run many short test cases from one warm machine.
+
+   With the -F <socket> option, sim1750 loads the image given by -c, -l
+   or -t and runs it up to a marker: the label or address given by the
+   -u option (see the BREAK command), or else the next BPT instruction.
+   It then listens on the Unix domain socket <socket>.
+
+   For each connection, a child process is forked from this warm state.
+   The child reads interpreter commands from the connection, which is
+   also its console input for XIO, and writes all output back to it.
+   It exits on QUIT or at the end of its input, which closes the
+   connection. Thus a client sends e.g. "cmem 8100 ...", "go", "dr" and
+   reads the result until end of file. Each test case starts from the
+   same state without loading or booting, and the copy-on-write fork of
+   the host keeps the test cases apart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "type.h"
+#include "status.h"
+#include "cmd.h"
+#include "cpu.h"
+#include "break.h"
+#include "exec.h"
+#include "server.h"
+
+#if defined (__unix__)
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+/* Run to the marker. Returns OKAY if it was reached. */
+
+static int
+warm_up (char *marker)
+{
+  char *f_argv[3];
+  int reached;
+
+  f_argv[0] = NULL;
+  f_argv[2] = NULL;
+  if (marker != NULL)
+    {
+      f_argv[1] = marker;
+      if (si_brkset (2, f_argv) != OKAY)
+	return ERROR;
+    }
+  si_go (1, f_argv);
+  if (marker == NULL)
+    return OKAY;
+  reached = (bpindex >= 0);
+  f_argv[1] = "*";
+  si_brkclear (2, f_argv);
+  if (! reached)
+    return error ("marker %s not reached", marker);
+  return OKAY;
+}
+
+
+/* Child side: one test case */
+
+static int
+serve (int conn)
+{
+  FILE *input, *output;
+  int fd;
+
+  if ((fd = dup (conn)) < 0
+      || (input = fdopen (conn, "r")) == NULL
+      || (output = fdopen (fd, "w")) == NULL)
+    return EXIT_FAILURE;
+  console_in = input;
+  console_out = output;
+  batch_interpreter (input, NULL);
+  fflush (output);
+  return EXIT_SUCCESS;
+}
+
+
+int
+fork_server (char *socket_path, char *marker)
+{
+  struct sockaddr_un addr;
+  int listener, conn;
+
+  if (strlen (socket_path) >= sizeof (addr.sun_path))
+    return error ("socket path too long: %s", socket_path);
+  if (warm_up (marker) != OKAY)
+    return ERROR;
+
+  memset ((void *) &addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, socket_path);
+  unlink (socket_path);
+  if ((listener = socket (AF_UNIX, SOCK_STREAM, 0)) < 0
+      || bind (listener, (struct sockaddr *) &addr, sizeof (addr)) < 0
+      || listen (listener, 64) < 0)
+    return error ("cannot listen on %s", socket_path);
+
+  signal (SIGCHLD, SIG_IGN);	/* no zombies */
+  int_handler_install (1);	/* the server ends on SIGINT or SIGTERM */
+  info ("fork server ready at %s, IC %04hX", socket_path, simreg.ic);
+
+  while (1)
+    {
+      if ((conn = accept (listener, (struct sockaddr *) 0, 0)) < 0)
+	{
+	  if (errno == EINTR || errno == ECONNABORTED)
+	    continue;
+	  break;
+	}
+      fflush (NULL);		/* or the children would repeat it */
+      switch (fork ())
+	{
+	case 0:
+	  close (listener);
+	  exit (serve (conn));
+	case -1:
+	  warning ("fork server: cannot fork");
+	}
+      close (conn);
+    }
+  close (listener);
+  return error ("fork server: accept failed");
+}
+
+#else  /* not Unix */
+
+int
+fork_server (char *socket_path, char *marker)
+{
+  return error ("the fork server is not available on this host");
+}
+
+#endif
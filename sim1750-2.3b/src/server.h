@@ -0,0 +1,8 @@
+/* server.h -- exports of server.c */
+
+#ifndef _SERVER_H
+#define _SERVER_H
+
+extern int fork_server (char *socket_path, char *marker);
+
+#endif
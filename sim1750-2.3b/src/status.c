@@ -34,29 +34,33 @@
 
 #include "status.h"
 
-FILE *logfile;  /* opening and closing of the logfile done elsewhere */
+THREAD_LOCAL FILE *logfile;  /* opening and closing done elsewhere */
+THREAD_LOCAL FILE *console_out;  /* lprintf() output; stdout if NULL */
+THREAD_LOCAL FILE *console_in;   /* console input of XIO; stdin if NULL */
 
 void 
 lprintf (char *layout, ...)
 {
   va_list vargu;
-  char output_line[132];
 
+  /* straight to the streams: a line may be longer than any buffer here,
+     e.g. a symbol name from the COFF string table */
   va_start (vargu, layout);
-
-  vsprintf (output_line, layout, vargu);
-  printf ("%s", output_line);
+  vfprintf (CONSOLE_OUT, layout, vargu);
+  va_end (vargu);
 
   if (logfile != (FILE *) 0)
-    fprintf (logfile, "%s", output_line);
-
-  va_end (vargu);
+    {
+      va_start (vargu, layout);
+      vfprintf (logfile, layout, vargu);
+      va_end (vargu);
+    }
 
   return;
 }
 
 
-char global_message[1024];
+THREAD_LOCAL char global_message[1024];
 
 /* The below functions fill the global_message buffer, and return
    a status value that is apppropriate for the message class
@@ -15,15 +15,18 @@
 #define QUIT        -999
 
 /* exports */
-extern FILE  *logfile;
+extern THREAD_LOCAL FILE *logfile;
+extern THREAD_LOCAL FILE *console_out, *console_in;
+#define CONSOLE_OUT  (console_out != (FILE *) 0 ? console_out : stdout)
+#define CONSOLE_IN   (console_in != (FILE *) 0 ? console_in : stdin)
 extern void  lprintf (char *layout, ...);   /* printf with logfile output */
 extern int   info (char *layout, ...);
 extern int   warning (char *layout, ...);
 extern int   error (char *layout, ...);
-extern char  global_message[];
+extern THREAD_LOCAL char global_message[];
 
 /* command line switches of global relevance (defined in main.c) */
-extern bool verbose;
-extern bool need_speed;
+extern THREAD_LOCAL bool verbose;
+extern THREAD_LOCAL bool need_speed;
 
 #endif
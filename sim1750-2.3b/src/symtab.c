@@ -0,0 +1,207 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : symtab.c -- symbol index of the file last loaded            */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* symtab.c  --  symbol index of the file last loaded.
+
+   The loaders add the labels of a file with sym_add(), in the order of
+   the file. Lookups go through two indexes, built on the first lookup
+   after a change: a hash table of the names, chained through the
+   entries, and the entries sorted by address for binary search. A
+   name defined more than once is found as the first one added; of the
+   labels at one address, the last one added is given. These are the
+   rules the linear searches in tekops.c used to follow.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "type.h"
+#include "utils.h"
+#include "symtab.h"
+
+struct sym_entry
+  {
+    char  *name;
+    ulong  address;
+    long   next;		/* in the hash chain, or -1 */
+  };
+
+static THREAD_LOCAL struct sym_entry *entry = (struct sym_entry *) 0;
+static THREAD_LOCAL long n_entries = 0, n_allocated = 0;
+
+static THREAD_LOCAL long *bucket = (long *) 0;	/* first entry, or -1 */
+static THREAD_LOCAL long *by_address = (long *) 0;
+static THREAD_LOCAL ulong n_buckets = 0;
+static THREAD_LOCAL bool indexed = FALSE;
+
+
+static ulong
+hash (char *name)
+{
+  ulong h = 0;
+
+  while (*name)
+    h = h * 31 + (unsigned char) *name++;
+  return h;
+}
+
+
+void
+sym_reset (void)
+{
+  while (n_entries > 0)
+    free ((void *) entry[--n_entries].name);
+  indexed = FALSE;
+}
+
+
+void
+sym_add (char *name, ulong address)
+{
+  if (n_entries == n_allocated)
+    {
+      n_allocated = n_allocated ? 2 * n_allocated : 256;
+      entry = (struct sym_entry *) realloc (entry, n_allocated
+						   * sizeof (struct sym_entry));
+      if (entry == (struct sym_entry *) 0)
+	problem ("symtab: request for symbol space refused by OS");
+    }
+  if ((entry[n_entries].name = strdup (name)) == (char *) 0)
+    problem ("symtab: request for symbol space refused by OS");
+  entry[n_entries].address = address;
+  n_entries++;
+  indexed = FALSE;
+}
+
+
+/* Order by address, and by the order of adding at the same address */
+
+static int
+by_entry_address (const void *a, const void *b)
+{
+  long i = *(const long *) a, k = *(const long *) b;
+
+  if (entry[i].address != entry[k].address)
+    return (entry[i].address < entry[k].address) ? -1 : 1;
+  return (i < k) ? -1 : (i > k);
+}
+
+static void
+build_index (void)
+{
+  long i;
+  ulong h;
+
+  if (n_buckets < (ulong) n_entries)
+    {
+      for (n_buckets = 256; n_buckets < (ulong) n_entries; n_buckets <<= 1)
+	;
+      free ((void *) bucket);
+      bucket = (long *) malloc (n_buckets * sizeof (long));
+    }
+  free ((void *) by_address);
+  by_address = (long *) malloc ((n_entries + 1) * sizeof (long));
+  if (bucket == (long *) 0 || by_address == (long *) 0)
+    problem ("symtab: request for index space refused by OS");
+
+  for (h = 0; h < n_buckets; h++)
+    bucket[h] = -1;
+  /* Backwards, so that the first of equal names heads its chain */
+  for (i = n_entries - 1; i >= 0; i--)
+    {
+      h = hash (entry[i].name) & (n_buckets - 1);
+      entry[i].next = bucket[h];
+      bucket[h] = i;
+      by_address[i] = i;
+    }
+  qsort (by_address, n_entries, sizeof (long), by_entry_address);
+  indexed = TRUE;
+}
+
+
+long
+sym_address (char *name)
+{
+  long i;
+
+  if (n_entries == 0)
+    return -1L;
+  if (! indexed)
+    build_index ();
+  for (i = bucket[hash (name) & (n_buckets - 1)]; i >= 0; i = entry[i].next)
+    if (eq (name, entry[i].name))
+      return (long) entry[i].address;
+  return -1L;
+}
+
+
+/* The label at or below `address' nearest to it, and the offset of
+   `address' from that label; NULL if there is no label that low */
+
+char *
+sym_nearest (ulong address, ulong *offset)
+{
+  long lo = 0, hi = n_entries - 1, mid;
+  struct sym_entry *e;
+
+  if (n_entries == 0)
+    return NULL;
+  if (! indexed)
+    build_index ();
+  if (entry[by_address[0]].address > address)
+    return NULL;
+  while (lo < hi)
+    {
+      mid = (lo + hi + 1) / 2;
+      if (entry[by_address[mid]].address <= address)
+	lo = mid;
+      else
+	hi = mid - 1;
+    }
+  e = &entry[by_address[lo]];
+  *offset = address - e->address;
+  return e->name;
+}
+
+
+char *
+sym_label (ulong address)
+{
+  ulong offset;
+  char *name = sym_nearest (address, &offset);
+
+  return (name != NULL && offset == 0) ? name : NULL;
+}
+
+
+/* The n-th label added, or NULL if there are not that many */
+
+char *
+sym_nth (long n, ulong *address)
+{
+  if (n < 0 || n >= n_entries)
+    return NULL;
+  *address = entry[n].address;
+  return entry[n].name;
+}
@@ -0,0 +1,15 @@
+/* symtab.h -- exports of symtab.c */
+
+#ifndef _SYMTAB_H
+#define _SYMTAB_H
+
+#include "type.h"
+
+extern void  sym_reset (void);
+extern void  sym_add (char *name, ulong address);
+extern long  sym_address (char *name);
+extern char *sym_label (ulong address);
+extern char *sym_nearest (ulong address, ulong *offset);
+extern char *sym_nth (long n, ulong *address);
+
+#endif
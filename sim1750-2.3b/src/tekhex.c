@@ -45,43 +45,65 @@ extern status error (char *layout,...);
 #define elsecase   break; case
 #endif
 
+/* Values of the characters of a line for the checksum, -1 if illegal:
+   0-9 are 0..9, A-Z 10..35, $ % . _ 36..39 and a-z 40..65 */
+static const signed char tek_value[256] =
+  {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, 36, 37, -1, -1, -1, -1, -1, -1, -1, -1, 38, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24,
+    25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, -1, -1, -1, -1, 39,
+    -1, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54,
+    55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+  };
+
+
+/* Checksum of the `len' characters following the '%' of a line, not
+   counting the checksum field (the 4th and 5th of them). Returns -1 if
+   there is an illegal character, whose position is put to *bad. */
+
 int
-check_tekline (char *line)
+tek_checksum (char *chars, int len, int *bad)
 {
-  int i, tekval, len = strlen (line) - 1, chksum = 0;
-  char *p = line + 1;
+  int i, sum = 0, val;
 
-  for (i = 1; i < len; i++, p++)
+  for (i = 0; i < len; i++)
     {
-      if (i != 4 && i != 5)	/* else skip checksum */
+      if (i == 3)
+	i = 5;			/* skip the checksum */
+      if (i >= len)
+	break;
+      if ((val = tek_value[(unsigned char) chars[i]]) < 0)
 	{
-	  if (isdigit (*p))
-	    tekval = *p - '0';
-	  else if (isupper (*p))
-	    tekval = *p - 'A' + 10;
-	  else if (islower (*p))
-	    tekval = *p - 'a' + 40;
-	  else
-	    {
-	      switch (*p)
-		{
-		case '$':
-		  tekval = 36;
-		elsecase '%':
-		  tekval = 37;
-		elsecase '.':
-		  tekval = 38;
-		elsecase '_':
-		  tekval = 39;
-		  break;
-		default:
-		  return error ("illegal character '%c' in tekhex line", *p);
-		}
-	    }
-	  chksum += tekval;
+	  *bad = i;
+	  return -1;
 	}
+      sum += val;
     }
-  return (chksum & 0xff);
+  return sum & 0xff;
+}
+
+
+int
+check_tekline (char *line)
+{
+  int bad, len = strlen (line) - 2, chksum;
+
+  if (len < 0)
+    return 0;
+  if ((chksum = tek_checksum (line + 1, len, &bad)) < 0)
+    return error ("illegal character '%c' in tekhex line", line[1 + bad]);
+  return chksum;
 }
 
 
@@ -92,10 +114,10 @@ put_xnum (char **p, ushort num)
   *p += 4;
 }
 
-static FILE *fp;
-static char tekline[128];
-static char *linep;
-static bool is_new_line;
+static THREAD_LOCAL FILE *fp;
+static THREAD_LOCAL char tekline[128];
+static THREAD_LOCAL char *linep;
+static THREAD_LOCAL bool is_new_line;
 #define DATASTART 12
 
 void
@@ -119,7 +141,7 @@ finish_tekline ()
 void
 emit_tekword (ulong startaddr, ushort word)
 {
-  static ulong last_addr = 0xEFFFFFFF;	/* any impossible start value */
+  static THREAD_LOCAL ulong last_addr = 0xEFFFFFFF;	/* any impossible start value */
   int n_words = (linep - (tekline + DATASTART)) / 4;
 
   if (startaddr != last_addr + 1 && n_words > 0)
@@ -147,8 +169,8 @@ emit_tekword (ulong startaddr, ushort word)
 #define LOCAL_CODE_ADDRESS	7
 #define LOCAL_DATA_ADDRESS	8
 
-static bool seen_section[4];
-static section_t currsect;
+static THREAD_LOCAL bool seen_section[4];
+static THREAD_LOCAL section_t currsect;
 static const char *sectname[] =
 {"Init", "Normal", "Konst", "Static"};
 
@@ -1,6 +1,7 @@
 /* tekhex.h  --  exports of tekhex.c */
 
 extern int    check_tekline (char *line);
+extern int    tek_checksum (char *chars, int len, int *bad);
 extern void   emit_tekword (unsigned long startaddr, unsigned short word);
 extern void   finish_tekline ();
 extern int    create_tekfile (char *outfname);
@@ -43,9 +43,9 @@
 #include "peekpoke.h"
 #include "loadfile.h"
 #include "tekhex.h"
+#include "symtab.h"
 
 
-extern struct regs simreg;  /* from cpu.c */
 
 /* Internal data */
 
@@ -57,9 +57,9 @@ struct section
     ulong base_addr;
     int   length;
   };
-static struct section section[MAX_SECTIONS];
+static THREAD_LOCAL struct section section[MAX_SECTIONS];
 
-int n_sections = 0;
+THREAD_LOCAL int n_sections = 0;
 
 struct symbol
   {
@@ -114,33 +114,8 @@ init_tekops ()	/* free up previous memory allocations; initialize */
 }
 
 
-long
-find_tek_address (char *labelname)
-{
-  int i;
-
-  for (i = 0; i < symdata.n_used; i++)
-    if (eq (labelname, symdata.sym[i].name))
-      return (long) symdata.sym[i].value;
-  return -1L;
-}
-
-
-char *
-find_tek_label (ulong address)
-{
-  int i = symdata.n_used;
-
-  while (i-- > 0)
-    if (symdata.sym[i].value == address)
-      return symdata.sym[i].name;
-  return NULL;
-}
-
-
-#define x_nib(ch) (isdigit (ch) ? (ch) - '0' :		\
-		   isupper (ch) ? (ch) - ('A' - 10) :	\
-		   islower (ch) ? (ch) - ('a' - 10) : -1)
+/* The line being parsed ends here; get_xnum() does not read beyond */
+static THREAD_LOCAL char *line_end;
 
 static long 
 get_xnum (char **string, int number)
@@ -149,12 +124,14 @@ get_xnum (char **string, int number)
   ulong retval = 0L;
   char *p = *string;
 
+  if (number > line_end - p)
+    return -1L;
   while (number-- > 0)
     {
-      nibble = *p++;
-      if ((nibble = x_nib (nibble)) < 0)
+      if ((nibble = HEX_DIGIT (*p)) < 0)
 	return -1L;
-      retval = (retval << 4) | (ulong) (nibble & 0xF);
+      p++;
+      retval = (retval << 4) | (ulong) nibble;
     }
   *string = p;
   return (retval);
@@ -178,18 +155,51 @@ add_symbol (char *name, int type, ushort value, struct section *section)
   symdata.sym[n].sect = section;
   symdata.sym[n].value = value;
   symdata.n_used++;
+  sym_add (name, (ulong) value);
 }
 
 
-static int linecount;
+static THREAD_LOCAL int linecount;
 
-/* Analyze and load a line from a Tektronix Extended Hex file */
+/* Store the `n' bytes of a data block at byte address `byte_addr'.
+   Whole words go to memory in one write_words(); a byte at either end
+   is merged into the word it belongs to. */
 
-int
-load_tekline (char *line)
+static int
+store_bytes (ulong byte_addr, unsigned char *bytes, int n)
+{
+  ulong address = byte_addr >> 1;
+  ushort value;
+  int status;
+
+  if (n > 0 && (byte_addr & 1))
+    {
+      peek (address, &value);
+      poke (address++, (value & 0xff00) | (ushort) *bytes++);
+      n--;
+    }
+  if ((status = write_words (address, bytes, (ulong) n / 2)) != OKAY)
+    return status;
+  if (n & 1)
+    {
+      address += n / 2;
+      peek (address, &value);
+      poke (address, (value & 0x00ff) | (ushort) (bytes[n - 1] << 8));
+    }
+  return OKAY;
+}
+
+
+/* Analyze and load a line from a Tektronix Extended Hex file.
+   `n_chars' is its length without the newline. */
+
+static int
+load_tekline (char *line, int n_chars)
 {
   char  sectname[32], *linep;
-  int   i, checksum, type, blk_len, addr_len, line_len;
+  unsigned char bytes[128];
+  int   i, checksum, type, blk_len, addr_len, line_len, bad;
+  long  data;
   ulong address;
 
   if (sys_int (1L))
@@ -197,7 +207,8 @@ load_tekline (char *line)
 
   if (line[0] != '%')
     return error ("illegal format");
-  line_len = strlen (line) - 2;
+  line_len = n_chars - 1;
+  line_end = line + n_chars;
   linep = line + 1;
   blk_len = (int) get_xnum (&linep, 2);
   type = (int) get_xnum (&linep, 1);
@@ -208,7 +219,10 @@ load_tekline (char *line)
 
   if (line_len == blk_len)
     {
-      if (checksum != (check_tekline (line) & 0xff))
+      i = tek_checksum (line + 1, line_len, &bad);
+      if (i < 0)
+	error ("illegal character '%c' in tekhex line", line[1 + bad]);
+      if (checksum != (i < 0 ? ERROR : i))
 	info ("checksum error in line %d", linecount);
     }
   else
@@ -216,10 +230,12 @@ load_tekline (char *line)
   switch (type)
     {
     case 3:		/* Symbol */
+      if (addr_len > line_end - linep)
+	return error ("line length error in line %d", linecount);
       strncpy (sectname, linep, addr_len);
       sectname[addr_len] = '\0';
       linep += addr_len;
-      while (linep - line < line_len)
+      while (linep < line_end - 1)
 	{
 	  type = (int) get_xnum (&linep, 1);	/* symbol type */
 	  if (type == 0)	/* section definition */
@@ -235,7 +251,7 @@ load_tekline (char *line)
 	      section[n_sections].length = sectlen;
 	      n_sections++;
 	    }
-	  else			/* symbol definition */
+	  else if (type > 0)	/* symbol definition */
 	    {
 	      int len, val_len;
 	      char sym[40];
@@ -244,6 +260,8 @@ load_tekline (char *line)
 	      len = (int) get_xnum (&linep, 1); /* symbol name length */
 	      if (len == 0)
 		len = 16;
+	      if (len < 0 || len > line_end - linep)
+		return error ("symbol error in line %d", linecount);
 	      strncpy (sym, linep, len);	/* symbol name */
 	      sym[len] = '\0';
 	      linep += len;
@@ -252,33 +270,20 @@ load_tekline (char *line)
 	      /* lprintf ("ELM %s %s %s\n", sym, sectname, linep); */
 	      add_symbol (sym, type, val, &section[n_sections-1]);
 	    }
+	  else
+	    return error ("symbol error in line %d", linecount);
 	}
       break;
 
     case 6:		/* Data */
       address = get_xnum (&linep, addr_len);
-      i = (ushort) address & 0x0001;
-      address >>= 1;
-      while (linep - line < line_len)
+      for (i = 0; linep < line_end; i++)
 	{
-	  ushort value;
-	  if (i)
-	    {
-	      peek (address, &value);
-	      poke (address, (value & 0xff00)
-			   | (ushort) get_xnum (&linep, 2));
-	      i = 0;
-	      address++;
-	    }
-	  else
-	    {
-	      peek (address, &value);
-	      poke (address, (value & 0x00ff)
-			   | (ushort) (get_xnum (&linep, 2) << 8));
-	      i++;
-	    }
+	  if ((data = get_xnum (&linep, 2)) < 0)
+	    return error ("data error in line %d", linecount);
+	  bytes[i] = (unsigned char) data;
 	}
-      break;
+      return store_bytes (address, bytes, i);
 
     case 8:		/* Terminator */
       address = get_xnum (&linep, addr_len);
@@ -291,15 +296,17 @@ load_tekline (char *line)
   return (OKAY);
 }
 
-/* load file in Tektronix Extended Hex format */
+/* load file in Tektronix Extended Hex format.
+   The file is mapped into memory and parsed where it is. */
 
 int
 si_lo (int argc, char *argv[])
 {
-  FILE *fpoint;
   char lline[132], *filename = argv[1];
+  char *file, *line, *end, *newline;
+  ulong size;
   bool verbose_save = verbose;
-  int retval;
+  int retval = OKAY, i;
 
   if (argc <= 1)
     return error ("filename missing");
@@ -309,25 +316,34 @@ si_lo (int argc, char *argv[])
       *filename++ = '\0';
       *(filename + strlen (filename) - 1) = '\0';
     }
-  if ((fpoint = fopen (filename, "r")) == NULL)
+  if ((file = map_file (filename, &size)) == (char *) 0)
   {
     strcat (strcpy (lline, filename), ".hex");
-    if ((fpoint = fopen (lline, "r")) == NULL)
+    if ((file = map_file (lline, &size)) == (char *) 0)
       return error ("cannot open load file '%s'", filename);
   }
   verbose = FALSE;  /* avoid info message from poke() */
+  if (loadfile_type != TEK_HEX)
+    {
+      /* the symbols of earlier TekHex files are still in symdata */
+      sym_reset ();
+      for (i = 0; i < symdata.n_used; i++)
+	sym_add (symdata.sym[i].name, symdata.sym[i].value);
+    }
   loadfile_type = TEK_HEX;
   linecount = 0;
 
-  while (fgets (lline, sizeof (lline), fpoint) != NULL)
+  end = file + size;
+  for (line = file; line < end && retval == OKAY; line = newline + 1)
     {
+      if ((newline = (char *) memchr (line, '\n', end - line)) == 0)
+	newline = end;
       ++linecount;
-      if (strlen (lline) < 2)
+      if (newline - line < 1)
 	continue;
-      if ((retval = load_tekline (lline)) != OKAY)
-	break;
+      retval = load_tekline (line, (int) (newline - line));
     }
-  fclose (fpoint);
+  unmap_file (file, size);
   verbose = verbose_save;
   return retval;
 }
@@ -354,7 +370,7 @@ display_tek_symbols ()
 	  lprintf ("-------------------------------------------------------\n");
 	  lprintf ("Symbolname           Value Type                 Section\n");
 	}
-      lprintf ("%-20s %l05X %-20s %s\n", symdata.sym[i].name,
+      lprintf ("%-20s %05lX %-20s %s\n", symdata.sym[i].name,
 		symdata.sym[i].value, typename[symdata.sym[i].type],
 		symdata.sym[i].sect->name);
     }
@@ -380,7 +396,7 @@ si_save (int argc, char *argv[])
 	continue;
       for (locndx = 0; locndx < 4096; locndx++)
 	{
-	  if (memptr->was_written[locndx / 32] & (1L << (locndx % 32)))
+	  if (memptr->was_written[PAGE_MAP_INDEX (locndx)] & PAGE_MAP_BIT (locndx))
 	    emit_tekword (phys_address + locndx, memptr->word[locndx]);
 	}
     }
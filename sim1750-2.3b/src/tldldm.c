@@ -34,13 +34,15 @@
 #include <string.h>
 
 #include "status.h"
-#include "peekpoke.h"
+#include "phys_mem.h"
 #include "arch.h"
 #include "utils.h"
 #include "loadfile.h"
+#include "symtab.h"
+#include "cpu.h"		/* for mmu_changed() */
 
 
-static int linecnt;
+static THREAD_LOCAL int linecnt;
 
 #define COMMAND    1
 #define ADDRESS    2
@@ -48,7 +50,20 @@ static int linecnt;
 #define CHECKSUM   8
 #define DATASTART 12
 
-#define get_word(str)   get_nibbles(str,4)
+/* The line being parsed ends here. Fields are read where they are in
+   the mapped file, so field() checks that they lie within the line. */
+static THREAD_LOCAL char *line_end;
+
+static long
+field (char *p, int n_nibbles)
+{
+  if (n_nibbles > line_end - p)
+    return -1L;
+  return get_nibbles (p, n_nibbles);
+}
+
+#define get_word(str)   field(str,4)
+#define get_digit(str)  ((int) field(str,1))
 
 static int
 rotl16 (int num, int n_shifts)	/* Rotate-left a 16 bit word */
@@ -85,7 +100,7 @@ check_ldmline (char *line)
       code = 0xA;
       break;
     case 'L':
-      code = 0xA + (*(line + 5) - '0');		/* Instruction => 0xA, Oprnd => 0xB */
+      code = 0xA + get_digit (line + 5);	/* Instruction => 0xA, Oprnd => 0xB */
       break;
     case 'Q':
       code = 0xB;
@@ -116,7 +131,7 @@ check_ldmline (char *line)
   code <<= 1;
   if (address_field_used)
     {
-      int addr_hinibble = xtoi (line[ADDRESS]);
+      int addr_hinibble = get_digit (line + ADDRESS);
       long addr16 = get_word (line + ADDRESS + 1);
       if (addr16 == -1L)
 	return error ("ldm: illegal char in address field");
@@ -126,7 +141,7 @@ check_ldmline (char *line)
       if (cmd_m_c_t)
 	code = rotl16 (code, 1) ^ addr_hinibble;
     }
-  if ((datacnt = xtoi (line[COUNT])) == -1)
+  if ((datacnt = get_digit (line + COUNT)) == -1)
     return error ("ldm: illegal character in data count");
   for (i = 0; i < datacnt; i++)
     {
@@ -139,15 +154,37 @@ check_ldmline (char *line)
   return code;
 }
 
-/* Analyze and load a line from a TLD Load Module file */
+/* Decode the `datacnt' data words of a line into `bytes', most
+   significant byte first as write_words() takes them. */
+
+static int
+get_data (char *line, int datacnt, unsigned char *bytes)
+{
+  int i;
+  long word;
+
+  for (i = 0; i < datacnt; i++)
+    {
+      if ((word = get_word (line + DATASTART + (4 * i))) == -1L)
+	return ERROR;
+      *bytes++ = (unsigned char) (word >> 8);
+      *bytes++ = (unsigned char) word;
+    }
+  return OKAY;
+}
+
+/* Analyze and load a line from a TLD Load Module file.
+   `n_chars' is its length without the newline. */
 
 static int
-load_ldmline (char *line)
+load_ldmline (char *line, int n_chars)
 {
   int cmd, actual_chksum, datacnt;
   long claimed_chksum, address;
+  unsigned char bytes[2 * 16];
 
-  if (line[0] != '/')
+  line_end = line + n_chars;
+  if (n_chars < 2 || line[0] != '/')
     return error ("LDM: illegal format at line %d", linecnt);
   cmd = line[COMMAND];
   if (cmd == ';' || cmd == 'E' || cmd == 'H' || cmd == 'Z')
@@ -168,49 +205,45 @@ load_ldmline (char *line)
     case 'I':
     case 'O':
       {
-	int i, as, logaddr_hinibble, bank = (cmd == 'I') ? CODE : DATA;
-	if ((as = xtoi (line[ADDRESS])) == -1)
+	int as, logaddr_hinibble, bank = (cmd == 'I') ? CODE : DATA;
+	if ((as = get_digit (line + ADDRESS)) == -1)
 	  return error ("line %d: /%c error in load address state",
 			linecnt, cmd);
-	if ((logaddr_hinibble = xtoi (line[ADDRESS + 1])) == -1)
+	if ((logaddr_hinibble = get_digit (line + ADDRESS + 1)) == -1)
 	  return error ("line %d: /%c error in logical address MS-nibble",
 			linecnt, cmd);
-	if ((address = get_nibbles (line + ADDRESS + 2, 3)) == -1L)
+	if ((address = field (line + ADDRESS + 2, 3)) == -1L)
 	  return error ("line %d: /%c error in logical address",
 			linecnt, cmd);
 	address |= (long) pagereg[bank][as][logaddr_hinibble].ppa << 12;
-	if ((datacnt = xtoi (line[COUNT])) == -1)
+	if ((datacnt = get_digit (line + COUNT)) == -1)
 	  return error ("line %d: /%c error in data count", linecnt, cmd);
-	for (i = 0; i < datacnt; i++)
-	  {
-	    long word = get_word (line + DATASTART + (4 * i));
-	    if (word == -1L)
-	      return error ("line %d: /%c data error", linecnt, cmd);
-	    poke (address++, (ushort) word);
-	  }
+	if (get_data (line, datacnt, bytes) != OKAY)
+	  return error ("line %d: /%c data error", linecnt, cmd);
+	return write_words ((ulong) address, bytes, (ulong) datacnt);
       }
       break;
     case 'L':
       {
 	int i, bank, as, pagereg_number;
-	if ((as = xtoi (line[ADDRESS])) == -1)
+	if ((as = get_digit (line + ADDRESS)) == -1)
 	  return error ("line %d: /L error in load address state", linecnt);
-	if ((bank = xtoi (line[ADDRESS + 3])) == -1)
+	if ((bank = get_digit (line + ADDRESS + 3)) == -1)
 	  return error ("line %d: /L error in load address bank", linecnt);
-	if ((pagereg_number = xtoi (line[ADDRESS + 4])) == -1)
+	if ((pagereg_number = get_digit (line + ADDRESS + 4)) == -1)
 	  return error ("line %d: /L error in pagereg number", linecnt);
-	if ((datacnt = xtoi (line[COUNT])) == -1)
+	if ((datacnt = get_digit (line + COUNT)) == -1)
 	  return error ("line %d: /L error in data count", linecnt);
 	for (i = 0; i < datacnt; i++)
 	  {
-	    const int allocation_type = xtoi (line[DATASTART + (4 * i)]);
+	    const int allocation_type = get_digit (line + DATASTART + (4 * i));
 	    long pagereg_contents;
 	    if (allocation_type == -1)
 	      return error ("line %d: /L error in allocation type", linecnt);
 	    if (allocation_type != 2)
 	      return error ("line %d: /L allocation type %d unimplemented",
 			    linecnt, allocation_type);
-	    pagereg_contents = get_nibbles (line + DATASTART + (4 * i) + 1, 3);
+	    pagereg_contents = field (line + DATASTART + (4 * i) + 1, 3);
 	    if (pagereg_contents == -1L || pagereg_contents > 0xFFL)
 	      return error ("line %d: /L pagereg contents error", linecnt);
 	    pagereg[bank][as][pagereg_number].ppa = (ushort) pagereg_contents;
@@ -221,33 +254,29 @@ load_ldmline (char *line)
       break;
     case 'M':
       {
-	int i, physaddr_hinibble;
-	if ((physaddr_hinibble = xtoi (line[ADDRESS])) == -1)
+	int physaddr_hinibble;
+	if ((physaddr_hinibble = get_digit (line + ADDRESS)) == -1)
 	  return error ("line %d: /M error in load address high nibble", linecnt);
 	if ((address = get_word (line + ADDRESS + 1)) == -1L)
 	  return error ("line %d: /M error in load address", linecnt);
 	address |= physaddr_hinibble << 16;
-	if ((datacnt = xtoi (line[COUNT])) == -1)
+	if ((datacnt = get_digit (line + COUNT)) == -1)
 	  return error ("line %d: /M error in data count", linecnt);
-	for (i = 0; i < datacnt; i++)
-	  {
-	    long word = get_word (line + DATASTART + (4 * i));
-	    if (word == -1L)
-	      return error ("line %d: /M data error", linecnt);
-	    poke (address++, (ushort) word);
-	  }
+	if (get_data (line, datacnt, bytes) != OKAY)
+	  return error ("line %d: /M data error", linecnt);
+	return write_words ((ulong) address, bytes, (ulong) datacnt);
       }
       break;
     case 'N':
     case 'Q':
       {
 	int i, bank = (cmd == 'N') ? CODE : DATA;
-	if ((address = get_nibbles (line + ADDRESS, 5)) < 0L)
+	if ((address = field (line + ADDRESS, 5)) < 0L)
 	  return error ("line %d: /%c data error in address field", linecnt, cmd);
 	if (address > 0xFFL)
 	  return error ("line %d: /%c starting pagereg number too large",
 			linecnt, cmd);
-	if ((datacnt = xtoi (line[COUNT])) == -1)
+	if ((datacnt = get_digit (line + COUNT)) == -1)
 	  return error ("line %d: /%c error in data count", linecnt, cmd);
 	for (i = 0; i < datacnt; i++)
 	  {
@@ -263,7 +292,7 @@ load_ldmline (char *line)
       }
       break;
     case 'T':
-      if ((address = get_nibbles (line + ADDRESS, 5)) == -1L)
+      if ((address = field (line + ADDRESS, 5)) == -1L)
 	return error ("LDM: numeric syntax error in transfer address");
       simreg.ic = (ushort) address;
       if (address > 0xFFFFL)
@@ -276,34 +305,36 @@ load_ldmline (char *line)
   return OKAY;
 }
 
-/* load file in TLD Load Module format */
+/* load file in TLD Load Module format.
+   The file is mapped into memory and parsed where it is. */
 
 static int
 load_tldldm (char *filename)
 {
-  FILE *loadfile;
   char lline[128];
-  bool verbose_save = verbose;
-  int retval;
+  char *file, *line, *end, *newline;
+  ulong size;
+  int retval = OKAY;
 
-  if ((loadfile = fopen (filename, "r")) == (FILE *) 0)
+  if ((file = map_file (filename, &size)) == (char *) 0)
     {
       strcat (strcpy (lline, filename), ".ldm");
-      if ((loadfile = fopen (lline, "r")) == (FILE *) 0)
+      if ((file = map_file (lline, &size)) == (char *) 0)
 	return error ("cannot open load file '%s'", filename);
     }
-  verbose = FALSE;		/* avoid info messages from poke() */
   linecnt = 0;
-  while (fgets (lline, sizeof (lline), loadfile) != NULL)
+  end = file + size;
+  for (line = file; line < end && retval == OKAY; line = newline + 1)
     {
+      if ((newline = (char *) memchr (line, '\n', end - line)) == 0)
+	newline = end;
       ++linecnt;
-      if (strlen (lline) < 2)
+      if (newline - line < 1)
 	continue;
-      if ((retval = load_ldmline (lline)) != OKAY)
-	break;
+      retval = load_ldmline (line, (int) (newline - line));
     }
-  fclose (loadfile);
-  verbose = verbose_save;
+  unmap_file (file, size);
+  mmu_changed ();		/* /L, /N and /Q records write the page registers */
   return retval;
 }
 
@@ -316,6 +347,7 @@ si_ldm (int argc, char *argv[])
   if (argc <= 1)
     return error ("filename missing");
   loadfile_type = TLD_LDM;
+  sym_reset ();			/* LDM files have no symbols */
   if (*filename == '"')
     {
       *filename++ = '\0';
@@ -0,0 +1,236 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : tracedump.c -- offline decoder for trace files              */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* tracedump.c  --  sim1750-tracedump, display a trace written by the
+   TRACEFILE command (see tracefile.h for the format).
+
+   Usage:  sim1750-tracedump <tracefile>
+
+   One line is printed per instruction:
+
+	<cycle>  <AS>:<IC>  <label>  <disassembly>  <changes>
+
+   where <cycle> is the processor cycle count (modulo 2**32) before the
+   instruction, and <changes> lists the registers the instruction set,
+   as in R3=0012, followed by its stores as in [01234]=0005, the
+   physical address in brackets. Stores not done by an instruction,
+   such as by CMEM or loading a file, are listed on lines of their own
+   marked "(store)", a few to a line.
+
+   Labels are taken from the symbols of the file that was loaded when
+   the trace was started. Operand addresses are mapped to physical ones
+   as by the page registers after INIT, i.e. AS n maps to the physical
+   64K words starting at n * 10000h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "type.h"
+#include "tracefile.h"
+
+extern int dism1750 (char *text, ushort *word);	/* dism1750.c */
+
+struct label
+  {
+    ulong address;
+    char *name;
+  };
+
+static struct label *labels;
+static int n_labels, n_allocated;
+
+static ushort as, ic;		/* of the instruction being disassembled */
+static ulong  phys_ic;
+
+#define GET16(p)  (((ushort) (p)[0] << 8) | (ushort) (p)[1])
+#define GET32(p)  (((ulong) GET16 (p) << 16) | (ulong) GET16 ((p) + 2))
+
+static char *reg_name[25] =
+  {
+    "R0", "R1", "R2",  "R3",  "R4",  "R5",  "R6",  "R7",
+    "R8", "R9", "R10", "R11", "R12", "R13", "R14", "R15",
+    "PIR", "MK", "FT", "IC", "SW", "TA", "TB", "GO", "SYS"
+  };
+
+
+static int
+compare_labels (const void *a, const void *b)
+{
+  ulong x = ((const struct label *) a)->address;
+  ulong y = ((const struct label *) b)->address;
+
+  return (x < y) ? -1 : (x > y);
+}
+
+
+static char *
+phys_label (ulong address)
+{
+  int lo = 0, hi = n_labels - 1, mid;
+
+  while (lo <= hi)
+    {
+      mid = (lo + hi) / 2;
+      if (labels[mid].address == address)
+	return labels[mid].name;
+      if (labels[mid].address < address)
+	lo = mid + 1;
+      else
+	hi = mid - 1;
+    }
+  return NULL;
+}
+
+
+/* Called back by dism1750() for operand addresses */
+
+char *
+find_label (int bank, ushort address)
+{
+  if (bank == 0 && (address >> 12) == (ic >> 12))
+    return phys_label ((phys_ic & ~0x0FFFL) | (address & 0x0FFF));
+  return phys_label (((ulong) as << 16) | address);
+}
+
+
+static void
+add_label (ulong address, unsigned char *name, int len)
+{
+  if (n_labels == n_allocated)
+    {
+      n_allocated = n_allocated ? 2 * n_allocated : 64;
+      labels = (struct label *) realloc (labels,
+					 n_allocated * sizeof (struct label));
+      if (labels == (struct label *) 0)
+	{
+	  fprintf (stderr, "sim1750-tracedump: out of memory\n");
+	  exit (EXIT_FAILURE);
+	}
+    }
+  labels[n_labels].address = address;
+  labels[n_labels].name = (char *) malloc (len + 1);
+  memcpy (labels[n_labels].name, name, len);
+  labels[n_labels].name[len] = '\0';
+  n_labels++;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned char rec[TR_RECSIZE], name[256];
+  char text[80], changes[256], pokes[256], *label, *c, *pk;
+  ushort words[2];
+  bool pending = FALSE, sorted = FALSE;
+  ulong cycle = 0;
+  int i, len;
+  FILE *fp;
+
+  if (argc != 2)
+    {
+      fprintf (stderr, "usage: sim1750-tracedump <tracefile>\n");
+      return (EXIT_FAILURE);
+    }
+  if ((fp = fopen (argv[1], "rb")) == NULL)
+    {
+      fprintf (stderr, "sim1750-tracedump: cannot open %s\n", argv[1]);
+      return (EXIT_FAILURE);
+    }
+  if (fread (rec, 1, TR_RECSIZE, fp) != TR_RECSIZE
+      || strcmp ((char *) rec, TR_MAGIC) != 0)
+    {
+      fprintf (stderr, "sim1750-tracedump: %s is not a trace file\n", argv[1]);
+      return (EXIT_FAILURE);
+    }
+
+  *(c = changes) = '\0';
+  *(pk = pokes) = '\0';
+  for (;;)
+    {
+      len = fread (rec, 1, TR_RECSIZE, fp);
+      if (pending
+	  && (len != TR_RECSIZE || rec[0] == TR_INSN || rec[0] == TR_POKE))
+	{
+	  label = phys_label (phys_ic);
+	  printf ("%10lu  %X:%04hX  %-12s %-24s%s\n", cycle, as, ic,
+		  label != NULL ? label : "", text, changes);
+	  *(c = changes) = '\0';
+	  pending = FALSE;
+	}
+      if (pk != pokes && (len != TR_RECSIZE || rec[0] != TR_POKE
+			  || pk >= pokes + 8 * 14))
+	{
+	  printf ("%10s  %6s  %-12s %-24s%s\n", "", "", "", "(store)", pokes);
+	  *(pk = pokes) = '\0';
+	}
+      if (len != TR_RECSIZE)
+	break;
+
+      switch (rec[0])
+	{
+	case TR_SYMBOL:
+	  len = rec[1];
+	  for (i = 0; i < len; i += TR_RECSIZE)
+	    if (fread (name + i, 1, TR_RECSIZE, fp) != TR_RECSIZE)
+	      break;
+	  add_label (GET32 (rec + 2), name, len);
+	  break;
+	case TR_INSN:
+	  if (! sorted)
+	    {
+	      qsort (labels, n_labels, sizeof (struct label), compare_labels);
+	      sorted = TRUE;
+	    }
+	  as = rec[1];
+	  ic = GET16 (rec + 2);
+	  words[0] = GET16 (rec + 4);
+	  words[1] = GET16 (rec + 6);
+	  cycle = GET32 (rec + 8);
+	  phys_ic = GET32 (rec + 12);
+	  dism1750 (text, words);
+	  pending = TRUE;
+	  break;
+	case TR_REGS:
+	  for (i = 0; i < rec[1] && i < 4; i++)
+	    if (rec[2 + 3 * i] < 25 && c < changes + sizeof (changes) - 16)
+	      c += sprintf (c, " %s=%04hX", reg_name[rec[2 + 3 * i]],
+			    GET16 (rec + 3 + 3 * i));
+	  break;
+	case TR_STORE:
+	  if (c < changes + sizeof (changes) - 16)
+	    c += sprintf (c, " [%05lX]=%04hX", GET32 (rec + 2), GET16 (rec + 6));
+	  break;
+	case TR_POKE:
+	  pk += sprintf (pk, " [%05lX]=%04hX", GET32 (rec + 2), GET16 (rec + 6));
+	  break;
+	default:
+	  fprintf (stderr, "sim1750-tracedump: bad record type %d\n", rec[0]);
+	  return (EXIT_FAILURE);
+	}
+    }
+  fclose (fp);
+  return (EXIT_SUCCESS);
+}
@@ -0,0 +1,275 @@
+/***************************************************************************/
+/*                                                                         */
+/* Project   :       sim1750 -- Mil-Std-1750 Software Simulator            */
+/*                                                                         */
+/* Component : tracefile.c -- binary execution trace writer                */
+/*                                                                         */
+/* Disclaimer:                                                             */
+/*                                                                         */
+/*  This program is free software; you can redistribute it and/or modify   */
+/*  it under the terms of the GNU General Public License as published by   */
+/*  the Free Software Foundation; either version 2 of the License, or      */
+/*  (at your option) any later version.                                    */
+/*                                                                         */
+/*  This program is distributed in the hope that it will be useful,        */
+/*  but WITHOUT ANY WARRANTY; without even the implied warranty of         */
+/*  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          */
+/*  GNU General Public License for more details.                           */
+/*                                                                         */
+/*  You should have received a copy of the GNU General Public License      */
+/*  along with this program; if not, write to the Free Software            */
+/*  Foundation, 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.   */
+/*                                                                         */
+/***************************************************************************/
+
+/* tracefile.c  --  write a binary trace of the executed instructions.
+
+   TRACEFILE <file> opens the trace; from then on every instruction run
+   by the interpreter is written as fixed size records (see tracefile.h)
+   into a block buffer, which is written out whenever it fills up and
+   when the trace is closed by TRACEFILE OFF. Nothing is formatted while
+   the program runs: sim1750-tracedump (tracedump.c) disassembles and
+   symbolizes the trace afterwards.
+
+   The registers changed by an instruction are found by comparing the
+   register file with its state at the previous instruction, which is
+   done when the next instruction is traced. The timer registers are
+   only brought up to date on demand and are not traced; the cycle
+   count of each instruction is. Stores are written as TR_STORE while
+   an instruction runs, and as TR_POKE otherwise.
+
+   A traced GO takes about 1.7 times as long as an untraced one in the
+   interpreter.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arch.h"
+#include "status.h"
+#include "arith.h"
+#include "utils.h"
+#include "loadfile.h"
+#include "sched.h"
+#include "tracefile.h"
+
+#define TRACE_BLOCK  (4096 * TR_RECSIZE)	/* bytes per write */
+
+THREAD_LOCAL bool tracing = FALSE;
+THREAD_LOCAL bool trace_executing = FALSE;
+
+static THREAD_LOCAL FILE *trace_fp;
+static THREAD_LOCAL unsigned char *trace_buf;
+static THREAD_LOCAL unsigned trace_len;	/* bytes used in trace_buf */
+static THREAD_LOCAL ulong trace_count;		/* instructions traced */
+static THREAD_LOCAL bool trace_pending;	/* registers not yet compared */
+static THREAD_LOCAL struct regs trace_last;	/* at the last instruction */
+
+#define PUT16(p,w)  ((p)[0] = (unsigned char) ((w) >> 8), \
+		     (p)[1] = (unsigned char) (w))
+#define PUT32(p,l)  (PUT16 (p, (ushort) ((l) >> 16)), \
+		     PUT16 ((p) + 2, (ushort) (l)))
+
+
+static void
+trace_flush (void)
+{
+  if (tracing && fwrite (trace_buf, 1, trace_len, trace_fp) != trace_len)
+    {
+      error ("write error on trace file, tracing stopped");
+      tracing = FALSE;
+    }
+  trace_len = 0;
+}
+
+
+/* Return a zeroed record of the given type in the block buffer */
+
+static unsigned char *
+new_record (int type)
+{
+  unsigned char *rec;
+
+  if (trace_len + TR_RECSIZE > TRACE_BLOCK)
+    trace_flush ();
+  rec = trace_buf + trace_len;
+  trace_len += TR_RECSIZE;
+  memset (rec, 0, TR_RECSIZE);
+  rec[0] = (unsigned char) type;
+  return rec;
+}
+
+
+/* Write the registers changed since the last instruction was traced.
+   Which registers change is hard to predict, so the changes are first
+   collected without branching on each register. */
+
+#define TRACE_CHANGE(reg) \
+	(value = now[reg], p[0] = (unsigned char) (reg), PUT16 (p + 1, value), \
+	 p += (value != last[reg]) ? 3 : 0, last[reg] = value)
+
+static void
+trace_regs (void)
+{
+  ushort *now = (ushort *) &simreg, *last = (ushort *) &trace_last;
+  unsigned char changes[21 * 3], *p = changes, *rec;
+  unsigned g, n;
+  ushort value;
+
+  flush_cs ();
+  for (g = 0; g < 16; g += 4)	/* R0..R15, four at a time */
+    if (memcmp (now + g, last + g, 4 * sizeof (ushort)) != 0)
+      {
+	TRACE_CHANGE (g);
+	TRACE_CHANGE (g + 1);
+	TRACE_CHANGE (g + 2);
+	TRACE_CHANGE (g + 3);
+      }
+  TRACE_CHANGE (20);		/* SW */
+  if (((now[16] ^ last[16]) | (now[17] ^ last[17]) | (now[18] ^ last[18])
+       | (now[24] ^ last[24])) != 0)
+    {
+      TRACE_CHANGE (16);	/* PIR */
+      TRACE_CHANGE (17);	/* MK */
+      TRACE_CHANGE (18);	/* FT */
+      TRACE_CHANGE (24);	/* SYS */
+    }
+
+  n = (p - changes) / 3;
+  for (p = changes; n > 0; n -= g, p += 3 * g)
+    {
+      g = (n < 4) ? n : 4;
+      rec = new_record (TR_REGS);
+      rec[1] = (unsigned char) g;
+      memcpy (rec + 2, p, 3 * g);
+    }
+  trace_pending = FALSE;
+}
+
+
+/* Called by execute() before running an instruction. All 16 bytes of
+   the record are set, so it is not cleared first. */
+
+void
+trace_insn (ushort opcode, ushort next_word, ulong phys_ic)
+{
+  unsigned char *rec;
+
+  if (trace_pending)
+    trace_regs ();
+  if (trace_len + TR_RECSIZE > TRACE_BLOCK)
+    trace_flush ();
+  rec = trace_buf + trace_len;
+  trace_len += TR_RECSIZE;
+  rec[0] = TR_INSN;
+  rec[1] = (unsigned char) (simreg.sw & 0xF);
+  PUT16 (rec + 2, simreg.ic);
+  PUT16 (rec + 4, opcode);
+  PUT16 (rec + 6, next_word);
+  PUT32 (rec + 8, sched_now);
+  PUT32 (rec + 12, phys_ic);
+  trace_count++;
+  trace_pending = TRUE;
+  trace_executing = TRUE;
+}
+
+
+/* Called by poke() for each store to memory. A store outside of an
+   instruction goes after the registers of the last one. */
+
+void
+trace_store (ulong phys_address, ushort old_value, ushort value)
+{
+  unsigned char *rec;
+
+  if (trace_executing)
+    rec = new_record (TR_STORE);
+  else
+    {
+      if (trace_pending)
+	trace_regs ();
+      rec = new_record (TR_POKE);
+    }
+
+  PUT32 (rec + 2, phys_address);
+  PUT16 (rec + 6, value);
+  PUT16 (rec + 8, old_value);
+}
+
+
+static void
+trace_symbols (void)
+{
+  unsigned char *rec;
+  char *name;
+  ulong address;
+  int i, len;
+
+  for (i = 0; (name = nth_label (i, &address)) != NULL; i++)
+    {
+      len = strlen (name);
+      if (len > 255)
+	len = 255;
+      rec = new_record (TR_SYMBOL);
+      rec[1] = (unsigned char) len;
+      PUT32 (rec + 2, address);
+      for (; len > 0; len -= TR_RECSIZE, name += TR_RECSIZE)
+	memcpy (new_record (0), name, len < TR_RECSIZE ? len : TR_RECSIZE);
+    }
+}
+
+
+void
+trace_close (void)
+{
+  if (trace_fp == (FILE *) 0)
+    return;
+  if (tracing && trace_pending)
+    trace_regs ();
+  trace_flush ();
+  tracing = FALSE;
+  fclose (trace_fp);
+  trace_fp = (FILE *) 0;
+  free (trace_buf);
+  trace_buf = (unsigned char *) 0;
+}
+
+
+int
+si_tracefile (int argc, char *argv[])
+{
+  if (argc > 2)
+    error ("excess arguments ignored");
+  if (argc == 1)
+    {
+      if (tracing)
+	lprintf ("\tTracing, %lu instructions so far\n", trace_count);
+      else
+	lprintf ("\tNo trace file open\n");
+      return (OKAY);
+    }
+  trace_close ();
+  if (eq (argv[1], "off"))
+    return (OKAY);
+
+  if ((trace_buf = (unsigned char *) malloc (TRACE_BLOCK)) == NULL)
+    return error ("no memory for the trace buffer");
+  if ((trace_fp = fopen (argv[1], "wb")) == NULL)
+    {
+      free (trace_buf);
+      trace_buf = (unsigned char *) 0;
+      return error ("cannot open trace file '%s'", argv[1]);
+    }
+  trace_len = TR_RECSIZE;
+  memset (trace_buf, 0, TR_RECSIZE);
+  strcpy ((char *) trace_buf, TR_MAGIC);
+  tracing = TRUE;
+  trace_symbols ();
+  trace_count = 0;
+  trace_pending = FALSE;
+  trace_executing = FALSE;
+  flush_cs ();
+  trace_last = simreg;
+  return (OKAY);
+}
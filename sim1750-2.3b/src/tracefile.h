@@ -0,0 +1,49 @@
+/* tracefile.h  --  exports of tracefile.c, and the trace file format
+                    shared with tracedump.c */
+
+#ifndef _TRACEFILE_H
+#define _TRACEFILE_H
+
+#include "type.h"
+
+/* A trace file starts with the TR_MAGIC string padded with zeros to
+   TR_RECSIZE bytes, followed by records of TR_RECSIZE bytes each.
+   Byte 0 of a record is its type; numbers are stored most significant
+   byte first.
+
+   TR_SYMBOL	 1: length of name, 2..5: physical address. The name
+		 follows in as many records as it takes, zero padded.
+   TR_INSN	 1: AS, 2..3: IC, 4..5: opcode, 6..7: word after opcode,
+		 8..11: cycle count (low 32 bits), 12..15: physical IC
+   TR_REGS	 1: number n of changes (1..4), then n times
+		 a register number (as in struct regs: 0..15 R0..R15,
+		 16 PIR, 17 MK, 18 FT, 20 SW, 24 SYS) and its new value
+   TR_STORE	 2..5: physical address, 6..7: new value, 8..9: old value
+   TR_POKE	 as TR_STORE, for a store not done by an instruction
+		 (CMEM, loading a file)
+
+   Symbols come first. A TR_INSN record is followed by the TR_STORE
+   records of the stores done by the instruction (or by the interrupt
+   it led to) and then by the TR_REGS records of the registers it
+   changed. TR_POKE records come after all of these. */
+
+#define TR_MAGIC     "sim1750 trace 1"
+#define TR_RECSIZE   16
+
+#define TR_SYMBOL    1
+#define TR_INSN      2
+#define TR_REGS      3
+#define TR_STORE     4
+#define TR_POKE      5
+
+extern THREAD_LOCAL bool tracing;	/* a trace file is open */
+extern THREAD_LOCAL bool trace_executing;	/* from trace_insn() to the */
+						/* end of the instruction */
+#define trace_insn_done()  (trace_executing = FALSE)
+
+extern void trace_insn (ushort opcode, ushort next_word, ulong phys_ic);
+extern void trace_store (ulong phys_address, ushort old_value, ushort value);
+extern void trace_close (void);
+extern int  si_tracefile (int argc, char *argv[]);
+
+#endif
@@ -25,5 +25,12 @@
 
 #define elsecase  break;case
 
+/* storage class of variables of which each host thread has its own copy */
+#if defined (__GNUC__) && ! defined (NO_THREADS)
+#define THREAD_LOCAL  __thread
+#else
+#define THREAD_LOCAL
+#endif
+
 #endif
 
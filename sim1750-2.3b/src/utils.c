@@ -35,6 +35,14 @@
 #include "type.h"
 #include "utils.h"
 
+#if defined (__unix__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 void
 problem (char *msg)
 {
@@ -75,18 +83,33 @@ itox (int i)			/* This could be a macro, but we want to avoid side effects */
 }
 
 
+/* Value of a hexadecimal digit, or -1 */
+const signed char hex_digit[256] =
+  {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+  };
+
 int
 xtoi (char c)			/* This could be a macro, but we want to avoid side effects */
 {				/* when the argument has ++ or --. */
   if (isspace (c))
     return 0;
-  if (c >= '0' && c <= '9')
-    return (int) c - 48;
-  if (c >= 'A' && c <= 'F')
-    return (int) c - 55;
-  if (c >= 'a' && c <= 'f')
-    return (int) c - 87;
-  return -1;
+  return hex_digit[(unsigned char) c];
 }
 
 
@@ -276,8 +299,9 @@ get_nibbles (char *src, int n_nibbles)
 
   while (n_nibbles-- > 0)
     {
-      if ((i = xtoi (*src++)) == -1)
+      if ((i = HEX_DIGIT (*src)) == -1 && (i = xtoi (*src)) == -1)
 	return -1L;
+      src++;
       outnum = (outnum << 4) | (long) i;
     }
   return outnum;
@@ -295,3 +319,70 @@ put_nibbles (char *dst, ulong src, int n_nibbles)
       *dst++ = itox (nibble);
     }
 }
+
+
+/* Bring a whole file into memory for reading, mapped if the host
+   allows. Returns NULL if it cannot be read. The contents must be
+   released by unmap_file(). */
+
+static char empty_file[1];
+
+char *
+map_file (char *filename, ulong *size)
+{
+  char *base;
+#if defined (__unix__)
+  struct stat st;
+  int fd;
+
+  if ((fd = open (filename, O_RDONLY)) < 0)
+    return (char *) 0;
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return (char *) 0;
+    }
+  if ((*size = (ulong) st.st_size) == 0)
+    base = empty_file;
+  else
+    {
+      base = (char *) mmap ((void *) 0, (size_t) *size, PROT_READ,
+			    MAP_PRIVATE, fd, (off_t) 0);
+      if (base == (char *) MAP_FAILED)
+	base = (char *) 0;
+    }
+  close (fd);
+  return base;
+#else
+  FILE *fp;
+
+  if ((fp = fopen (filename, "rb")) == (FILE *) 0)
+    return (char *) 0;
+  fseek (fp, 0L, SEEK_END);
+  *size = (ulong) ftell (fp);
+  rewind (fp);
+  if (*size == 0)
+    base = empty_file;
+  else if ((base = (char *) malloc (*size)) != (char *) 0
+	   && fread ((void *) base, 1, *size, fp) != *size)
+    {
+      free ((void *) base);
+      base = (char *) 0;
+    }
+  fclose (fp);
+  return base;
+#endif
+}
+
+
+void
+unmap_file (char *base, ulong size)
+{
+  if (base == empty_file)
+    return;
+#if defined (__unix__)
+  munmap ((void *) base, (size_t) size);
+#else
+  free ((void *) base);
+#endif
+}
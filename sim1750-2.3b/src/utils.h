@@ -11,6 +11,8 @@ extern char  *nopath (char *full_filename);
 extern char  upcase (char c);
 extern char  itox (int i);
 extern int   xtoi (char c);
+extern const signed char hex_digit[256];  /* -1 if not a hex digit */
+#define HEX_DIGIT(c)  hex_digit[(unsigned char) (c)]
 #ifndef STRDUP
 extern char  *strdup (char *str);
 #endif
@@ -29,4 +31,6 @@ extern char  *skip_symbol (char *s);
 extern long  get_16bit_hexnum (char *s);
 extern long  get_nibbles (char *src, int n_nibbles);
 extern void  put_nibbles (char *dst, unsigned long src, int n_nibbles);
+extern char  *map_file (char *filename, unsigned long *size);
+extern void  unmap_file (char *base, unsigned long size);
 